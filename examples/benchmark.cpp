@@ -20,6 +20,9 @@
 
 #include <httpserver.hpp>
 #include <iostream>
+#include <unistd.h>
+#include <cstdlib>
+#include <cstdio>
 
 #if defined(CPU_COUNT) && (CPU_COUNT+0) < 2
 #undef CPU_COUNT
@@ -42,16 +45,78 @@ class hello_world_resource : public http_resource {
 //using the render method you are able to catch each type of request you receive
 void hello_world_resource::render(const http_request& req, http_response** res)
 {
-    //it is possible to send a response initializing an http_string_response
-    //that reads the content to send in response from a string.
-    *res = new http_response(http_response_builder(PAGE, 200).string_response());
+    //build() draws the response from a thread-local pool, so that serving
+    //a request does not need the allocator once the pool is warm.
+    *res = http_response_builder(PAGE, 200).string_response().build();
 }
 
-int main()
+void usage()
 {
+    std::cout << "Usage:" << std::endl
+              << "benchmark [-p <port>][-t <threads>][-d <daemons>][-a <first_cpu>-<last_cpu>][-m]" << std::endl
+              << "  -t threads of the MHD pool of each daemon (0: one per daemon)" << std::endl
+              << "  -d daemons listening on their own SO_REUSEPORT socket" << std::endl
+              << "  -a pin the worker threads to the CPUs in the range" << std::endl
+              << "  -m keep metrics, served at /metrics" << std::endl
+              << "To measure scaling, run it with -d 1, 2, ... N and the same client load." << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    uint16_t port = 8080;
+    int threads = NUMBER_OF_THREADS;
+    int daemons = 1;
+    int first_cpu = -1;
+    int last_cpu = -1;
+    bool metrics = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "p:t:d:a:m?")) != EOF) {
+        switch (c) {
+        case 'p':
+            port = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'd':
+            daemons = atoi(optarg);
+            break;
+        case 'a':
+            if (sscanf(optarg, "%d-%d", &first_cpu, &last_cpu) != 2) {
+                usage();
+                exit(1);
+            }
+            break;
+        case 'm':
+            metrics = true;
+            break;
+        default:
+            usage();
+            exit(1);
+            break;
+        }
+    }
+
     //it is possible to create a webserver passing a great number of parameters.
-    //In this case we are just passing the port and the number of thread running.
-    webserver ws = create_webserver(8080).start_method(http::http_utils::INTERNAL_SELECT).max_threads(NUMBER_OF_THREADS);
+    //In this case we are passing the port, the number of daemons and the
+    //number of threads running in each of them.
+    create_webserver cw = create_webserver(port)
+        .start_method(http::http_utils::INTERNAL_SELECT)
+        .max_threads(threads)
+        .daemon_count(daemons);
+
+    //compare the tail latency under the same mixed load with and without
+    //pinning: unpinned workers migrate across sockets and lose locality.
+    if (first_cpu >= 0)
+        cw.cpu_affinity(first_cpu, last_cpu);
+
+    //the overhead of the instrumentation is the difference in throughput
+    //between two runs with and without -m under the same load.
+    if (metrics)
+        cw.metrics_path("/metrics");
+
+    webserver ws = cw;
 
     hello_world_resource hwr;
     //this way we are registering the hello_world_resource to answer for the endpoint
@@ -0,0 +1,195 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <httpserver.hpp>
+#include <iostream>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <vector>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace httpserver;
+
+//Holds many requests open at the same time on a handful of MHD threads:
+//each request is answered by a coroutine sleeping on the shared timer
+//queue, so a waiting request costs a suspended connection, not a thread.
+//The client side opens all the connections at once with epoll; raise the
+//file descriptor limit (ulimit -n) above twice the number of connections.
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#define PAGE "<html><head><title>libmicrohttpd demo</title></head><body>libhttpserver demo</body></html>"
+
+unsigned int sleep_ms = 100;
+
+class sleeping_resource : public coroutine_resource {
+    public:
+        task<http_response*> render_async(const http_request&)
+        {
+            co_await async_sleep(sleep_ms);
+            co_return http_response_builder(PAGE, 200).string_response().build();
+        }
+};
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+//Opens the connections, sends one request on each and waits for the
+//server to close all of them; returns the number of responses received.
+int run_client(uint16_t port, int connections)
+{
+    static const char request[] =
+        "GET /sleep HTTP/1.1\r\nHost: localhost\r\nConnection: close\r\n\r\n";
+
+    int epfd = epoll_create(1);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int open_connections = 0;
+    for (int i = 0; i < connections; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == -1 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1) {
+            perror("connect");
+            if (fd != -1)
+                close(fd);
+            break;
+        }
+        if (write(fd, request, sizeof(request) - 1) != (ssize_t) (sizeof(request) - 1)) {
+            close(fd);
+            continue;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        struct epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        open_connections++;
+    }
+
+    int responses = 0;
+    std::vector<char> got_status(65536, 0);
+    std::vector<struct epoll_event> events(1024);
+    char buffer[4096];
+    while (open_connections > 0) {
+        int n = epoll_wait(epfd, &events[0], events.size(), 10000);
+        if (n <= 0)
+            break;
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            ssize_t r;
+            while ((r = read(fd, buffer, sizeof(buffer))) > 0) {
+                if (!got_status[fd] && r >= 12 && strncmp(buffer + 9, "200", 3) == 0) {
+                    got_status[fd] = 1;
+                    responses++;
+                }
+            }
+            if (r == 0 || (r == -1 && errno != EAGAIN)) {
+                got_status[fd] = 0;
+                epoll_ctl(epfd, EPOLL_CTL_DEL, fd, 0x0);
+                close(fd);
+                open_connections--;
+            }
+        }
+    }
+    close(epfd);
+    return responses;
+}
+
+void usage()
+{
+    std::cout << "Usage:" << std::endl
+              << "coroutine_benchmark [-p <port>][-t <threads>][-c <connections>][-s <sleep ms>]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    uint16_t port = 8080;
+    int threads = 4;
+    int connections = 10000;
+    int c;
+
+    while ((c = getopt(argc, argv, "p:t:c:s:?")) != EOF) {
+        switch (c) {
+        case 'p':
+            port = strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'c':
+            connections = atoi(optarg);
+            break;
+        case 's':
+            sleep_ms = atoi(optarg);
+            break;
+        default:
+            usage();
+            exit(1);
+            break;
+        }
+    }
+
+    webserver ws = create_webserver(port)
+        .start_method(http::http_utils::INTERNAL_SELECT)
+        .max_threads(threads)
+        .max_connections(connections + 16)
+        .connection_timeout(60)
+        .suspend_resume();
+
+    sleeping_resource sr;
+    ws.register_resource("/sleep", &sr);
+    ws.start(false);
+
+    double start = now();
+    int responses = run_client(port, connections);
+    double elapsed = now() - start;
+
+    std::cout << responses << "/" << connections << " responses in "
+              << elapsed * 1000 << " ms on " << threads << " threads (each request sleeps "
+              << sleep_ms << " ms)" << std::endl;
+
+    ws.stop();
+    return responses == connections ? 0 : 1;
+}
+
+#else
+
+int main()
+{
+    std::cout << "coroutine_benchmark requires a C++20 compiler (-std=c++20)" << std::endl;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+
+#include <httpserver.hpp>
+#include <iostream>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+#include <time.h>
+
+using namespace httpserver;
+
+//Compares the queue of thread_pool_executor, shared by all the workers,
+//with work_stealing_executor. Submitter threads play the role of the
+//event threads of the webserver; half of the tasks submit a child task,
+//as a handler scheduling a continuation would.
+
+int workers = 64;
+int submitters = 4;
+int tasks_per_submitter = 250000;
+volatile long done_tasks = 0;
+
+class benchmark_task : public executor_task {
+    public:
+        benchmark_task(executor* pool, bool spawn):
+            pool(pool),
+            spawn(spawn)
+        {
+        }
+
+        void run()
+        {
+            if (spawn)
+                pool->submit(new benchmark_task(pool, false));
+            __sync_add_and_fetch(&done_tasks, 1);
+        }
+
+    private:
+        executor* pool;
+        bool spawn;
+};
+
+void* submit_tasks(void* pool)
+{
+    for (int i = 0; i < tasks_per_submitter; i++)
+        static_cast<executor*>(pool)->submit(
+                new benchmark_task(static_cast<executor*>(pool), i % 2 == 0));
+    return 0x0;
+}
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double run(executor* pool)
+{
+    long expected = (long) submitters * tasks_per_submitter * 3 / 2;
+    done_tasks = 0;
+    pool->start();
+
+    double start = now();
+    std::vector<pthread_t> threads(submitters);
+    for (int i = 0; i < submitters; i++)
+        pthread_create(&threads[i], 0x0, &submit_tasks, pool);
+    for (int i = 0; i < submitters; i++)
+        pthread_join(threads[i], 0x0);
+    while (__sync_fetch_and_add(&done_tasks, 0) < expected)
+        usleep(100);
+    double elapsed = now() - start;
+
+    pool->stop();
+    return expected / elapsed;
+}
+
+void usage()
+{
+    std::cout << "Usage:" << std::endl
+              << "executor_benchmark [-t <workers>][-s <submitters>][-n <tasks per submitter>]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int c;
+    while ((c = getopt(argc, argv, "t:s:n:?")) != EOF) {
+        switch (c) {
+        case 't':
+            workers = atoi(optarg);
+            break;
+        case 's':
+            submitters = atoi(optarg);
+            break;
+        case 'n':
+            tasks_per_submitter = atoi(optarg);
+            break;
+        default:
+            usage();
+            exit(1);
+            break;
+        }
+    }
+
+    thread_pool_executor shared_queue(workers);
+    work_stealing_executor work_stealing(workers);
+
+    std::cout << workers << " workers, " << submitters << " submitters" << std::endl;
+    std::cout << "shared queue:  " << (long) run(&shared_queue) << " tasks/s" << std::endl;
+    std::cout << "work stealing: " << (long) run(&work_stealing) << " tasks/s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+
+#include <httpserver.hpp>
+#include <iostream>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace httpserver;
+
+//Serves one large file over HTTPS at /file. Run it once with and once
+//without -m and compare the download throughput on loopback, e.g. with
+//  curl -k -o /dev/null -w '%{speed_download}\n' https://localhost:8080/file
+//Without -m MHD reads the file in a buffer before encrypting it; with -m
+//the file is mapped and encrypted straight from the page cache.
+
+const char* filename = "large_file";
+
+class file_resource : public http_resource {
+    public:
+        void render_GET(const http_request& req, http_response** res)
+        {
+            *res = http_response_builder(filename, 200, "application/octet-stream").file_response().build();
+        }
+};
+
+void usage()
+{
+    std::cout << "Usage:" << std::endl
+              << "file_benchmark [-p <port>][-f <file>][-k <keyFileName>][-c <certFileName>][-t <threads>][-m]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    uint16_t port = 8080;
+    const char* key = "key.pem";
+    const char* cert = "cert.pem";
+    int threads = 4;
+    bool mapped = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "p:f:k:c:t:m?")) != EOF) {
+        switch (c) {
+        case 'p':
+            port = strtoul(optarg, NULL, 10);
+            break;
+        case 'f':
+            filename = optarg;
+            break;
+        case 'k':
+            key = optarg;
+            break;
+        case 'c':
+            cert = optarg;
+            break;
+        case 't':
+            threads = atoi(optarg);
+            break;
+        case 'm':
+            mapped = true;
+            break;
+        default:
+            usage();
+            exit(1);
+            break;
+        }
+    }
+
+    create_webserver cw = create_webserver(port)
+        .use_ssl()
+        .https_mem_key(key)
+        .https_mem_cert(cert)
+        .max_threads(threads);
+
+    if (mapped)
+        cw.mmap_file_responses();
+
+    webserver ws = cw;
+
+    file_resource fr;
+    ws.register_resource("/file", &fr);
+
+    std::cout << "Serving " << filename << " on port " << port
+              << (mapped ? " (mapped)" : " (read)") << std::endl;
+    ws.start(true);
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <httpserver.hpp>
+#include <iostream>
+#include <signal.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace httpserver;
+
+//Binary upgrade without refused connections. Start a first process:
+//    hot_restart -v 1
+//keep a client running against it (e.g. the benchmark load), then start
+//the new version on the same socket path:
+//    hot_restart -v 2 -i
+//and send SIGUSR2 to the first one: it hands its listen socket to the
+//second process, drains its requests and exits.
+
+volatile sig_atomic_t hand_off_requested = 0;
+volatile sig_atomic_t stop_requested = 0;
+
+void on_usr2(int)
+{
+    hand_off_requested = 1;
+}
+
+void on_term(int)
+{
+    stop_requested = 1;
+}
+
+class version_resource : public http_resource {
+    public:
+        explicit version_resource(const std::string& version):
+            version(version)
+        {
+        }
+
+        void render_GET(const http_request&, http_response** res)
+        {
+            *res = new http_response(http_response_builder("version " + version + "\n", 200).string_response());
+        }
+
+    private:
+        std::string version;
+};
+
+void usage()
+{
+    std::cout << "Usage:" << std::endl
+              << "hot_restart [-p <port>][-s <unix socket path>][-v <version>][-i]" << std::endl
+              << "  -i inherit the listen socket of the running process" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    uint16_t port = 8080;
+    std::string path = "/tmp/hot_restart.sock";
+    std::string version = "1";
+    bool inherit = false;
+    int c;
+
+    while ((c = getopt(argc, argv, "p:s:v:i?")) != EOF) {
+        switch (c) {
+        case 'p':
+            port = strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            path = optarg;
+            break;
+        case 'v':
+            version = optarg;
+            break;
+        case 'i':
+            inherit = true;
+            break;
+        default:
+            usage();
+            exit(1);
+            break;
+        }
+    }
+
+    create_webserver cw = create_webserver(port).max_threads(4);
+    if (inherit)
+        cw.inherit_sockets(path);
+    webserver ws = cw;
+
+    version_resource vr(version);
+    ws.register_resource("/", &vr, true);
+
+    signal(SIGUSR2, &on_usr2);
+    signal(SIGTERM, &on_term);
+    signal(SIGINT, &on_term);
+    ws.start(false);
+    std::cout << "version " << version << " (pid " << getpid() << ") serving on port " << port << std::endl;
+
+    while (!stop_requested) {
+        if (hand_off_requested) {
+            hand_off_requested = 0;
+            drain_report report;
+            std::cout << "waiting for the successor on " << path << std::endl;
+            if (ws.hand_off(path, 10000, &report)) {
+                std::cout << "handed off: " << report.completed << " requests completed, "
+                          << report.aborted << " aborted" << std::endl;
+                return 0;
+            }
+            std::cout << "no successor, still serving" << std::endl;
+        }
+        usleep(100000);
+    }
+
+    ws.drain(5000);
+    return 0;
+}
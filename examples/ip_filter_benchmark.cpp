@@ -0,0 +1,144 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <httpserver.hpp>
+#include <iostream>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+using namespace httpserver;
+
+//Measures the cost of the accept path (policy callback included) as the
+//ban list grows: for each size the list is filled with random IPv4
+//addresses and prefixes, none covering 127.0.0.1, and a client opens
+//short HTTP/1.0 connections one after the other.
+
+uint16_t port = 8080;
+int connections = 5000;
+
+class ok_resource : public http_resource {
+    public:
+        void render_GET(const http_request&, http_response** res)
+        {
+            *res = new http_response(http_response_builder("", 200).string_response());
+        }
+};
+
+double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+std::string random_rule()
+{
+    char s[32];
+    unsigned int a = 1 + rand() % 126;
+    if (rand() % 4 == 0)
+        sprintf(s, "%u.%u.0.0/%d", a, rand() % 256, 16 + rand() % 8);
+    else
+        sprintf(s, "%u.%u.%u.%u", a, rand() % 256, rand() % 256, rand() % 256);
+    return s;
+}
+
+bool request()
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return false;
+    }
+    const char req[] = "GET / HTTP/1.0\r\n\r\n";
+    bool ok = write(fd, req, sizeof(req) - 1) == (ssize_t) (sizeof(req) - 1);
+    char buf[512];
+    ssize_t n;
+    bool answered = false;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        answered = true;
+    close(fd);
+    return ok && answered;
+}
+
+void usage()
+{
+    std::cout << "Usage:" << std::endl
+              << "ip_filter_benchmark [-p <port>][-n <connections per size>][-m <max list size>]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    int max_size = 1000000;
+    int c;
+    while ((c = getopt(argc, argv, "p:n:m:?")) != EOF) {
+        switch (c) {
+        case 'p':
+            port = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            connections = atoi(optarg);
+            break;
+        case 'm':
+            max_size = atoi(optarg);
+            break;
+        default:
+            usage();
+            exit(1);
+            break;
+        }
+    }
+
+    webserver ws = create_webserver(port).ban_system().max_threads(1);
+    ok_resource ok;
+    ws.register_resource("/", &ok);
+    ws.start(false);
+
+    std::cout << "list size   load time (s)   connections/s   failed" << std::endl;
+    int size = 0;
+    for (int target = 0; target <= max_size; target = target == 0 ? 1000 : target * 10) {
+        double start = now();
+        for (; size < target; size++)
+            ws.ban_ip(random_rule());
+        double load = now() - start;
+
+        int failed = 0;
+        start = now();
+        for (int i = 0; i < connections; i++)
+            if (!request())
+                failed++;
+        double elapsed = now() - start;
+
+        printf("%9d   %13.3f   %13.0f   %6d\n", size, load, connections / elapsed, failed);
+    }
+
+    ws.stop();
+    return 0;
+}
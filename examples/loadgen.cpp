@@ -0,0 +1,1055 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <httpserver.hpp>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace httpserver;
+
+//Drives a server with a fixed number of HTTP/1.1 connections and reports
+//throughput and latency percentiles as JSON on stdout, e.g.
+//  loadgen -s cached -c 64 -t 2 -d 10 -P 8
+//  loadgen -s params -c 64 -r 50000
+//By default the server is started in-process on 127.0.0.1 with the
+//routes of all the scenarios; -x drives another server exposing them.
+//
+//Without -r every connection sends a request as soon as it has room for
+//it (closed loop). With -r the requests are due at a fixed rate whatever
+//the server does (open loop) and latencies are measured from the time a
+//request was due, not sent: a stalled server is charged for the requests
+//it kept waiting instead of hiding them (coordinated omission).
+//
+//The comet scenario opens -c long polling subscribers and publishes -r
+//messages per second (10 by default) on their topic; latencies go from
+//the publication to each delivery.
+
+#define COMET_TOPIC "loadgen"
+
+//1/32 relative precision
+#define HISTOGRAM_SUB 32
+#define HISTOGRAM_BUCKETS (60 * HISTOGRAM_SUB)
+
+static uint64_t now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+struct histogram
+{
+    unsigned long long counts[HISTOGRAM_BUCKETS];
+    unsigned long long count;
+    unsigned long long sum;
+    uint64_t min;
+    uint64_t max;
+
+    histogram():
+        count(0),
+        sum(0),
+        min(0),
+        max(0)
+    {
+        memset(counts, 0, sizeof(counts));
+    }
+
+    static int bucket(uint64_t value)
+    {
+        if(value < HISTOGRAM_SUB)
+            return (int) value;
+        int shift = 63 - __builtin_clzll(value) - 5;
+        return (shift + 1) * HISTOGRAM_SUB + (int) ((value >> shift) - HISTOGRAM_SUB);
+    }
+
+    //the highest value falling in the bucket
+    static uint64_t bound(int bucket)
+    {
+        if(bucket < HISTOGRAM_SUB)
+            return bucket;
+        int shift = bucket / HISTOGRAM_SUB - 1;
+        uint64_t sub = bucket % HISTOGRAM_SUB + HISTOGRAM_SUB;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    void add(uint64_t value)
+    {
+        counts[bucket(value)]++;
+        if(count == 0 || value < min)
+            min = value;
+        if(value > max)
+            max = value;
+        count++;
+        sum += value;
+    }
+
+    void merge(const histogram& other)
+    {
+        if(other.count == 0)
+            return;
+        for(int i = 0; i < HISTOGRAM_BUCKETS; i++)
+            counts[i] += other.counts[i];
+        if(count == 0 || other.min < min)
+            min = other.min;
+        if(other.max > max)
+            max = other.max;
+        count += other.count;
+        sum += other.sum;
+    }
+
+    uint64_t percentile(double p) const
+    {
+        if(count == 0)
+            return 0;
+        unsigned long long rank = (unsigned long long) (p / 100.0 * count + 0.5);
+        if(rank == 0)
+            rank = 1;
+        unsigned long long seen = 0;
+        for(int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        {
+            seen += counts[i];
+            if(seen >= rank)
+                return bound(i) < max ? bound(i) : max;
+        }
+        return max;
+    }
+};
+
+struct options
+{
+    std::string scenario;
+    int connections;
+    int threads;
+    int duration;
+    double rate;
+    int depth;
+    bool keep_alive;
+    size_t body;
+    int ids;
+    uint16_t port;
+    int server_threads;
+    std::string external;
+    struct sockaddr_in target;
+};
+
+/**
+ * Incremental parser of the responses read on a connection. Bodies are
+ * skipped unless a string is given to collect them; chunked bodies are
+ * collected as they come, so that streams never ending (comet) can be
+ * read too.
+**/
+class response_parser
+{
+    public:
+        std::string buffer;
+        int status;
+        bool close;
+
+        response_parser():
+            status(0),
+            close(false),
+            state(HEAD),
+            pos(0),
+            remaining(0)
+        {
+        }
+
+        void reset()
+        {
+            buffer.clear();
+            state = HEAD;
+            pos = 0;
+        }
+
+        //1: a response is complete; 0: more bytes are needed; -1: garbage
+        int parse(std::string* body)
+        {
+            while(true)
+            {
+                switch(state)
+                {
+                    case HEAD:
+                        if(!parse_head())
+                        {
+                            if(buffer.size() - pos >= 5 &&
+                                    buffer.compare(pos, 5, "HTTP/") != 0)
+                                return -1;
+                            return wait();
+                        }
+                        if(status == 0)
+                            return -1;
+                        break;
+                    case BODY:
+                    case CHUNK_DATA:
+                    {
+                        size_t take = buffer.size() - pos < remaining ?
+                            buffer.size() - pos : remaining;
+                        if(body != 0x0)
+                            body->append(buffer, pos, take);
+                        pos += take;
+                        remaining -= take;
+                        if(remaining > 0)
+                            return wait();
+                        if(state == BODY)
+                        {
+                            state = HEAD;
+                            return 1;
+                        }
+                        state = CHUNK_END;
+                        break;
+                    }
+                    case CHUNK_SIZE:
+                    {
+                        size_t eol = buffer.find("\r\n", pos);
+                        if(eol == std::string::npos)
+                            return wait();
+                        remaining = strtoul(buffer.c_str() + pos, 0x0, 16);
+                        pos = eol + 2;
+                        state = remaining == 0 ? TRAILERS : CHUNK_DATA;
+                        break;
+                    }
+                    case CHUNK_END:
+                        if(buffer.size() - pos < 2)
+                            return wait();
+                        pos += 2;
+                        state = CHUNK_SIZE;
+                        break;
+                    case TRAILERS:
+                    {
+                        size_t eol = buffer.find("\r\n", pos);
+                        if(eol == std::string::npos)
+                            return wait();
+                        bool last = eol == pos;
+                        pos = eol + 2;
+                        if(last)
+                        {
+                            state = HEAD;
+                            return 1;
+                        }
+                        break;
+                    }
+                }
+            }
+        }
+
+    private:
+        enum state_T { HEAD, BODY, CHUNK_SIZE, CHUNK_DATA, CHUNK_END, TRAILERS };
+
+        state_T state;
+        size_t pos;
+        size_t remaining;
+
+        int wait()
+        {
+            if(pos == buffer.size())
+            {
+                buffer.clear();
+                pos = 0;
+            }
+            else if(pos > 65536)
+            {
+                buffer.erase(0, pos);
+                pos = 0;
+            }
+            return 0;
+        }
+
+        bool header_is(size_t line, const char* name)
+        {
+            return strncasecmp(buffer.c_str() + line, name, strlen(name)) == 0;
+        }
+
+        bool parse_head()
+        {
+            size_t end = buffer.find("\r\n\r\n", pos);
+            if(end == std::string::npos)
+                return false;
+            status = 0;
+            if(buffer.compare(pos, 5, "HTTP/") == 0 && end - pos > 12)
+                status = atoi(buffer.c_str() + pos + 9);
+            close = buffer.compare(pos, 8, "HTTP/1.0") == 0;
+            bool chunked = false;
+            remaining = 0;
+            size_t line = buffer.find("\r\n", pos) + 2;
+            while(line < end + 2)
+            {
+                size_t eol = buffer.find("\r\n", line);
+                std::string value;
+                size_t colon = buffer.find(':', line);
+                if(colon != std::string::npos && colon < eol)
+                    value = buffer.substr(colon + 1, eol - colon - 1);
+                if(header_is(line, "content-length:"))
+                    remaining = strtoul(value.c_str(), 0x0, 10);
+                else if(header_is(line, "transfer-encoding:"))
+                    chunked = strcasestr(value.c_str(), "chunked") != 0x0;
+                else if(header_is(line, "connection:"))
+                    close = strcasestr(value.c_str(), "close") != 0x0;
+                line = eol + 2;
+            }
+            pos = end + 4;
+            state = chunked ? CHUNK_SIZE : BODY;
+            return true;
+        }
+};
+
+struct connection
+{
+    int fd;
+    std::string out;
+    size_t written;
+    //the times the requests in flight were due (open loop) or sent
+    std::deque<uint64_t> in_flight;
+    response_parser parser;
+    //comet subscribers collect their stream
+    std::string stream;
+
+    connection():
+        fd(-1),
+        written(0)
+    {
+    }
+};
+
+struct client
+{
+    const options* opts;
+    const std::vector<std::string>* requests;
+    int first;
+    int connections;
+    double rate;
+    uint64_t start;
+    pthread_t thread;
+
+    histogram latency;
+    unsigned long long responses;
+    unsigned long long non_2xx;
+    unsigned long long errors;
+    unsigned long long bytes;
+    unsigned long long unsent;
+    unsigned long long connects;
+
+    client():
+        responses(0),
+        non_2xx(0),
+        errors(0),
+        bytes(0),
+        unsent(0),
+        connects(0)
+    {
+    }
+};
+
+static const char comet_subscribe[] =
+    "GET /comet/listen HTTP/1.1\r\nHost: loadgen\r\n\r\n";
+
+static bool open_connection(client* cl, int epoll_fd, connection& c)
+{
+    c.fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(c.fd == -1)
+        return false;
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if(!cl->opts->keep_alive)
+    {
+        //a connection per request would exhaust the ports in TIME_WAIT
+        struct linger abort = { 1, 0 };
+        setsockopt(c.fd, SOL_SOCKET, SO_LINGER, &abort, sizeof(abort));
+    }
+    if(connect(c.fd, (const struct sockaddr*) &cl->opts->target,
+                sizeof(cl->opts->target)) == -1 && errno != EINPROGRESS)
+    {
+        close(c.fd);
+        c.fd = -1;
+        return false;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = &c;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, c.fd, &event);
+    c.out.clear();
+    c.written = 0;
+    c.in_flight.clear();
+    c.parser.reset();
+    c.stream.clear();
+    cl->connects++;
+    return true;
+}
+
+static void flush(client* cl, connection& c)
+{
+    while(c.written < c.out.size())
+    {
+        ssize_t n = send(c.fd, c.out.data() + c.written,
+                c.out.size() - c.written, MSG_NOSIGNAL);
+        if(n <= 0)
+            break;
+        c.written += n;
+    }
+    if(c.written == c.out.size())
+    {
+        c.out.clear();
+        c.written = 0;
+    }
+}
+
+static void send_request(client* cl, connection& c, uint64_t stamp,
+        unsigned long& sequence
+)
+{
+    const std::vector<std::string>& requests = *cl->requests;
+    c.out += requests[sequence++ % requests.size()];
+    c.in_flight.push_back(stamp);
+}
+
+static bool has_room(client* cl, const connection& c)
+{
+    return c.fd != -1 && (int) c.in_flight.size() <
+        (cl->opts->keep_alive ? cl->opts->depth : 1);
+}
+
+static void reopen(client* cl, int epoll_fd, connection& c, bool failed)
+{
+    if(failed)
+        cl->errors += c.in_flight.empty() ? 1 : c.in_flight.size();
+    close(c.fd);
+    c.fd = -1;
+    if(open_connection(cl, epoll_fd, c) && cl->opts->scenario == "comet")
+    {
+        c.out = comet_subscribe;
+        flush(cl, c);
+    }
+}
+
+//lines of the stream are the times the messages have been published at
+static void read_messages(client* cl, connection& c, uint64_t now)
+{
+    size_t begin = 0;
+    size_t eol;
+    while((eol = c.stream.find('\n', begin)) != std::string::npos)
+    {
+        uint64_t published = strtoull(c.stream.c_str() + begin, 0x0, 10);
+        if(published > 0 && published <= now)
+        {
+            cl->latency.add(now - published);
+            cl->responses++;
+        }
+        begin = eol + 1;
+    }
+    c.stream.erase(0, begin);
+}
+
+static void* run_client(void* arg)
+{
+    client* cl = static_cast<client*>(arg);
+    const options& opts = *cl->opts;
+    bool comet = opts.scenario == "comet";
+    bool open_loop = opts.rate > 0 && !comet;
+    int epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    std::vector<connection> conns(cl->connections);
+    unsigned long sequence = cl->first;
+
+    for(unsigned int i = 0; i < conns.size(); i++)
+    {
+        if(!open_connection(cl, epoll_fd, conns[i]))
+        {
+            cl->errors++;
+            continue;
+        }
+        if(comet)
+            conns[i].out = comet_subscribe;
+        else if(!open_loop)
+            send_request(cl, conns[i], now_us(), sequence);
+        flush(cl, conns[i]);
+    }
+
+    uint64_t deadline = cl->start + (uint64_t) opts.duration * 1000000;
+    double interval = open_loop ? 1000000.0 / cl->rate : 0;
+    unsigned long long due_count = 0;
+    uint64_t next_due = cl->start;
+    std::deque<uint64_t> pending;
+    unsigned int next_conn = 0;
+    struct epoll_event events[256];
+    char buf[65536];
+
+    while(true)
+    {
+        uint64_t now = now_us();
+        if(now >= deadline)
+            break;
+
+        if(open_loop)
+        {
+            while(next_due <= now)
+            {
+                pending.push_back(next_due);
+                next_due = cl->start + (uint64_t) (++due_count * interval);
+            }
+            //round robin over the connections with room for a request
+            unsigned int tried = 0;
+            while(!pending.empty() && tried < conns.size())
+            {
+                connection& c = conns[next_conn];
+                next_conn = (next_conn + 1) % conns.size();
+                if(!has_room(cl, c))
+                {
+                    tried++;
+                    continue;
+                }
+                tried = 0;
+                c.out += (*cl->requests)[sequence++ % cl->requests->size()];
+                c.in_flight.push_back(pending.front());
+                pending.pop_front();
+                flush(cl, c);
+            }
+        }
+
+        int timeout = (int) ((deadline - now) / 1000);
+        if(open_loop)
+            timeout = next_due > now ? (int) ((next_due - now) / 1000) : 0;
+        if(timeout > 100)
+            timeout = 100;
+        int ready = epoll_wait(epoll_fd, events, 256, timeout);
+        now = now_us();
+        for(int i = 0; i < ready; i++)
+        {
+            connection& c = *static_cast<connection*>(events[i].data.ptr);
+            if(c.fd == -1)
+                continue;
+            if(events[i].events & EPOLLOUT)
+                flush(cl, c);
+            if(!(events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLERR | EPOLLHUP)))
+                continue;
+
+            bool closed = false;
+            while(true)
+            {
+                ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+                if(n > 0)
+                {
+                    cl->bytes += n;
+                    c.parser.buffer.append(buf, n);
+                    continue;
+                }
+                closed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+                break;
+            }
+
+            bool reconnect = closed;
+            int parsed;
+            while((parsed = c.parser.parse(comet ? &c.stream : 0x0)) == 1)
+            {
+                if(c.in_flight.empty())
+                {
+                    //answers to nothing: the connection is out of sync
+                    parsed = -1;
+                    break;
+                }
+                if(now < deadline)
+                {
+                    cl->latency.add(now - c.in_flight.front());
+                    cl->responses++;
+                    if(c.parser.status < 200 || c.parser.status > 299)
+                        cl->non_2xx++;
+                }
+                c.in_flight.pop_front();
+                if(c.parser.close || !opts.keep_alive)
+                {
+                    reconnect = true;
+                    break;
+                }
+                if(!open_loop)
+                    send_request(cl, c, now, sequence);
+            }
+            if(comet)
+                read_messages(cl, c, now);
+            if(parsed == -1 || reconnect)
+            {
+                reopen(cl, epoll_fd, c, parsed == -1 || !c.in_flight.empty() ||
+                        (closed && comet));
+                if(!open_loop && !comet && c.fd != -1)
+                    send_request(cl, c, now_us(), sequence);
+            }
+            if(c.fd != -1)
+                flush(cl, c);
+        }
+    }
+
+    //the requests still due when the run ends never got a chance
+    cl->unsent = pending.size();
+    for(unsigned int i = 0; i < conns.size(); i++)
+    {
+        if(conns[i].fd != -1)
+            close(conns[i].fd);
+    }
+    close(epoll_fd);
+    return 0x0;
+}
+
+struct publisher
+{
+    const options* opts;
+    uint64_t start;
+    pthread_t thread;
+    unsigned long long published;
+    unsigned long long errors;
+};
+
+//publishes on a blocking connection of its own
+static void* run_publisher(void* arg)
+{
+    publisher* pub = static_cast<publisher*>(arg);
+    const options& opts = *pub->opts;
+    double rate = opts.rate > 0 ? opts.rate : 10;
+    uint64_t deadline = pub->start + (uint64_t) opts.duration * 1000000;
+    int fd = -1;
+    response_parser parser;
+    char buf[4096];
+
+    //let the subscribers subscribe
+    for(unsigned long long k = 0; ; k++)
+    {
+        uint64_t due = pub->start + 500000 + (uint64_t) (k * 1000000.0 / rate);
+        uint64_t now = now_us();
+        if(due >= deadline)
+            break;
+        if(due > now)
+            usleep(due - now);
+        if(fd == -1)
+        {
+            fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if(connect(fd, (const struct sockaddr*) &opts.target,
+                        sizeof(opts.target)) == -1)
+            {
+                close(fd);
+                fd = -1;
+                pub->errors++;
+                continue;
+            }
+            parser.reset();
+        }
+        char message[32];
+        int length = snprintf(message, sizeof(message), "%llu\n",
+                (unsigned long long) now_us());
+        char request[256];
+        int size = snprintf(request, sizeof(request),
+                "POST /comet/send HTTP/1.1\r\nHost: loadgen\r\n"
+                "Content-Length: %d\r\n\r\n%s", length, message);
+        int parsed = 0;
+        if(send(fd, request, size, MSG_NOSIGNAL) == size)
+        {
+            while((parsed = parser.parse(0x0)) == 0)
+            {
+                ssize_t n = recv(fd, buf, sizeof(buf), 0);
+                if(n <= 0)
+                    break;
+                parser.buffer.append(buf, n);
+            }
+        }
+        if(parsed == 1 && parser.status == 200)
+            pub->published++;
+        else
+            pub->errors++;
+        if(parsed != 1 || parser.close)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if(fd != -1)
+        close(fd);
+    return 0x0;
+}
+
+class string_resource : public http_resource {
+    public:
+        explicit string_resource(size_t size):
+            body(size, 's')
+        {
+        }
+
+        //copied in every response
+        void render_GET(const http_request& req, http_response** res)
+        {
+            *res = http_response_builder(body, 200, "text/plain").string_response().build();
+        }
+
+    private:
+        std::string body;
+};
+
+class file_resource : public http_resource {
+    public:
+        explicit file_resource(const std::string& filename):
+            filename(filename)
+        {
+        }
+
+        void render_GET(const http_request& req, http_response** res)
+        {
+            *res = http_response_builder(filename, 200, "application/octet-stream").file_response().build();
+        }
+
+    private:
+        std::string filename;
+};
+
+class cached_resource : public http_resource {
+    public:
+        explicit cached_resource(size_t size):
+            content(std::string(size, 'c'))
+        {
+            fixed_headers.with_header("Cache-Control", "max-age=3600");
+        }
+
+        //built once: every response references the same bytes and headers
+        void render_GET(const http_request& req, http_response** res)
+        {
+            *res = http_response_builder(content, 200, "text/plain")
+                .with_header_template(fixed_headers).string_response().build();
+        }
+
+    private:
+        shared_buffer content;
+        header_template fixed_headers;
+};
+
+class post_resource : public http_resource {
+    public:
+        void render_POST(const http_request& req, http_response** res)
+        {
+            char received[32];
+            snprintf(received, sizeof(received), "%lu",
+                    (unsigned long) req.get_content().size());
+            *res = http_response_builder(received, 200, "text/plain").string_response().build();
+        }
+};
+
+class params_resource : public http_resource {
+    public:
+        void render_GET(const http_request& req, http_response** res)
+        {
+            *res = http_response_builder("item " + req.get_arg("id"), 200, "text/plain").string_response().build();
+        }
+};
+
+class comet_listen_resource : public http_resource {
+    public:
+        void render_GET(const http_request& req, http_response** res)
+        {
+            std::vector<std::string> topics(1, COMET_TOPIC);
+            *res = new http_response(http_response_builder("", 200).long_polling_receive_response(topics));
+        }
+};
+
+class comet_send_resource : public http_resource {
+    public:
+        void render_POST(const http_request& req, http_response** res)
+        {
+            *res = new http_response(http_response_builder(req.get_content(), 200).long_polling_send_response(COMET_TOPIC));
+        }
+};
+
+static void build_requests(const options& opts, std::vector<std::string>& requests)
+{
+    std::string close = opts.keep_alive ? "" : "Connection: close\r\n";
+    if(opts.scenario == "post")
+    {
+        char head[128];
+        snprintf(head, sizeof(head), "POST /post HTTP/1.1\r\nHost: loadgen\r\n"
+                "Content-Type: application/octet-stream\r\n"
+                "Content-Length: %lu\r\n", (unsigned long) opts.body);
+        requests.push_back(head + close + "\r\n" + std::string(opts.body, 'p'));
+    }
+    else if(opts.scenario == "params")
+    {
+        for(int i = 0; i < opts.ids; i++)
+        {
+            char line[64];
+            snprintf(line, sizeof(line), "GET /items/%d/details HTTP/1.1\r\n", i);
+            requests.push_back(line + std::string("Host: loadgen\r\n") + close + "\r\n");
+        }
+    }
+    else
+    {
+        requests.push_back("GET /" + opts.scenario + " HTTP/1.1\r\n"
+                "Host: loadgen\r\n" + close + "\r\n");
+    }
+}
+
+void usage()
+{
+    std::cout << "Usage:" << std::endl
+              << "loadgen [-s <scenario>][-c <connections>][-t <threads>][-d <seconds>][-r <rate>][-P <depth>][-k][-b <bytes>][-n <ids>][-p <port>][-T <threads>][-x <ip>:<port>]" << std::endl
+              << "  -s string, file, cached, post, params or comet (default string)" << std::endl
+              << "  -c connections (comet: subscribers), spread over -t client threads" << std::endl
+              << "  -d length of the run in seconds" << std::endl
+              << "  -r requests per second over all the connections (open loop);" << std::endl
+              << "     without it each connection sends as fast as it is answered" << std::endl
+              << "     (comet: messages published per second, default 10)" << std::endl
+              << "  -P requests pipelined on each connection" << std::endl
+              << "  -k close the connection after each response" << std::endl
+              << "  -b size of the responses (string, file, cached) or of the posted bodies" << std::endl
+              << "  -n distinct ids requested in the params scenario" << std::endl
+              << "  -p port of the embedded server, run by -T threads" << std::endl
+              << "  -x drive the server at <ip>:<port> instead of the embedded one" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    options opts;
+    opts.scenario = "string";
+    opts.connections = 64;
+    opts.threads = 2;
+    opts.duration = 10;
+    opts.rate = 0;
+    opts.depth = 1;
+    opts.keep_alive = true;
+    opts.body = 128;
+    opts.ids = 1000;
+    opts.port = 8080;
+    opts.server_threads = 4;
+    int c;
+
+    while ((c = getopt(argc, argv, "s:c:t:d:r:P:kb:n:p:T:x:?")) != EOF) {
+        switch (c) {
+        case 's':
+            opts.scenario = optarg;
+            break;
+        case 'c':
+            opts.connections = atoi(optarg);
+            break;
+        case 't':
+            opts.threads = atoi(optarg);
+            break;
+        case 'd':
+            opts.duration = atoi(optarg);
+            break;
+        case 'r':
+            opts.rate = atof(optarg);
+            break;
+        case 'P':
+            opts.depth = atoi(optarg);
+            break;
+        case 'k':
+            opts.keep_alive = false;
+            break;
+        case 'b':
+            opts.body = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            opts.ids = atoi(optarg);
+            break;
+        case 'p':
+            opts.port = strtoul(optarg, NULL, 10);
+            break;
+        case 'T':
+            opts.server_threads = atoi(optarg);
+            break;
+        case 'x':
+            opts.external = optarg;
+            break;
+        default:
+            usage();
+            exit(1);
+            break;
+        }
+    }
+    const char* scenarios[] = { "string", "file", "cached", "post", "params", "comet" };
+    bool known = false;
+    for(unsigned int i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++)
+        known = known || opts.scenario == scenarios[i];
+    if(!known || opts.connections < 1 || opts.threads < 1 || opts.duration < 1 ||
+            opts.depth < 1 || opts.ids < 1)
+    {
+        usage();
+        exit(1);
+    }
+    if(opts.threads > opts.connections)
+        opts.threads = opts.connections;
+
+    memset(&opts.target, 0, sizeof(opts.target));
+    opts.target.sin_family = AF_INET;
+    opts.target.sin_port = htons(opts.port);
+    opts.target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if(!opts.external.empty())
+    {
+        size_t colon = opts.external.rfind(':');
+        if(colon == std::string::npos ||
+                inet_pton(AF_INET, opts.external.substr(0, colon).c_str(),
+                    &opts.target.sin_addr) != 1)
+        {
+            usage();
+            exit(1);
+        }
+        opts.target.sin_port = htons(atoi(opts.external.c_str() + colon + 1));
+    }
+
+    webserver* ws = 0x0;
+    char filename[] = "/tmp/loadgen.XXXXXX";
+    std::vector<http_resource*> resources;
+    if(opts.external.empty())
+    {
+        bool file_created = false;
+        int fd = mkstemp(filename);
+        if(fd != -1)
+        {
+            std::string content(opts.body, 'f');
+            file_created = write(fd, content.data(), content.size()) ==
+                (ssize_t) content.size();
+            close(fd);
+        }
+        if(!file_created)
+        {
+            std::cerr << "Unable to create the file served" << std::endl;
+            exit(1);
+        }
+
+        //nothing leaves the loopback interface
+        ws = new webserver(create_webserver(opts.port)
+            .bind_address((const struct sockaddr*) &opts.target)
+            .start_method(http::http_utils::INTERNAL_SELECT)
+            .max_threads(opts.server_threads)
+            .comet());
+        const char* routes[] = { "/string", "/file", "/cached", "/post",
+            "/items/{id}/details", "/comet/listen", "/comet/send" };
+        resources.push_back(new string_resource(opts.body));
+        resources.push_back(new file_resource(filename));
+        resources.push_back(new cached_resource(opts.body));
+        resources.push_back(new post_resource());
+        resources.push_back(new params_resource());
+        resources.push_back(new comet_listen_resource());
+        resources.push_back(new comet_send_resource());
+        for(unsigned int i = 0; i < resources.size(); i++)
+            ws->register_resource(routes[i], resources[i]);
+        ws->start(false);
+    }
+
+    std::vector<std::string> requests;
+    build_requests(opts, requests);
+
+    uint64_t start = now_us();
+    std::vector<client> clients(opts.threads);
+    int first = 0;
+    for(int i = 0; i < opts.threads; i++)
+    {
+        clients[i].opts = &opts;
+        clients[i].requests = &requests;
+        clients[i].connections = opts.connections / opts.threads +
+            (i < opts.connections % opts.threads ? 1 : 0);
+        clients[i].first = first;
+        clients[i].rate = opts.rate * clients[i].connections / opts.connections;
+        clients[i].start = start;
+        first += clients[i].connections;
+        pthread_create(&clients[i].thread, NULL, &run_client, &clients[i]);
+    }
+    publisher pub;
+    pub.opts = &opts;
+    pub.start = start;
+    pub.published = 0;
+    pub.errors = 0;
+    if(opts.scenario == "comet")
+        pthread_create(&pub.thread, NULL, &run_publisher, &pub);
+
+    histogram latency;
+    unsigned long long responses = 0, non_2xx = 0, errors = 0, bytes = 0;
+    unsigned long long unsent = 0, connects = 0;
+    for(int i = 0; i < opts.threads; i++)
+    {
+        pthread_join(clients[i].thread, NULL);
+        latency.merge(clients[i].latency);
+        responses += clients[i].responses;
+        non_2xx += clients[i].non_2xx;
+        errors += clients[i].errors;
+        bytes += clients[i].bytes;
+        unsent += clients[i].unsent;
+        connects += clients[i].connects;
+    }
+    if(opts.scenario == "comet")
+    {
+        pthread_join(pub.thread, NULL);
+        errors += pub.errors;
+    }
+    double elapsed = (now_us() - start) / 1000000.0;
+
+    if(ws != 0x0)
+    {
+        ws->stop();
+        delete ws;
+        for(unsigned int i = 0; i < resources.size(); i++)
+            delete resources[i];
+        unlink(filename);
+    }
+
+    printf("{\n");
+    printf("  \"scenario\": \"%s\",\n", opts.scenario.c_str());
+    printf("  \"target\": \"%s\",\n", opts.external.empty() ? "embedded" : opts.external.c_str());
+    printf("  \"connections\": %d,\n", opts.connections);
+    printf("  \"threads\": %d,\n", opts.threads);
+    printf("  \"pipeline\": %d,\n", opts.depth);
+    printf("  \"keep_alive\": %s,\n", opts.keep_alive ? "true" : "false");
+    printf("  \"mode\": \"%s\",\n", opts.rate > 0 && opts.scenario != "comet" ? "open_loop" : "closed_loop");
+    printf("  \"target_rate\": %.1f,\n", opts.rate);
+    printf("  \"body_bytes\": %lu,\n", (unsigned long) opts.body);
+    printf("  \"duration_s\": %.3f,\n", elapsed);
+    if(opts.scenario == "comet")
+    {
+        printf("  \"published\": %llu,\n", pub.published);
+        printf("  \"delivered\": %llu,\n", responses);
+        printf("  \"expected\": %llu,\n", pub.published * opts.connections);
+    }
+    else
+    {
+        printf("  \"requests\": %llu,\n", responses);
+        printf("  \"non_2xx\": %llu,\n", non_2xx);
+        printf("  \"unsent\": %llu,\n", unsent);
+    }
+    printf("  \"errors\": %llu,\n", errors);
+    printf("  \"connects\": %llu,\n", connects);
+    printf("  \"throughput_rps\": %.1f,\n", responses / elapsed);
+    printf("  \"throughput_mbps\": %.3f,\n", bytes * 8 / elapsed / 1000000.0);
+    printf("  \"latency_us\": {\n");
+    printf("    \"min\": %llu,\n", (unsigned long long) latency.min);
+    printf("    \"mean\": %.1f,\n", latency.count > 0 ? (double) latency.sum / latency.count : 0.0);
+    printf("    \"p50\": %llu,\n", (unsigned long long) latency.percentile(50));
+    printf("    \"p90\": %llu,\n", (unsigned long long) latency.percentile(90));
+    printf("    \"p99\": %llu,\n", (unsigned long long) latency.percentile(99));
+    printf("    \"p99_9\": %llu,\n", (unsigned long long) latency.percentile(99.9));
+    printf("    \"p99_99\": %llu,\n", (unsigned long long) latency.percentile(99.99));
+    printf("    \"max\": %llu\n", (unsigned long long) latency.max);
+    printf("  }\n");
+    printf("}\n");
+    return errors > 0 ? 2 : 0;
+}
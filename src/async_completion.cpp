@@ -0,0 +1,178 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <microhttpd.h>
+#include "http_utils.hpp"
+#include "async_completion.hpp"
+#include "http_request.hpp"
+#include "http_response.hpp"
+#include "request_trace.hpp"
+#include "details/atomics.hpp"
+
+namespace httpserver
+{
+
+async_completion::async_completion(
+        MHD_Connection* connection,
+        http_resource* resource,
+        render_ptr callback,
+        const http_request* request,
+        request_trace* trace
+):
+    //one for the request, one for the pending call to complete
+    num_references(2),
+    completed(false),
+    suspended(false),
+    abandoned(false),
+    cancelled(false),
+    answered(false),
+    response(0x0),
+    connection(connection),
+    resource(resource),
+    callback(callback),
+    request(request),
+    trace(trace)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+async_completion::~async_completion()
+{
+    if(response != 0x0)
+        delete response;
+    delete request;
+    delete trace;
+    pthread_mutex_destroy(&lock);
+}
+
+void async_completion::complete(http_response* response)
+{
+    pthread_mutex_lock(&lock);
+    if(answered)
+    {
+        //a render task failing after its render_async completed
+        pthread_mutex_unlock(&lock);
+        if(response != 0x0)
+            delete response;
+        return;
+    }
+    answered = true;
+    if(completed || abandoned)
+    {
+        pthread_mutex_unlock(&lock);
+        if(response != 0x0)
+            delete response;
+        release();
+        return;
+    }
+    this->response = response;
+    completed = true;
+    bool resume = suspended;
+    suspended = false;
+    pthread_mutex_unlock(&lock);
+
+    if(resume)
+        MHD_resume_connection(connection);
+    release();
+}
+
+void async_completion::cancel()
+{
+    pthread_mutex_lock(&lock);
+    if(completed || abandoned)
+    {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    completed = true;
+    cancelled = true;
+    bool resume = suspended;
+    suspended = false;
+    pthread_mutex_unlock(&lock);
+
+    if(resume)
+        MHD_resume_connection(connection);
+}
+
+bool async_completion::is_cancelled()
+{
+    pthread_mutex_lock(&lock);
+    bool result = cancelled;
+    pthread_mutex_unlock(&lock);
+    return result;
+}
+
+bool async_completion::suspend_unless_completed(bool can_suspend)
+{
+    pthread_mutex_lock(&lock);
+    if(completed)
+    {
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+    if(!can_suspend)
+    {
+        //nothing would ever resume the connection
+        abandoned = true;
+        pthread_mutex_unlock(&lock);
+        return false;
+    }
+    MHD_suspend_connection(connection);
+    suspended = true;
+    pthread_mutex_unlock(&lock);
+    return true;
+}
+
+bool async_completion::is_completed()
+{
+    pthread_mutex_lock(&lock);
+    bool result = completed;
+    pthread_mutex_unlock(&lock);
+    return result;
+}
+
+http_response* async_completion::take_response()
+{
+    pthread_mutex_lock(&lock);
+    http_response* result = response;
+    response = 0x0;
+    pthread_mutex_unlock(&lock);
+    return result;
+}
+
+void async_completion::retain()
+{
+    atomic_increment(&num_references);
+}
+
+void async_completion::abandon()
+{
+    pthread_mutex_lock(&lock);
+    abandoned = true;
+    pthread_mutex_unlock(&lock);
+}
+
+void async_completion::release()
+{
+    if(atomic_decrement(&num_references) == 0)
+        delete this;
+}
+
+};
@@ -0,0 +1,97 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <time.h>
+
+#include "details/abuse_detector.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+static double monotonic_seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+abuse_detector::abuse_detector(int threshold, int window_seconds,
+        int ban_seconds, size_t max_clients
+):
+    threshold(threshold),
+    window_seconds(window_seconds > 0 ? window_seconds : 1),
+    ban_seconds(ban_seconds),
+    bans(0),
+    clients(max_clients)
+{
+}
+
+bool abuse_detector::record(const struct sockaddr* addr)
+{
+    uint64_t key;
+    if(!client_key(addr, key))
+        return false;
+
+    bool created;
+    double now = monotonic_seconds();
+    long window = (long) (now / window_seconds);
+    client* c = clients.lock(key, true, created);
+    if(created || window > c->window + 1)
+        c->previous = c->current = 0;
+    else if(window == c->window + 1)
+    {
+        c->previous = c->current;
+        c->current = 0;
+    }
+    c->window = window;
+    c->current++;
+
+    double elapsed = now / window_seconds - window;
+    bool ban = c->previous * (1 - elapsed) + c->current >= threshold &&
+        c->banned_until <= now;
+    if(ban)
+    {
+        c->banned_until = now + ban_seconds;
+        c->previous = c->current = 0;
+        __sync_add_and_fetch(&bans, 1);
+    }
+    clients.unlock(key);
+    return ban;
+}
+
+bool abuse_detector::banned(const struct sockaddr* addr)
+{
+    uint64_t key;
+    if(!client_key(addr, key))
+        return false;
+
+    bool created;
+    client* c = clients.lock(key, false, created);
+    bool result = c != 0x0 && c->banned_until > monotonic_seconds();
+    clients.unlock(key);
+    return result;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,252 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "details/admission_gate.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+//requests per adaptation step
+#define ADMISSION_WINDOW 32
+//latency over the lowest observed that is taken as queueing
+#define ADMISSION_TOLERANCE 2.0
+//steps after which the lowest latency is measured again
+#define ADMISSION_RESET_WINDOWS 64
+
+static void now(struct timespec* ts)
+{
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, ts);
+#else
+    clock_gettime(CLOCK_REALTIME, ts);
+#endif
+}
+
+admission_gate::admission_gate(int max_in_flight, int max_queued,
+        bool adaptive
+):
+    max_in_flight(max_in_flight > 0 ? max_in_flight : 1),
+    max_queued(max_queued > 0 ? max_queued : 0),
+    adaptive(adaptive),
+    limit(max_in_flight > 0 ? max_in_flight : 1),
+    in_flight(0),
+    rejected(0),
+    closed(false),
+    saturated(false),
+    samples(0),
+    latency_sum(0),
+    min_latency(0),
+    windows(0)
+{
+    pthread_mutex_init(&lock, NULL);
+}
+
+admission_gate::~admission_gate()
+{
+    pthread_mutex_destroy(&lock);
+}
+
+void admission_gate::grant(admission_ticket& ticket)
+{
+    ticket.gate = this;
+    ticket.queued_on = 0x0;
+    now(&ticket.since);
+}
+
+admission_gate::result_T admission_gate::acquire(
+        admission_ticket& ticket,
+        struct MHD_Connection* connection,
+        bool can_queue,
+        priority_T priority
+)
+{
+    pthread_mutex_lock(&lock);
+    if(in_flight < limit && waiters.empty())
+    {
+        in_flight++;
+        grant(ticket);
+        pthread_mutex_unlock(&lock);
+        return ADMITTED;
+    }
+    saturated = true;
+    can_queue = can_queue && !closed;
+    if(can_queue && max_queued > 0 && waiters.size() == (size_t) max_queued)
+    {
+        //a full queue sheds its lowest class first
+        waiter evicted;
+        if(waiters.evict_below(priority, evicted))
+            reject(evicted);
+    }
+    if(can_queue && waiters.size() < (size_t) max_queued)
+    {
+        //suspended before it can be found in the queue, so that a release
+        //on another thread never resumes a connection still running.
+        MHD_suspend_connection(connection);
+        waiter w;
+        w.ticket = &ticket;
+        w.connection = connection;
+        waiters.push(w, priority);
+        ticket.queued_on = this;
+        pthread_mutex_unlock(&lock);
+        return QUEUED;
+    }
+    rejected++;
+    pthread_mutex_unlock(&lock);
+    return REJECTED;
+}
+
+void admission_gate::release(admission_ticket& ticket)
+{
+    pthread_mutex_lock(&lock);
+    if(ticket.queued_on == this)
+    {
+        waiter w;
+        w.ticket = &ticket;
+        waiters.remove(w);
+        ticket.queued_on = 0x0;
+    }
+    else if(ticket.gate == this)
+    {
+        ticket.gate = 0x0;
+        in_flight--;
+        if(adaptive)
+        {
+            struct timespec end;
+            now(&end);
+            sample((end.tv_sec - ticket.since.tv_sec) * 1000.0 +
+                    (end.tv_nsec - ticket.since.tv_nsec) / 1000000.0
+            );
+        }
+        grant_waiters();
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void admission_gate::grant_waiters()
+{
+    while(in_flight < limit && !waiters.empty())
+    {
+        waiter w;
+        waiters.pop(w);
+        in_flight++;
+        grant(*w.ticket);
+        MHD_resume_connection(w.connection);
+    }
+}
+
+void admission_gate::sample(double latency)
+{
+    if(min_latency == 0 || latency < min_latency)
+        min_latency = latency;
+    latency_sum += latency;
+    if(++samples < ADMISSION_WINDOW)
+        return;
+
+    double average = latency_sum / samples;
+    if(average > min_latency * ADMISSION_TOLERANCE)
+    {
+        int decrease = limit / 10;
+        limit -= decrease > 0 ? decrease : 1;
+        if(limit < 1)
+            limit = 1;
+    }
+    else if(saturated && limit < max_in_flight)
+    {
+        limit++;
+    }
+
+    if(++windows == ADMISSION_RESET_WINDOWS)
+    {
+        windows = 0;
+        min_latency = average;
+    }
+    samples = 0;
+    latency_sum = 0;
+    saturated = false;
+}
+
+void admission_gate::reject(const waiter& w)
+{
+    w.ticket->queued_on = 0x0;
+    w.ticket->rejected = true;
+    rejected++;
+    MHD_resume_connection(w.connection);
+}
+
+void admission_gate::reject_waiters()
+{
+    pthread_mutex_lock(&lock);
+    closed = true;
+    while(!waiters.empty())
+    {
+        waiter w;
+        waiters.pop(w);
+        reject(w);
+    }
+    pthread_mutex_unlock(&lock);
+}
+
+void admission_gate::reopen()
+{
+    pthread_mutex_lock(&lock);
+    closed = false;
+    pthread_mutex_unlock(&lock);
+}
+
+int admission_gate::get_limit()
+{
+    pthread_mutex_lock(&lock);
+    int l = limit;
+    pthread_mutex_unlock(&lock);
+    return l;
+}
+
+int admission_gate::get_in_flight()
+{
+    pthread_mutex_lock(&lock);
+    int n = in_flight;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+int admission_gate::get_queued()
+{
+    pthread_mutex_lock(&lock);
+    int n = waiters.size();
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+unsigned long admission_gate::get_rejected()
+{
+    pthread_mutex_lock(&lock);
+    unsigned long n = rejected;
+    pthread_mutex_unlock(&lock);
+    return n;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,72 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string.h>
+
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include "details/client_table.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+//IPv4 addresses are kept whole in the low 32 bits with a tag in the high
+//ones (ffff:ffff::/32 is not allocated)
+bool client_key(const struct sockaddr* addr, uint64_t& key)
+{
+    const unsigned char* bytes;
+    if(addr->sa_family == AF_INET)
+        bytes = (const unsigned char*) &((const struct sockaddr_in*) addr)->sin_addr;
+    else if(addr->sa_family == AF_INET6)
+    {
+        static const unsigned char mapped[12] = {
+            0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF
+        };
+        bytes = (const unsigned char*) &((const struct sockaddr_in6*) addr)->sin6_addr;
+        if(memcmp(bytes, mapped, 12) != 0)
+        {
+            key = 0;
+            for(int i = 0; i < 8; i++)
+                key = (key << 8) | bytes[i];
+            return true;
+        }
+        bytes += 12;
+    }
+    else
+        return false;
+
+    key = 0xFFFFFFFF00000000ULL;
+    for(int i = 0; i < 4; i++)
+        key |= (uint64_t) bytes[i] << (24 - 8 * i);
+    return true;
+}
+
+} //details
+
+} //httpserver
@@ -21,6 +21,7 @@
 #include <errno.h>
 #include <iostream>
 #include "details/comet_manager.hpp"
+#include "details/atomics.hpp"
 #include <sys/time.h>
 
 using namespace std;
@@ -31,21 +32,36 @@ namespace httpserver
 namespace details
 {
 
-comet_manager::comet_manager()
+comet_manager::comet_manager():
+    closing(false),
+    subscribers(0)
 {
+    pthread_mutex_init(&lock, NULL);
 }
 
 comet_manager::~comet_manager()
 {
+    pthread_mutex_destroy(&lock);
+}
+
+void comet_manager::resume(MHD_Connection* connection_id)
+{
+    //resuming a connection that is not suspended is a misuse of MHD
+    if(this->q_suspended.erase(connection_id))
+        MHD_resume_connection(connection_id);
 }
 
 void comet_manager::send_message_to_topic (const string& topic, const string& message)
 {
+    pthread_mutex_lock(&lock);
     map<string, set<MHD_Connection*> >::const_iterator it = this->q_topics.find(topic);
-    if (it == this->q_topics.end()) return;
+    if (it == this->q_topics.end())
+    {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
 
-    //copying value guarantees we iterate on a copy. Even if the original set is modified we are safe and so we stay lock free.
-    const set<MHD_Connection*> connections = it->second;
+    const set<MHD_Connection*>& connections = it->second;
 
     for (set<MHD_Connection*>::const_iterator c_it = connections.begin(); c_it != connections.end(); ++c_it)
     {
@@ -54,41 +70,72 @@ void comet_manager::send_message_to_topic (const string& topic, const string& me
 
         message_queue_it->second.push_back(message);
 
-        MHD_resume_connection(*c_it);
+        resume(*c_it);
     }
+    pthread_mutex_unlock(&lock);
 }
 
 void comet_manager::register_to_topics (const vector<string>& topics, MHD_Connection* connection_id)
 {
+    pthread_mutex_lock(&lock);
     for(vector<string>::const_iterator it = topics.begin(); it != topics.end(); ++it)
     {
-        this->q_topics[*it].insert(connection_id); // (1) Can this cause problems in concurrency with (2) ?
+        this->q_topics[*it].insert(connection_id);
     }
-    this->q_subscriptions.insert(make_pair(connection_id, set<string>(topics.begin(), topics.end())));
+    if(this->q_subscriptions.insert(make_pair(connection_id, set<string>(topics.begin(), topics.end()))).second)
+        atomic_increment(&subscribers);
     this->q_messages.insert(make_pair(connection_id, deque<string>()));
+    pthread_mutex_unlock(&lock);
 }
 
 size_t comet_manager::read_message(MHD_Connection* connection_id, string& message)
 {
-    if(this->q_messages[connection_id].empty())
+    pthread_mutex_lock(&lock);
+    deque<string>& t_deq = this->q_messages[connection_id];
+    if(t_deq.empty())
     {
-        MHD_suspend_connection(connection_id);
+        if(!closing && this->q_suspended.insert(connection_id).second)
+            MHD_suspend_connection(connection_id);
+        pthread_mutex_unlock(&lock);
         return 0;
     }
 
-    deque<string>& t_deq = this->q_messages[connection_id];
     message.assign(t_deq.front());
     t_deq.pop_front();
+    pthread_mutex_unlock(&lock);
     return message.size();
 }
 
+int comet_manager::close_all(const string& message)
+{
+    pthread_mutex_lock(&lock);
+    closing = true;
+    int closed = 0;
+    for(map<MHD_Connection*, deque<string> >::iterator it = q_messages.begin();
+            it != q_messages.end(); ++it)
+    {
+        if(!message.empty())
+            it->second.push_back(message);
+        resume(it->first);
+        closed++;
+    }
+    pthread_mutex_unlock(&lock);
+    return closed;
+}
+
 void comet_manager::complete_request(MHD_Connection* connection_id)
 {
+    pthread_mutex_lock(&lock);
     this->q_messages.erase(connection_id);
+    this->q_suspended.erase(connection_id);
 
     map<MHD_Connection*, set<string> >::iterator topics_it = this->q_subscriptions.find(connection_id);
-    if (topics_it == q_subscriptions.end()) return;
-    set<string> topics = topics_it->second;
+    if (topics_it == q_subscriptions.end())
+    {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    const set<string>& topics = topics_it->second;
 
     for(set<string>::const_iterator it = topics.begin(); it != topics.end(); ++it)
     {
@@ -96,9 +143,16 @@ void comet_manager::complete_request(MHD_Connection* connection_id)
         if (connections_it == this->q_topics.end()) continue;
 
         connections_it->second.erase(connection_id);
-        if (connections_it->second.size() == 0) this->q_topics.erase(*it); // (2)
+        if (connections_it->second.size() == 0) this->q_topics.erase(connections_it);
     }
-    q_subscriptions.erase(connection_id);
+    q_subscriptions.erase(topics_it);
+    atomic_decrement(&subscribers);
+    pthread_mutex_unlock(&lock);
+}
+
+int comet_manager::count_subscribers()
+{
+    return atomic_read(&subscribers);
 }
 
 } //details
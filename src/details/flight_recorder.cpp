@@ -0,0 +1,182 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+#include "details/flight_recorder.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+const char* const phase_names[request_trace::PHASES] = {
+    "received", "parsed", "routed", "rendered", "response_built",
+    "enqueued", "completed"
+};
+
+bool completed_before(const slow_request& a, const slow_request& b)
+{
+    return a.start_time + a.duration() < b.start_time + b.duration();
+}
+
+void append_quoted(string& result, const char* value)
+{
+    result += '"';
+    for(const char* c = value; *c != '\0'; c++)
+    {
+        if(*c == '"' || *c == '\\')
+            result += '\\';
+        result += *c;
+    }
+    result += '"';
+}
+
+}
+
+flight_recorder::flight_recorder(uint64_t threshold_us, size_t size):
+    threshold(threshold_us),
+    size(size > 0 ? size : 1)
+{
+}
+
+slow_request* flight_recorder::reserve()
+{
+    ring* r = shards.local();
+    if(r->slots == 0x0)
+    {
+        slot* slots = new slot[size];
+        for(size_t i = 0; i < size; i++)
+            slots[i].sequence = 0;
+        //the slots are initialized before readers can see them
+        __sync_synchronize();
+        r->slots = slots;
+    }
+    slot& s = r->slots[r->written % size];
+    s.sequence++;
+    __sync_synchronize();
+    return &s.request;
+}
+
+void flight_recorder::commit()
+{
+    ring* r = shards.local();
+    slot& s = r->slots[r->written % size];
+    __sync_synchronize();
+    s.sequence++;
+    r->written++;
+}
+
+void flight_recorder::get_requests(vector<slow_request>& result)
+{
+    result.clear();
+    vector<ring*> rings;
+    shards.get_shards(rings);
+    for(vector<ring*>::const_iterator it = rings.begin(); it != rings.end(); ++it)
+    {
+        slot* slots = (*it)->slots;
+        if(slots == 0x0)
+            continue;
+        __sync_synchronize();
+        for(size_t i = 0; i < size; i++)
+        {
+            unsigned long sequence = slots[i].sequence;
+            //never written, or being overwritten by a newer request
+            if(sequence == 0 || (sequence & 1) != 0)
+                continue;
+            __sync_synchronize();
+            slow_request request = slots[i].request;
+            __sync_synchronize();
+            if(slots[i].sequence == sequence)
+                result.push_back(request);
+        }
+    }
+    sort(result.begin(), result.end(), completed_before);
+    if(result.size() > size)
+        result.erase(result.begin(), result.end() - size);
+}
+
+void flight_recorder::render(string& result)
+{
+    vector<slow_request> requests;
+    get_requests(requests);
+    for(vector<slow_request>::const_iterator it = requests.begin();
+            it != requests.end(); ++it)
+        render_request(result, *it);
+}
+
+void flight_recorder::render_request(string& result,
+        const slow_request& request
+)
+{
+    char buf[128];
+    time_t seconds = (time_t) (request.start_time / 1000000);
+    struct tm when;
+    gmtime_r(&seconds, &when);
+    strftime(buf, sizeof(buf), "time=%Y-%m-%dT%H:%M:%S", &when);
+    result += buf;
+    snprintf(buf, sizeof(buf), ".%06dZ thread=0x%lx trace_id=%s method=%s url=",
+            (int) (request.start_time % 1000000), request.thread,
+            request.trace_id, request.method
+    );
+    result += buf;
+    append_quoted(result, request.url);
+    result += " route=";
+    if(request.route[0] != '\0')
+        append_quoted(result, request.route);
+    else
+        result += '-';
+    snprintf(buf, sizeof(buf), " status=%d duration_us=%llu", request.status,
+            (unsigned long long) request.duration()
+    );
+    result += buf;
+    //RECEIVED is the origin of the others
+    for(int i = request_trace::PARSED; i < request_trace::COMPLETED; i++)
+    {
+        if(request.phases[i] == SLOW_REQUEST_NOT_REACHED)
+            snprintf(buf, sizeof(buf), " %s_us=-", phase_names[i]);
+        else
+        {
+            snprintf(buf, sizeof(buf), " %s_us=%llu", phase_names[i],
+                    (unsigned long long) request.phases[i]
+            );
+        }
+        result += buf;
+    }
+    snprintf(buf, sizeof(buf), " request_headers=%u request_header_bytes=%lu"
+            " response_headers=%u response_header_bytes=%lu\n",
+            request.request_headers, request.request_header_bytes,
+            request.response_headers, request.response_header_bytes
+    );
+    result += buf;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,473 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include "http_utils.hpp"
+#include "details/ip_filter.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+static const uint32_t no_node = 0xFFFFFFFFu;
+
+//bytes of an address that are written as "*"
+typedef bool wildcard_map[16];
+
+struct parsed_ip
+{
+    unsigned char key[16];
+    int length;
+    vector<int> wildcards;
+};
+
+static inline int bit_at(const unsigned char* key, int i)
+{
+    return (key[i >> 3] >> (7 - (i & 7))) & 1;
+}
+
+static void normalize(unsigned char* key, int length)
+{
+    for(int i = length; i < 128; i = (i | 7) + 1)
+    {
+        if((i & 7) == 0)
+            key[i >> 3] = 0;
+        else
+            key[i >> 3] &= (unsigned char) (0xFF << (8 - (i & 7)));
+    }
+}
+
+static inline bool prefix_matches(const unsigned char* addr,
+        const unsigned char* key, int length
+)
+{
+    int bytes = length >> 3;
+    if(memcmp(addr, key, bytes) != 0)
+        return false;
+    int rest = length & 7;
+    if(rest == 0)
+        return true;
+    unsigned char mask = (unsigned char) (0xFF << (8 - rest));
+    return ((addr[bytes] ^ key[bytes]) & mask) == 0;
+}
+
+static int common_length(const unsigned char* a, const unsigned char* b,
+        int limit
+)
+{
+    for(int i = 0; i * 8 < limit; i++)
+    {
+        unsigned char diff = a[i] ^ b[i];
+        if(diff != 0)
+        {
+            int length = i * 8 + __builtin_clz(diff) - 24;
+            return length < limit ? length : limit;
+        }
+    }
+    return limit;
+}
+
+static void split(const string& s, vector<string>& parts)
+{
+    if(s.empty())
+        return;
+    size_t start = 0;
+    size_t colon;
+    while((colon = s.find(':', start)) != string::npos)
+    {
+        parts.push_back(s.substr(start, colon - start));
+        start = colon + 1;
+    }
+    parts.push_back(s.substr(start));
+}
+
+static bool parse_number(const string& s, int base, int max_digits,
+        long max, long& value
+)
+{
+    if(s.empty() || (int) s.size() > max_digits)
+        return false;
+    char* end;
+    value = strtol(s.c_str(), &end, base);
+    return *end == '\0' && s[0] != '-' && s[0] != '+' && value <= max;
+}
+
+static bool parse_ipv4(const string& s, unsigned char* out, bool* wild)
+{
+    size_t start = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        size_t dot = s.find('.', start);
+        if((i < 3) == (dot == string::npos))
+            return false;
+        string part = s.substr(start, dot == string::npos ?
+                string::npos : dot - start
+        );
+        start = dot + 1;
+
+        long value = 0;
+        if(part == "*")
+            wild[i] = true;
+        else if(!parse_number(part, 10, 3, 255, value))
+            return false;
+        out[i] = (unsigned char) value;
+    }
+    return true;
+}
+
+//parses the groups on one side of "::"; an embedded IPv4 address is
+//accepted as the last group of the address only
+static bool parse_groups(const vector<string>& groups, bool last,
+        unsigned char* out, bool* wild, int& size
+)
+{
+    size = 0;
+    for(unsigned int i = 0; i < groups.size(); i++)
+    {
+        if(size > 14)
+            return false;
+        if(groups[i].find('.') != string::npos)
+        {
+            if(!last || i != groups.size() - 1 || size > 12 ||
+                    !parse_ipv4(groups[i], out + size, wild + size))
+                return false;
+            size += 4;
+            continue;
+        }
+
+        long value = 0;
+        if(groups[i] == "*")
+            wild[size] = wild[size + 1] = true;
+        else if(!parse_number(groups[i], 16, 4, 0xFFFF, value))
+            return false;
+        out[size] = (unsigned char) (value >> 8);
+        out[size + 1] = (unsigned char) value;
+        size += 2;
+    }
+    return true;
+}
+
+static bool parse_ipv6(const string& s, unsigned char* out, bool* wild)
+{
+    vector<string> head;
+    vector<string> tail;
+    size_t compressed = s.find("::");
+    if(compressed == string::npos)
+        split(s, head);
+    else
+    {
+        if(s.find("::", compressed + 1) != string::npos)
+            return false;
+        split(s.substr(0, compressed), head);
+        split(s.substr(compressed + 2), tail);
+    }
+
+    unsigned char tail_bytes[16];
+    wildcard_map tail_wild = { false };
+    int head_size;
+    int tail_size;
+    if(!parse_groups(head, compressed == string::npos, out, wild, head_size) ||
+            !parse_groups(tail, true, tail_bytes, tail_wild, tail_size))
+        return false;
+
+    //"::" stands for one group at least
+    if(compressed == string::npos ? head_size != 16 : head_size + tail_size > 14)
+        return false;
+    memcpy(out + 16 - tail_size, tail_bytes, tail_size);
+    memcpy(wild + 16 - tail_size, tail_wild, tail_size);
+    return true;
+}
+
+static void parse_ip(const string& ip, parsed_ip& result)
+{
+    string address = ip;
+    int cidr = -1;
+    size_t slash = ip.find('/');
+    if(slash != string::npos)
+    {
+        long value;
+        address = ip.substr(0, slash);
+        if(!parse_number(ip.substr(slash + 1), 10, 3, 128, value))
+            throw http::bad_ip_format_exception();
+        cidr = value;
+    }
+
+    wildcard_map wild = { false };
+    memset(result.key, 0, 16);
+    int base = 0;
+    if(address.find(':') == string::npos)
+    {
+        //mapped, as IPv4 clients of IPv6 sockets are seen
+        result.key[10] = result.key[11] = 0xFF;
+        base = 96;
+        if(!parse_ipv4(address, result.key + 12, wild + 12) || cidr > 32)
+            throw http::bad_ip_format_exception();
+    }
+    else if(!parse_ipv6(address, result.key, wild))
+        throw http::bad_ip_format_exception();
+
+    result.length = cidr == -1 ? 128 : base + cidr;
+    int last = 16;
+    while(last > 0 && wild[last - 1])
+        last--;
+    if(last * 8 < result.length)
+        result.length = last * 8;
+    result.wildcards.clear();
+    for(int i = 0; i * 8 < result.length; i++)
+        if(wild[i])
+            result.wildcards.push_back(i);
+    normalize(result.key, result.length);
+}
+
+ip_filter::ip_filter():
+    root(no_node),
+    entries(0)
+{
+}
+
+void ip_filter::insert(const string& ip)
+{
+    expand(ip, true);
+}
+
+void ip_filter::remove(const string& ip)
+{
+    expand(ip, false);
+}
+
+void ip_filter::clear()
+{
+    nodes.clear();
+    free_nodes.clear();
+    root = no_node;
+    entries = 0;
+}
+
+bool ip_filter::contains(const struct sockaddr* addr) const
+{
+    unsigned char key[16];
+    if(addr->sa_family == AF_INET)
+    {
+        memset(key, 0, 10);
+        key[10] = key[11] = 0xFF;
+        memcpy(key + 12, &((const struct sockaddr_in*) addr)->sin_addr, 4);
+    }
+    else if(addr->sa_family == AF_INET6)
+        memcpy(key, &((const struct sockaddr_in6*) addr)->sin6_addr, 16);
+    else
+        return false;
+    return contains(key);
+}
+
+bool ip_filter::contains(const string& ip) const
+{
+    parsed_ip parsed;
+    parse_ip(ip, parsed);
+    return contains(parsed.key);
+}
+
+bool ip_filter::contains(const unsigned char* addr) const
+{
+    uint32_t current = root;
+    while(current != no_node)
+    {
+        const node& n = nodes[current];
+        if(!prefix_matches(addr, n.key, n.length))
+            return false;
+        if(n.terminal)
+            return true;
+        current = n.child[bit_at(addr, n.length)];
+    }
+    return false;
+}
+
+uint32_t ip_filter::alloc(const unsigned char* key, int length,
+        bool terminal
+)
+{
+    node n;
+    memcpy(n.key, key, 16);
+    normalize(n.key, length);
+    n.length = (unsigned char) length;
+    n.terminal = terminal;
+    n.child[0] = n.child[1] = no_node;
+    if(!free_nodes.empty())
+    {
+        uint32_t index = free_nodes.back();
+        free_nodes.pop_back();
+        nodes[index] = n;
+        return index;
+    }
+    nodes.push_back(n);
+    return nodes.size() - 1;
+}
+
+void ip_filter::release(uint32_t n)
+{
+    free_nodes.push_back(n);
+}
+
+void ip_filter::insert_prefix(const unsigned char* key, int length)
+{
+    uint32_t parent = no_node;
+    int side = 0;
+    uint32_t current = root;
+    uint32_t created;
+    while(true)
+    {
+        if(current == no_node)
+        {
+            created = alloc(key, length, true);
+            break;
+        }
+
+        node& n = nodes[current];
+        int common = common_length(key, n.key,
+                length < n.length ? length : n.length
+        );
+        if(common == n.length)
+        {
+            if(length == n.length)
+            {
+                if(!n.terminal)
+                    entries++;
+                n.terminal = true;
+                return;
+            }
+            parent = current;
+            side = bit_at(key, n.length);
+            current = n.child[side];
+            continue;
+        }
+
+        //the new prefix leaves the path of current at bit "common"
+        int old_side = bit_at(n.key, common);
+        created = alloc(key, common, common == length);
+        nodes[created].child[old_side] = current;
+        if(common != length)
+        {
+            uint32_t leaf = alloc(key, length, true);
+            nodes[created].child[1 - old_side] = leaf;
+        }
+        break;
+    }
+
+    if(parent == no_node)
+        root = created;
+    else
+        nodes[parent].child[side] = created;
+    entries++;
+}
+
+void ip_filter::remove_prefix(const unsigned char* key, int length)
+{
+    //at most one node per prefix length on the way
+    uint32_t path[129];
+    int sides[129];
+    int depth = 0;
+    uint32_t current = root;
+    while(current != no_node)
+    {
+        const node& n = nodes[current];
+        if(n.length > length || !prefix_matches(key, n.key, n.length))
+            return;
+        if(n.length == length)
+            break;
+        path[depth] = current;
+        sides[depth] = bit_at(key, n.length);
+        current = n.child[sides[depth]];
+        depth++;
+    }
+    if(current == no_node || !nodes[current].terminal)
+        return;
+
+    nodes[current].terminal = false;
+    entries--;
+
+    //a node that is not a prefix of the set must have two children
+    uint32_t replacement = no_node;
+    int children = 0;
+    for(int i = 0; i < 2; i++)
+    {
+        if(nodes[current].child[i] != no_node)
+        {
+            replacement = nodes[current].child[i];
+            children++;
+        }
+    }
+    if(children == 2)
+        return;
+
+    uint32_t* slot = depth == 0 ? &root :
+        &nodes[path[depth - 1]].child[sides[depth - 1]];
+    *slot = replacement;
+    release(current);
+    if(children == 1 || depth == 0)
+        return;
+
+    //the parent lost a child: splice it out if it is not a prefix itself
+    uint32_t parent = path[depth - 1];
+    if(nodes[parent].terminal)
+        return;
+    uint32_t* parent_slot = depth == 1 ? &root :
+        &nodes[path[depth - 2]].child[sides[depth - 2]];
+    *parent_slot = nodes[parent].child[1 - sides[depth - 1]];
+    release(parent);
+}
+
+void ip_filter::expand(const string& ip, bool insertion)
+{
+    parsed_ip parsed;
+    parse_ip(ip, parsed);
+    if(parsed.wildcards.size() > 2)
+        throw http::bad_ip_format_exception();
+
+    int combinations = 1 << (8 * parsed.wildcards.size());
+    for(int c = 0; c < combinations; c++)
+    {
+        unsigned char key[16];
+        memcpy(key, parsed.key, 16);
+        for(unsigned int i = 0; i < parsed.wildcards.size(); i++)
+            key[parsed.wildcards[i]] = (unsigned char) (c >> (8 * i));
+        normalize(key, parsed.length);
+        if(insertion)
+            insert_prefix(key, parsed.length);
+        else
+            remove_prefix(key, parsed.length);
+    }
+}
+
+} //details
+
+} //httpserver
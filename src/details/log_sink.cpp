@@ -0,0 +1,212 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "details/log_sink.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+static size_t next_power_of_two(size_t n)
+{
+    size_t size = 2;
+    while(size < n)
+        size <<= 1;
+    return size;
+}
+
+log_sink::log_sink(size_t ring_size, flush_ptr flush, void* cls):
+    ring_size(next_power_of_two(ring_size)),
+    deliver(flush),
+    cls(cls),
+    stopping(false),
+    passes(0)
+{
+    pthread_mutex_init(&guard, NULL);
+    pthread_cond_init(&wake, NULL);
+    pthread_cond_init(&drained, NULL);
+    pthread_create(&drainer, NULL, &log_sink::drain, this);
+}
+
+log_sink::~log_sink()
+{
+    pthread_mutex_lock(&guard);
+    stopping = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&guard);
+    pthread_join(drainer, NULL);
+    pthread_cond_destroy(&drained);
+    pthread_cond_destroy(&wake);
+    pthread_mutex_destroy(&guard);
+}
+
+log_record* log_sink::reserve()
+{
+    ring* r = rings.local();
+    if(r->slots == 0x0)
+        r->slots = new log_record[ring_size];
+    if(r->tail - r->head >= ring_size)
+    {
+        r->dropped++;
+        return 0x0;
+    }
+    return &r->slots[r->tail & (ring_size - 1)];
+}
+
+void log_sink::commit()
+{
+    ring* r = rings.local();
+    //the record has to be complete before the drain thread can see it
+    __sync_synchronize();
+    r->tail = r->tail + 1;
+    //a signal may be lost while the drain thread is busy: the timed wait
+    //bounds the delay
+    if(r->tail - r->head == ring_size / 2)
+        pthread_cond_signal(&wake);
+}
+
+void log_sink::flush()
+{
+    pthread_mutex_lock(&guard);
+    //the running pass may have missed the latest records
+    unsigned long target = passes + 2;
+    while(passes < target && !stopping)
+    {
+        pthread_cond_signal(&wake);
+        pthread_cond_wait(&drained, &guard);
+    }
+    pthread_mutex_unlock(&guard);
+}
+
+unsigned long log_sink::get_dropped()
+{
+    vector<ring*> all;
+    rings.get_shards(all);
+    unsigned long dropped = 0;
+    for(vector<ring*>::const_iterator it = all.begin(); it != all.end(); ++it)
+        dropped += (*it)->dropped;
+    return dropped;
+}
+
+void log_sink::drain_rings(vector<log_record>& batch)
+{
+    vector<ring*> all;
+    rings.get_shards(all);
+    batch.clear();
+    for(vector<ring*>::const_iterator it = all.begin(); it != all.end(); ++it)
+    {
+        ring* r = *it;
+        size_t tail = r->tail;
+        __sync_synchronize();
+        for(size_t i = r->head; i != tail; i++)
+            batch.push_back(r->slots[i & (ring_size - 1)]);
+        //the slots are copied before the producer can reuse them
+        __sync_synchronize();
+        r->head = tail;
+    }
+    if(!batch.empty())
+        deliver(cls, &batch[0], batch.size());
+}
+
+void* log_sink::drain(void* self)
+{
+    log_sink* sink = static_cast<log_sink*>(self);
+    vector<log_record> batch;
+    pthread_mutex_lock(&sink->guard);
+    while(true)
+    {
+        bool last = sink->stopping;
+        pthread_mutex_unlock(&sink->guard);
+        sink->drain_rings(batch);
+        pthread_mutex_lock(&sink->guard);
+        sink->passes++;
+        pthread_cond_broadcast(&sink->drained);
+        if(last)
+            break;
+
+        struct timeval now;
+        gettimeofday(&now, NULL);
+        struct timespec deadline;
+        long usec = now.tv_usec + LOG_FLUSH_INTERVAL_MS * 1000;
+        deadline.tv_sec = now.tv_sec + usec / 1000000;
+        deadline.tv_nsec = (usec % 1000000) * 1000;
+        if(!sink->stopping)
+            pthread_cond_timedwait(&sink->wake, &sink->guard, &deadline);
+    }
+    pthread_mutex_unlock(&sink->guard);
+    return 0x0;
+}
+
+log_throttle::log_throttle(int per_second):
+    per_second(per_second)
+{
+    memset(slots, 0, sizeof(slots));
+}
+
+log_throttle::slot& log_throttle::find(const void* key)
+{
+    size_t start = ((size_t) key >> 3) * 2654435761u;
+    for(size_t i = 0; i < 8; i++)
+    {
+        slot& s = slots[(start + i) % LOG_THROTTLE_TEMPLATES];
+        if(s.key == key)
+            return s;
+        if(s.key == 0x0 &&
+                (__sync_bool_compare_and_swap(&s.key, (const void*) 0x0, key) ||
+                 s.key == key))
+            return s;
+    }
+    //the table is crowded: the template shares a slot
+    return slots[start % LOG_THROTTLE_TEMPLATES];
+}
+
+bool log_throttle::admit(const void* key, unsigned long& suppressed)
+{
+    suppressed = 0;
+    if(per_second <= 0)
+        return true;
+
+    slot& s = find(key);
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long second = s.second;
+    if(second != now.tv_sec &&
+            __sync_bool_compare_and_swap(&s.second, second, (long) now.tv_sec))
+        __sync_lock_test_and_set(&s.count, 0);
+    if(__sync_add_and_fetch(&s.count, 1) > per_second)
+    {
+        __sync_add_and_fetch(&s.suppressed, 1);
+        return false;
+    }
+    suppressed = __sync_fetch_and_and(&s.suppressed, 0);
+    return true;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,323 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+#include "details/metrics.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+const char* const method_names[METRICS_METHODS] = {
+    "GET", "HEAD", "POST", "PUT", "DELETE",
+    "CONNECT", "OPTIONS", "TRACE", "PATCH", "OTHER"
+};
+
+const char* const status_names[METRICS_STATUS_CLASSES] = {
+    "1xx", "2xx", "3xx", "4xx", "5xx"
+};
+
+void append_label(string& result, const string& value)
+{
+    for(string::const_iterator it = value.begin(); it != value.end(); ++it)
+    {
+        if(*it == '\\' || *it == '"')
+            result += '\\';
+        if(*it == '\n')
+            result += "\\n";
+        else
+            result += *it;
+    }
+}
+
+void append_sample(string& result, const char* name, const string& route,
+        const char* labels, unsigned long long value
+)
+{
+    char buf[64];
+    result += name;
+    result += "{route=\"";
+    append_label(result, route);
+    result += '"';
+    result += labels;
+    snprintf(buf, sizeof(buf), "} %llu\n", value);
+    result += buf;
+}
+
+void append_header(string& result, const char* name, const char* help,
+        const char* type
+)
+{
+    result += "# HELP ";
+    result += name;
+    result += ' ';
+    result += help;
+    result += "\n# TYPE ";
+    result += name;
+    result += ' ';
+    result += type;
+    result += '\n';
+}
+
+void append_counter(string& result, const char* name, const char* help,
+        unsigned long long value
+)
+{
+    char buf[32];
+    append_header(result, name, help, "counter");
+    snprintf(buf, sizeof(buf), " %llu\n", value);
+    result += name;
+    result += buf;
+}
+
+} //anonymous
+
+metrics::metrics():
+    routes_count(1)
+{
+    pthread_mutex_init(&guard, NULL);
+    routes[0] = "unmatched";
+}
+
+metrics::~metrics()
+{
+    pthread_mutex_destroy(&guard);
+}
+
+int metrics::route_id(const std::string& route)
+{
+    pthread_mutex_lock(&guard);
+    int route_id = 0;
+    for(int i = 1; i < routes_count && route_id == 0; i++)
+    {
+        if(routes[i] == route)
+            route_id = i;
+    }
+    if(route_id == 0 && routes_count < METRICS_MAX_ROUTES)
+    {
+        route_id = routes_count++;
+        routes[route_id] = route;
+    }
+    pthread_mutex_unlock(&guard);
+    return route_id;
+}
+
+int metrics::method_id(const char* method)
+{
+    for(int i = 0; i < METRICS_METHODS - 1; i++)
+    {
+        if(strcmp(method, method_names[i]) == 0)
+            return i;
+    }
+    return METRICS_METHODS - 1;
+}
+
+const char* metrics::method_name(int method)
+{
+    if(method < 0 || method >= METRICS_METHODS)
+        return method_names[METRICS_METHODS - 1];
+    return method_names[method];
+}
+
+uint64_t metrics::now()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+int metrics::latency_bucket(uint64_t latency_us)
+{
+    if(latency_us < 4)
+        return (int) latency_us;
+    int exponent = 63 - __builtin_clzll(latency_us);
+    int bucket = 4 * (exponent - 1) + (int) ((latency_us >> (exponent - 2)) & 3);
+    return bucket < METRICS_LATENCY_BUCKETS ? bucket :
+        METRICS_LATENCY_BUCKETS - 1;
+}
+
+uint64_t metrics::latency_bound(int bucket)
+{
+    if(bucket < 4)
+        return bucket + 1;
+    return (uint64_t) (5 + bucket % 4) << (bucket / 4 - 1);
+}
+
+void metrics::record_request(int route, int method, int status,
+        uint64_t latency_us
+)
+{
+    if(route < 0 || route >= METRICS_MAX_ROUTES)
+        route = 0;
+    int status_class = status / 100 - 1;
+    if(status_class < 0)
+        status_class = 0;
+    if(status_class >= METRICS_STATUS_CLASSES)
+        status_class = METRICS_STATUS_CLASSES - 1;
+
+    shard* s = shards.local();
+    route_stats* stats = s->routes[route];
+    if(stats == 0x0)
+    {
+        //scrapes may find the pointer as soon as it is stored
+        stats = new route_stats();
+        __sync_synchronize();
+        s->routes[route] = stats;
+    }
+    stats->requests[method][status_class]++;
+    stats->latency[latency_bucket(latency_us)]++;
+    stats->latency_sum += latency_us;
+}
+
+void metrics::render(std::string& result)
+{
+    pthread_mutex_lock(&guard);
+    int count = routes_count;
+    vector<string> names(routes, routes + count);
+    pthread_mutex_unlock(&guard);
+
+    vector<shard*> all;
+    shards.get_shards(all);
+    vector<route_stats> totals(count);
+    vector<bool> used(count, false);
+    uint64_t received = 0, sent = 0, cache_hits = 0, cache_misses = 0;
+    for(vector<shard*>::const_iterator it = all.begin(); it != all.end(); ++it)
+    {
+        const shard* s = *it;
+        received += s->received;
+        sent += s->sent;
+        cache_hits += s->cache_hits;
+        cache_misses += s->cache_misses;
+        for(int r = 0; r < count; r++)
+        {
+            const route_stats* stats = s->routes[r];
+            if(stats == 0x0)
+                continue;
+            __sync_synchronize();
+            used[r] = true;
+            for(int m = 0; m < METRICS_METHODS; m++)
+                for(int c = 0; c < METRICS_STATUS_CLASSES; c++)
+                    totals[r].requests[m][c] += stats->requests[m][c];
+            for(int b = 0; b < METRICS_LATENCY_BUCKETS; b++)
+                totals[r].latency[b] += stats->latency[b];
+            totals[r].latency_sum += stats->latency_sum;
+        }
+    }
+
+    char labels[64];
+    append_header(result, "httpserver_requests_total",
+            "Requests answered, by route, method and status class.", "counter"
+    );
+    for(int r = 0; r < count; r++)
+    {
+        if(!used[r])
+            continue;
+        for(int m = 0; m < METRICS_METHODS; m++)
+            for(int c = 0; c < METRICS_STATUS_CLASSES; c++)
+            {
+                if(totals[r].requests[m][c] == 0)
+                    continue;
+                snprintf(labels, sizeof(labels), ",method=\"%s\",code=\"%s\"",
+                        method_names[m], status_names[c]
+                );
+                append_sample(result, "httpserver_requests_total", names[r],
+                        labels, totals[r].requests[m][c]
+                );
+            }
+    }
+
+    append_header(result, "httpserver_request_duration_seconds",
+            "Time taken to answer the requests, by route.", "histogram"
+    );
+    for(int r = 0; r < count; r++)
+    {
+        if(!used[r])
+            continue;
+        unsigned long long cumulative = 0;
+        for(int b = 0; b < METRICS_LATENCY_BUCKETS; b++)
+        {
+            cumulative += totals[r].latency[b];
+            if(b == METRICS_LATENCY_BUCKETS - 1)
+                snprintf(labels, sizeof(labels), ",le=\"+Inf\"");
+            else
+                snprintf(labels, sizeof(labels), ",le=\"%.9g\"",
+                        latency_bound(b) / 1e6
+                );
+            append_sample(result, "httpserver_request_duration_seconds_bucket",
+                    names[r], labels, cumulative
+            );
+        }
+        char sum[64];
+        result += "httpserver_request_duration_seconds_sum{route=\"";
+        append_label(result, names[r]);
+        snprintf(sum, sizeof(sum), "\"} %.6f\n", totals[r].latency_sum / 1e6);
+        result += sum;
+        append_sample(result, "httpserver_request_duration_seconds_count",
+                names[r], "", cumulative
+        );
+    }
+
+    append_counter(result, "httpserver_received_bytes_total",
+            "Bytes of request bodies received.", received
+    );
+    append_counter(result, "httpserver_sent_bytes_total",
+            "Bytes of response bodies sent.", sent
+    );
+    append_counter(result, "httpserver_cache_hits_total",
+            "Lookups finding a valid entry in the response cache.", cache_hits
+    );
+    append_counter(result, "httpserver_cache_misses_total",
+            "Lookups not finding a valid entry in the response cache.",
+            cache_misses
+    );
+}
+
+void metrics::render_counter(std::string& result, const char* name,
+        const char* help, unsigned long long value
+)
+{
+    append_counter(result, name, help, value);
+}
+
+void metrics::render_gauge(std::string& result, const char* name,
+        const char* help, double value
+)
+{
+    char buf[64];
+    append_header(result, name, help, "gauge");
+    snprintf(buf, sizeof(buf), " %.17g\n", value);
+    result += name;
+    result += buf;
+}
+
+} //details
+
+} //httpserver
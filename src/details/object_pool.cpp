@@ -0,0 +1,142 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <new>
+#include <stdlib.h>
+#include <pthread.h>
+#include "details/object_pool.hpp"
+
+#define POOL_GRANULARITY 16
+#define POOL_SIZE_CLASSES 64
+#define POOL_MAX_BLOCKS 256
+
+namespace httpserver
+{
+
+namespace details
+{
+
+namespace
+{
+
+//every block starts with a header recording its size class, so that a
+//block can be released without knowing the type it was allocated for.
+union block_header
+{
+    size_t size_class;
+    block_header* next;
+    long double alignment;
+};
+
+struct thread_pool
+{
+    block_header* heads[POOL_SIZE_CLASSES];
+    unsigned int counts[POOL_SIZE_CLASSES];
+    bool registered;
+    bool draining;
+};
+
+__thread thread_pool local_pool;
+
+pthread_key_t pool_key;
+pthread_once_t pool_key_once = PTHREAD_ONCE_INIT;
+
+void drain_pool(void* arg)
+{
+    thread_pool* pool = static_cast<thread_pool*>(arg);
+    pool->draining = true;
+    for(int i = 0; i < POOL_SIZE_CLASSES; i++)
+    {
+        while(pool->heads[i] != 0x0)
+        {
+            block_header* b = pool->heads[i];
+            pool->heads[i] = b->next;
+            free(b);
+        }
+        pool->counts[i] = 0;
+    }
+}
+
+void create_pool_key()
+{
+    pthread_key_create(&pool_key, &drain_pool);
+}
+
+void register_pool(thread_pool* pool)
+{
+    pthread_once(&pool_key_once, &create_pool_key);
+    pthread_setspecific(pool_key, pool);
+    pool->registered = true;
+}
+
+}
+
+void* pool_allocate(size_t size)
+{
+    size_t size_class = (size + POOL_GRANULARITY - 1) / POOL_GRANULARITY;
+    thread_pool* pool = &local_pool;
+
+    if(size_class < POOL_SIZE_CLASSES && pool->heads[size_class] != 0x0)
+    {
+        block_header* b = pool->heads[size_class];
+        pool->heads[size_class] = b->next;
+        pool->counts[size_class]--;
+        b->size_class = size_class;
+        return b + 1;
+    }
+
+    size_t block_size = size_class < POOL_SIZE_CLASSES ?
+        size_class * POOL_GRANULARITY : size;
+    block_header* b = static_cast<block_header*>(
+            malloc(sizeof(block_header) + block_size)
+    );
+    if(b == 0x0)
+        throw std::bad_alloc();
+    b->size_class = size_class;
+    return b + 1;
+}
+
+void pool_release(void* p)
+{
+    if(p == 0x0)
+        return;
+
+    block_header* b = static_cast<block_header*>(p) - 1;
+    size_t size_class = b->size_class;
+    thread_pool* pool = &local_pool;
+
+    if(size_class >= POOL_SIZE_CLASSES || pool->draining ||
+            pool->counts[size_class] >= POOL_MAX_BLOCKS)
+    {
+        free(b);
+        return;
+    }
+
+    if(!pool->registered)
+        register_pool(pool);
+
+    b->next = pool->heads[size_class];
+    pool->heads[size_class] = b;
+    pool->counts[size_class]++;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,98 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <math.h>
+#include <time.h>
+
+#include "details/rate_limiter.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+static double monotonic_seconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+rate_limiter::rate_limiter(double rate, double burst, size_t max_clients):
+    rate(rate),
+    burst(burst < 1 ? 1 : burst),
+    buckets(max_clients)
+{
+}
+
+void rate_limiter::refill(bucket& b, bool created, double now)
+{
+    if(created)
+        b.tokens = burst;
+    else
+    {
+        b.tokens += (now - b.last) * rate;
+        if(b.tokens > burst)
+            b.tokens = burst;
+    }
+    b.last = now;
+}
+
+int rate_limiter::consume(const struct sockaddr* addr)
+{
+    uint64_t client;
+    if(!client_key(addr, client))
+        return 0;
+
+    bool created;
+    double now = monotonic_seconds();
+    bucket* b = buckets.lock(client, true, created);
+    refill(*b, created, now);
+    int wait = 0;
+    if(b->tokens >= 1)
+        b->tokens -= 1;
+    else
+        wait = (int) ceil((1 - b->tokens) / rate);
+    buckets.unlock(client);
+    return wait;
+}
+
+bool rate_limiter::exhausted(const struct sockaddr* addr)
+{
+    uint64_t client;
+    if(!client_key(addr, client))
+        return false;
+
+    bool created;
+    double now = monotonic_seconds();
+    bucket* b = buckets.lock(client, false, created);
+    if(b != 0x0)
+        refill(*b, false, now);
+    bool result = b != 0x0 && b->tokens < 1;
+    buckets.unlock(client);
+    return result;
+}
+
+} //details
+
+} //httpserver
@@ -0,0 +1,324 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+#define _WINDOWS
+#else
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#endif
+
+#include "details/socket_handoff.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+#ifndef _WINDOWS
+
+static bool fill_address(const string& path, struct sockaddr_un* addr)
+{
+    if(path.size() >= sizeof(addr->sun_path))
+        return false;
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    memcpy(addr->sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+static bool wait_readable(int fd, int timeout_ms)
+{
+    struct pollfd p;
+    p.fd = fd;
+    p.events = POLLIN;
+    int r;
+    do
+    {
+        r = poll(&p, 1, timeout_ms);
+    }
+    while(r == -1 && errno == EINTR);
+    return r == 1;
+}
+
+static long now_ms()
+{
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#else
+    clock_gettime(CLOCK_REALTIME, &ts);
+#endif
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+static bool same_user(int fd)
+{
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) == 0 &&
+        cred.uid == geteuid();
+#else
+    uid_t uid;
+    gid_t gid;
+    return getpeereid(fd, &uid, &gid) == 0 && uid == geteuid();
+#endif
+}
+
+int handoff_listen(const string& path)
+{
+    struct sockaddr_un addr;
+    if(!fill_address(path, &addr))
+        return -1;
+
+    //only a socket left by a process that did not clean up is replaced
+    struct stat st;
+    if(lstat(path.c_str(), &st) == 0)
+    {
+        if(!S_ISSOCK(st.st_mode))
+            return -1;
+        unlink(path.c_str());
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd == -1)
+        return -1;
+    if(bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    //nobody can connect before listen: restricting the mode first leaves
+    //no window for other users
+    if(chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || listen(fd, 1) != 0)
+    {
+        close(fd);
+        unlink(path.c_str());
+        return -1;
+    }
+    return fd;
+}
+
+int handoff_accept(int listener, int timeout_ms)
+{
+    long deadline = now_ms() + timeout_ms;
+    while(true)
+    {
+        long left = deadline - now_ms();
+        if(left < 0 || !wait_readable(listener, left))
+            return -1;
+        int fd = accept(listener, 0x0, 0x0);
+        if(fd == -1)
+        {
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+            return -1;
+        }
+        //the listen sockets are only given to processes of the same user
+        if(same_user(fd))
+            return fd;
+        close(fd);
+    }
+}
+
+int handoff_connect(const string& path, int timeout_ms)
+{
+    struct sockaddr_un addr;
+    if(!fill_address(path, &addr))
+        return -1;
+
+    //the running process may not be listening yet
+    for(int waited = 0; ; waited += 10)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd == -1)
+            return -1;
+        if(connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0)
+            return fd;
+        close(fd);
+        if(waited >= timeout_ms || (errno != ENOENT && errno != ECONNREFUSED))
+            return -1;
+        usleep(10000);
+    }
+}
+
+bool handoff_send_sockets(int channel, const vector<int>& sockets)
+{
+    if(sockets.empty() || sockets.size() > HANDOFF_MAX_SOCKETS)
+        return false;
+
+    unsigned char count = sockets.size();
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = 1;
+
+    vector<char> control(CMSG_SPACE(sizeof(int) * sockets.size()));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = &control[0];
+    msg.msg_controllen = control.size();
+
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * sockets.size());
+    memcpy(CMSG_DATA(cmsg), &sockets[0], sizeof(int) * sockets.size());
+
+    ssize_t sent;
+    do
+    {
+        sent = sendmsg(channel, &msg, 0);
+    }
+    while(sent == -1 && errno == EINTR);
+    return sent == 1;
+}
+
+bool handoff_receive_sockets(int channel, vector<int>& sockets,
+        int timeout_ms
+)
+{
+    if(!wait_readable(channel, timeout_ms))
+        return false;
+
+    unsigned char count = 0;
+    struct iovec iov;
+    iov.iov_base = &count;
+    iov.iov_len = 1;
+
+    vector<char> control(CMSG_SPACE(sizeof(int) * HANDOFF_MAX_SOCKETS));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = &control[0];
+    msg.msg_controllen = control.size();
+
+    //the sockets must not leak into the processes we exec
+#ifdef MSG_CMSG_CLOEXEC
+    int flags = MSG_CMSG_CLOEXEC;
+#else
+    int flags = 0;
+#endif
+    ssize_t received;
+    do
+    {
+        received = recvmsg(channel, &msg, flags);
+    }
+    while(received == -1 && errno == EINTR);
+    if(received != 1)
+        return false;
+
+    for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != 0x0;
+            cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+        size_t n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        if(n == 0)
+            continue;
+        vector<int> fds(n);
+        memcpy(&fds[0], CMSG_DATA(cmsg), sizeof(int) * n);
+#ifndef MSG_CMSG_CLOEXEC
+        for(size_t i = 0; i < n; i++)
+            fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+#endif
+        sockets.insert(sockets.end(), fds.begin(), fds.end());
+    }
+    if(sockets.size() != count || (msg.msg_flags & MSG_CTRUNC))
+    {
+        for(unsigned int i = 0; i < sockets.size(); i++)
+            close(sockets[i]);
+        sockets.clear();
+        return false;
+    }
+    return true;
+}
+
+bool handoff_send_ack(int channel)
+{
+    char ack = 'A';
+    return write(channel, &ack, 1) == 1;
+}
+
+bool handoff_wait_ack(int channel, int timeout_ms)
+{
+    char ack = 0;
+    return wait_readable(channel, timeout_ms) &&
+        read(channel, &ack, 1) == 1 && ack == 'A';
+}
+
+#else
+
+int handoff_listen(const string& path)
+{
+    return -1;
+}
+
+int handoff_accept(int listener, int timeout_ms)
+{
+    return -1;
+}
+
+int handoff_connect(const string& path, int timeout_ms)
+{
+    return -1;
+}
+
+bool handoff_send_sockets(int channel, const vector<int>& sockets)
+{
+    return false;
+}
+
+bool handoff_receive_sockets(int channel, vector<int>& sockets,
+        int timeout_ms
+)
+{
+    return false;
+}
+
+bool handoff_send_ack(int channel)
+{
+    return false;
+}
+
+bool handoff_wait_ack(int channel, int timeout_ms)
+{
+    return false;
+}
+
+#endif
+
+} //details
+
+} //httpserver
@@ -0,0 +1,439 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <stdlib.h>
+#include <sched.h>
+#include "executor.hpp"
+#include "details/work_stealing_deque.hpp"
+#include "details/priority_fifo.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+thread_pool_executor::thread_pool_executor(int threads):
+    num_threads(threads),
+    running(false),
+    tasks(new details::priority_fifo<executor_task*>())
+{
+    pthread_mutex_init(&tasks_lock, NULL);
+    pthread_cond_init(&tasks_cond, NULL);
+}
+
+thread_pool_executor::~thread_pool_executor()
+{
+    stop();
+    delete tasks;
+    pthread_mutex_destroy(&tasks_lock);
+    pthread_cond_destroy(&tasks_cond);
+}
+
+void thread_pool_executor::start()
+{
+    pthread_mutex_lock(&tasks_lock);
+    if(running)
+    {
+        pthread_mutex_unlock(&tasks_lock);
+        return;
+    }
+    running = true;
+    pthread_mutex_unlock(&tasks_lock);
+
+    for(int i = 0; i < num_threads; i++)
+    {
+        pthread_t t;
+        if(pthread_create(&t, NULL, &thread_pool_executor::worker, this) == 0)
+            threads.push_back(t);
+    }
+}
+
+void thread_pool_executor::stop()
+{
+    pthread_mutex_lock(&tasks_lock);
+    running = false;
+    pthread_cond_broadcast(&tasks_cond);
+    pthread_mutex_unlock(&tasks_lock);
+
+    for(unsigned int i = 0; i < threads.size(); i++)
+        pthread_join(threads[i], NULL);
+    threads.clear();
+
+    //tasks submitted while no worker was alive
+    while(true)
+    {
+        executor_task* task;
+        pthread_mutex_lock(&tasks_lock);
+        if(!tasks->pop(task))
+        {
+            pthread_mutex_unlock(&tasks_lock);
+            return;
+        }
+        pthread_mutex_unlock(&tasks_lock);
+
+        task->run();
+        delete task;
+    }
+}
+
+void thread_pool_executor::submit(executor_task* task)
+{
+    submit(task, NORMAL_PRIORITY);
+}
+
+void thread_pool_executor::submit(executor_task* task, priority_T priority)
+{
+    pthread_mutex_lock(&tasks_lock);
+    tasks->push(task, priority);
+    pthread_cond_signal(&tasks_cond);
+    pthread_mutex_unlock(&tasks_lock);
+}
+
+void* thread_pool_executor::worker(void* self)
+{
+    thread_pool_executor* pool = static_cast<thread_pool_executor*>(self);
+    while(true)
+    {
+        executor_task* task;
+        pthread_mutex_lock(&pool->tasks_lock);
+        while(pool->running && pool->tasks->empty())
+            pthread_cond_wait(&pool->tasks_cond, &pool->tasks_lock);
+        if(!pool->tasks->pop(task))
+        {
+            pthread_mutex_unlock(&pool->tasks_lock);
+            return 0x0;
+        }
+        pthread_mutex_unlock(&pool->tasks_lock);
+
+        task->run();
+        delete task;
+    }
+}
+
+struct work_stealing_executor::worker
+{
+    work_stealing_executor* owner;
+    details::work_stealing_deque<executor_task> tasks;
+    std::deque<executor_task*> injected;
+    pthread_mutex_t injected_lock;
+    unsigned int seed;
+    int urgent_streak;
+    int background_skips;
+
+    worker(work_stealing_executor* owner, unsigned int seed):
+        owner(owner),
+        seed(seed),
+        urgent_streak(0),
+        background_skips(0)
+    {
+        pthread_mutex_init(&injected_lock, NULL);
+    }
+
+    ~worker()
+    {
+        pthread_mutex_destroy(&injected_lock);
+    }
+
+    //xorshift; only used to pick victims
+    unsigned int random()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed;
+    }
+};
+
+//the worker running in the current thread, if any
+static __thread void* current_worker = 0x0;
+
+#define STEAL_ROUNDS 64
+
+work_stealing_executor::work_stealing_executor(int threads):
+    num_threads(threads > 0 ? threads : 1),
+    running(false),
+    urgent_count(0),
+    background_count(0),
+    pending(0),
+    sleepers(0),
+    next_victim(0)
+{
+    pthread_mutex_init(&park_lock, NULL);
+    pthread_cond_init(&park_cond, NULL);
+    pthread_mutex_init(&shared_lock, NULL);
+    for(int i = 0; i < num_threads; i++)
+        workers.push_back(new worker(this, 2463534242U + i * 7919));
+}
+
+work_stealing_executor::~work_stealing_executor()
+{
+    stop();
+    for(unsigned int i = 0; i < workers.size(); i++)
+        delete workers[i];
+    pthread_mutex_destroy(&park_lock);
+    pthread_cond_destroy(&park_cond);
+    pthread_mutex_destroy(&shared_lock);
+}
+
+void work_stealing_executor::start()
+{
+    pthread_mutex_lock(&park_lock);
+    if(running)
+    {
+        pthread_mutex_unlock(&park_lock);
+        return;
+    }
+    running = true;
+    pthread_mutex_unlock(&park_lock);
+
+    for(int i = 0; i < num_threads; i++)
+    {
+        pthread_t t;
+        if(pthread_create(&t, NULL, &work_stealing_executor::work, workers[i]) == 0)
+            threads.push_back(t);
+    }
+}
+
+void work_stealing_executor::stop()
+{
+    pthread_mutex_lock(&park_lock);
+    running = false;
+    pthread_cond_broadcast(&park_cond);
+    pthread_mutex_unlock(&park_lock);
+
+    for(unsigned int i = 0; i < threads.size(); i++)
+        pthread_join(threads[i], NULL);
+    threads.clear();
+
+    //tasks submitted while no worker was alive; the deques are only
+    //touched by their owner, that is gone.
+    executor_task* task;
+    while((task = take_shared(urgent, &urgent_count)) != 0x0)
+    {
+        __sync_sub_and_fetch(&pending, 1);
+        task->run();
+        delete task;
+    }
+    for(unsigned int i = 0; i < workers.size(); i++)
+    {
+        while((task = workers[i]->tasks.take()) != 0x0 ||
+                (task = workers[i]->tasks.steal()) != 0x0)
+        {
+            __sync_sub_and_fetch(&pending, 1);
+            task->run();
+            delete task;
+        }
+        while(true)
+        {
+            pthread_mutex_lock(&workers[i]->injected_lock);
+            if(workers[i]->injected.empty())
+            {
+                pthread_mutex_unlock(&workers[i]->injected_lock);
+                break;
+            }
+            task = workers[i]->injected.front();
+            workers[i]->injected.pop_front();
+            pthread_mutex_unlock(&workers[i]->injected_lock);
+            __sync_sub_and_fetch(&pending, 1);
+            task->run();
+            delete task;
+        }
+    }
+    while((task = take_shared(background, &background_count)) != 0x0)
+    {
+        __sync_sub_and_fetch(&pending, 1);
+        task->run();
+        delete task;
+    }
+}
+
+void work_stealing_executor::submit(executor_task* task)
+{
+    submit(task, NORMAL_PRIORITY);
+}
+
+void work_stealing_executor::submit(executor_task* task, priority_T priority)
+{
+    worker* w = static_cast<worker*>(current_worker);
+    if(priority != NORMAL_PRIORITY)
+    {
+        bool high = priority < NORMAL_PRIORITY;
+        pthread_mutex_lock(&shared_lock);
+        (high ? urgent : background).push_back(task);
+        __sync_add_and_fetch(high ? &urgent_count : &background_count, 1);
+        pthread_mutex_unlock(&shared_lock);
+    }
+    else if(w != 0x0 && w->owner == this)
+    {
+        w->tasks.push(task);
+    }
+    else
+    {
+        w = workers[__sync_fetch_and_add(&next_victim, 1) % workers.size()];
+        pthread_mutex_lock(&w->injected_lock);
+        w->injected.push_back(task);
+        pthread_mutex_unlock(&w->injected_lock);
+    }
+    //full barrier: pairs with the one in park
+    __sync_add_and_fetch(&pending, 1);
+    if(__sync_fetch_and_add(&sleepers, 0) > 0)
+        wake();
+}
+
+void work_stealing_executor::wake()
+{
+    pthread_mutex_lock(&park_lock);
+    pthread_cond_signal(&park_cond);
+    pthread_mutex_unlock(&park_lock);
+}
+
+executor_task* work_stealing_executor::take_shared(
+        std::deque<executor_task*>& queue,
+        long* count
+)
+{
+    if(__sync_fetch_and_add(count, 0) <= 0)
+        return 0x0;
+    executor_task* task = 0x0;
+    pthread_mutex_lock(&shared_lock);
+    if(!queue.empty())
+    {
+        task = queue.front();
+        queue.pop_front();
+        __sync_sub_and_fetch(count, 1);
+    }
+    pthread_mutex_unlock(&shared_lock);
+    return task;
+}
+
+executor_task* work_stealing_executor::find_task(worker* w)
+{
+    //high priority first, but let a normal task through every
+    //PRIORITY_STARVATION_LIMIT urgent ones; low priority tasks get the
+    //same share when the other classes keep the worker busy.
+    executor_task* task = 0x0;
+    if(w->urgent_streak < PRIORITY_STARVATION_LIMIT)
+    {
+        task = take_shared(urgent, &urgent_count);
+        if(task != 0x0)
+        {
+            w->urgent_streak++;
+            return task;
+        }
+    }
+    w->urgent_streak = 0;
+    if(++w->background_skips > PRIORITY_STARVATION_LIMIT)
+    {
+        task = take_shared(background, &background_count);
+        if(task != 0x0)
+        {
+            w->background_skips = 0;
+            return task;
+        }
+    }
+
+    task = w->tasks.take();
+    if(task != 0x0)
+        return task;
+
+    //move the tasks injected for this worker into its deque, so that
+    //the other workers can steal them
+    pthread_mutex_lock(&w->injected_lock);
+    if(!w->injected.empty())
+    {
+        task = w->injected.front();
+        w->injected.pop_front();
+        while(!w->injected.empty())
+        {
+            w->tasks.push(w->injected.front());
+            w->injected.pop_front();
+        }
+    }
+    pthread_mutex_unlock(&w->injected_lock);
+    if(task != 0x0)
+        return task;
+
+    for(int round = 0; round < STEAL_ROUNDS; round++)
+    {
+        worker* victim = workers[w->random() % workers.size()];
+        if(victim == w)
+            continue;
+        task = victim->tasks.steal();
+        if(task != 0x0)
+            return task;
+        if(pthread_mutex_trylock(&victim->injected_lock) == 0)
+        {
+            if(!victim->injected.empty())
+            {
+                task = victim->injected.front();
+                victim->injected.pop_front();
+            }
+            pthread_mutex_unlock(&victim->injected_lock);
+            if(task != 0x0)
+                return task;
+        }
+        if(round % 8 == 7)
+            sched_yield();
+    }
+    //nothing else to do: drain the urgent queue too, in case the streak
+    //made this call skip it
+    if((task = take_shared(urgent, &urgent_count)) != 0x0)
+        return task;
+    w->background_skips = 0;
+    return take_shared(background, &background_count);
+}
+
+void work_stealing_executor::park(worker* w)
+{
+    pthread_mutex_lock(&park_lock);
+    //full barrier: pairs with the one in submit
+    __sync_add_and_fetch(&sleepers, 1);
+    while(running && __sync_fetch_and_add(&pending, 0) <= 0)
+        pthread_cond_wait(&park_cond, &park_lock);
+    __sync_sub_and_fetch(&sleepers, 1);
+    pthread_mutex_unlock(&park_lock);
+}
+
+void* work_stealing_executor::work(void* self)
+{
+    worker* w = static_cast<worker*>(self);
+    work_stealing_executor* pool = w->owner;
+    current_worker = w;
+
+    while(true)
+    {
+        executor_task* task = pool->find_task(w);
+        if(task != 0x0)
+        {
+            __sync_sub_and_fetch(&pool->pending, 1);
+            task->run();
+            delete task;
+            continue;
+        }
+        if(!pool->running && __sync_fetch_and_add(&pool->pending, 0) <= 0)
+            break;
+        pool->park(w);
+    }
+
+    current_worker = 0x0;
+    return 0x0;
+}
+
+};
@@ -0,0 +1,119 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <string.h>
+#include "http_utils.hpp"
+#include "header_template.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+namespace
+{
+
+//RFC 7230, section 3.2.6
+bool is_token(const string& s)
+{
+    if(s.empty())
+        return false;
+    for(size_t i = 0; i < s.size(); i++)
+    {
+        unsigned char c = s[i];
+        if(c <= 32 || c >= 127 || strchr("()<>@,;:\\\"/[]?={}", c) != 0x0)
+            return false;
+    }
+    return true;
+}
+
+bool is_field_value(const string& s)
+{
+    for(size_t i = 0; i < s.size(); i++)
+    {
+        unsigned char c = s[i];
+        if(c == '\r' || c == '\n' || c == '\0')
+            return false;
+    }
+    return true;
+}
+
+//RFC 6265, section 4.1.1
+bool is_cookie_value(const string& s)
+{
+    for(size_t i = 0; i < s.size(); i++)
+    {
+        unsigned char c = s[i];
+        if(c <= 32 || c >= 127 || c == '"' || c == ',' || c == ';' || c == '\\')
+            return false;
+    }
+    return true;
+}
+
+}
+
+header_template& header_template::with_header(const string& key,
+        const string& value
+)
+{
+    return add(key, value, false, false);
+}
+
+header_template& header_template::with_footer(const string& key,
+        const string& value
+)
+{
+    return add(key, value, true, false);
+}
+
+header_template& header_template::with_cookie(const string& key,
+        const string& value
+)
+{
+    if(!is_cookie_value(value))
+        throw http::bad_header_format_exception();
+    return add(key, value, false, true);
+}
+
+header_template& header_template::add(const string& key,
+        const string& value, bool footer, bool cookie
+)
+{
+    if(!is_token(key) || !is_field_value(value))
+        throw http::bad_header_format_exception();
+
+    entry e;
+    e.footer = footer;
+    e.cookie = cookie;
+    if(cookie)
+    {
+        e.key = "Set-Cookie";
+        e.value = key + "=" + value;
+    }
+    else
+    {
+        e.key = key;
+        e.value = value;
+    }
+    entries.push_back(e);
+    return *this;
+}
+
+};
@@ -27,6 +27,7 @@
 #include "webserver.hpp"
 #include "string_utilities.hpp"
 #include "http_response_builder.hpp"
+#include "async_completion.hpp"
 
 using namespace std;
 
@@ -45,6 +46,16 @@ void resource_init(map<string, bool>& allowed_methods)
     allowed_methods[MHD_HTTP_METHOD_OPTIONS] = true;
 }
 
+void http_resource::render_async(
+        const http_request& req,
+        async_completion& completion
+)
+{
+    http_response* res = 0x0;
+    (this->*(completion.callback))(req, &res);
+    completion.complete(res);
+}
+
 namespace details
 {
 
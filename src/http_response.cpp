@@ -28,6 +28,7 @@
 #include "webserver.hpp"
 #include "http_response.hpp"
 #include "http_response_builder.hpp"
+#include "details/object_pool.hpp"
 
 using namespace std;
 
@@ -44,10 +45,12 @@ http_response::http_response(const http_response_builder& builder):
     opaque(builder._opaque),
     reload_nonce(builder._reload_nonce),
     fp(-1),
-    filename(builder._content_hook),
+    file_size(0),
+    shared_content(builder._shared_content),
     headers(builder._headers),
     footers(builder._footers),
     cookies(builder._cookies),
+    fixed_headers(builder._fixed_headers),
     topics(builder._topics),
     keepalive_secs(builder._keepalive_secs),
     keepalive_msg(builder._keepalive_msg),
@@ -60,16 +63,65 @@ http_response::http_response(const http_response_builder& builder):
     enqueue_response(this, builder._enqueue_response),
     completed(false),
     ws(0x0),
-    connection_id(0x0)
+    connection_id(0x0),
+    num_references(0)
 {
+    //only file responses need the content hook twice
+    if(builder._get_raw_response == &http_response::get_raw_response_file)
+        filename = content;
 }
 
+#if __cplusplus >= 201103L
+http_response::http_response(http_response_builder&& builder):
+    content(std::move(builder._content_hook)),
+    response_code(builder._response_code),
+    autodelete(builder._autodelete),
+    realm(std::move(builder._realm)),
+    opaque(std::move(builder._opaque)),
+    reload_nonce(builder._reload_nonce),
+    fp(-1),
+    file_size(0),
+    shared_content(builder._shared_content),
+    headers(std::move(builder._headers)),
+    footers(std::move(builder._footers)),
+    cookies(std::move(builder._cookies)),
+    fixed_headers(builder._fixed_headers),
+    topics(std::move(builder._topics)),
+    keepalive_secs(builder._keepalive_secs),
+    keepalive_msg(std::move(builder._keepalive_msg)),
+    send_topic(std::move(builder._send_topic)),
+    underlying_connection(0x0),
+    ce(builder._ce),
+    cycle_callback(builder._cycle_callback),
+    get_raw_response(this, builder._get_raw_response),
+    decorate_response(this, builder._decorate_response),
+    enqueue_response(this, builder._enqueue_response),
+    completed(false),
+    ws(0x0),
+    connection_id(0x0),
+    num_references(0)
+{
+    if(builder._get_raw_response == &http_response::get_raw_response_file)
+        filename = content;
+}
+#endif
+
 http_response::~http_response()
 {
     if(ce != 0x0)
         webserver::unlock_cache_entry(ce);
 }
 
+void* http_response::operator new(size_t size)
+{
+    return details::pool_allocate(size);
+}
+
+void http_response::operator delete(void* p)
+{
+    details::pool_release(p);
+}
+
 size_t http_response::get_headers(std::map<std::string, std::string, http::header_comparator>& result) const
 {
     result = this->headers;
@@ -91,6 +143,16 @@ size_t http_response::get_cookies(std::map<std::string, std::string, http::heade
 //RESPONSE
 void http_response::get_raw_response_str(MHD_Response** response, webserver* ws)
 {
+    if(!shared_content.empty())
+    {
+        //the buffer is referenced by this response, that outlives the MHD one
+        *response = MHD_create_response_from_buffer(
+                shared_content.size(),
+                (void*) shared_content.data(),
+                MHD_RESPMEM_PERSISTENT
+        );
+        return;
+    }
     size_t size = &(*content.end()) - &(*content.begin());
     *response = MHD_create_response_from_buffer(
             size,
@@ -101,6 +163,25 @@ void http_response::get_raw_response_str(MHD_Response** response, webserver* ws)
 
 void http_response::decorate_response_str(MHD_Response* response)
 {
+    if(fixed_headers != 0x0)
+    {
+        typedef vector<header_template::entry>::const_iterator entries_it;
+        for(entries_it e = fixed_headers->entries.begin();
+                e != fixed_headers->entries.end(); ++e)
+        {
+            if((*e).footer)
+                MHD_add_response_footer(response,
+                        (*e).key.c_str(),
+                        (*e).value.c_str()
+                );
+            else if((*e).cookie || headers.find((*e).key) == headers.end())
+                MHD_add_response_header(response,
+                        (*e).key.c_str(),
+                        (*e).value.c_str()
+                );
+        }
+    }
+
     map<string, string, http::header_comparator>::iterator it;
 
     for (it=headers.begin() ; it != headers.end(); ++it)
@@ -162,15 +243,39 @@ int http_response::enqueue_response_digest(
     );
 }
 
+size_t http_response::body_size() const
+{
+    if(!shared_content.empty())
+        return shared_content.size();
+    //the content of a file response is the name of the file
+    if(!filename.empty())
+        return file_size;
+    return content.size();
+}
+
 void http_response::get_raw_response_file(
         MHD_Response** response,
         webserver* ws
 )
 {
+    //MHD cannot use sendfile on TLS connections and falls back to reading
+    //the file in a temporary buffer; mapping it avoids that copy.
+    if(ws != 0x0 && ws->mmap_file_responses)
+    {
+        shared_content = shared_buffer::from_file(filename);
+        *response = MHD_create_response_from_buffer(
+                shared_content.size(),
+                (void*) shared_content.data(),
+                MHD_RESPMEM_PERSISTENT
+        );
+        return;
+    }
+
     int fd = open(filename.c_str(), O_RDONLY);
     size_t size = lseek(fd, 0, SEEK_END);
     if(size)
     {
+        file_size = size;
         *response = MHD_create_response_from_fd(size, fd);
     }
     else
@@ -264,6 +369,9 @@ ssize_t http_response::data_generator(
 
     string message;
     size_t size = _this->ws->read_message(_this->connection_id, message);
+    //the webserver is draining: no message will come anymore
+    if(size == 0 && _this->ws->draining)
+        return MHD_CONTENT_READER_END_OF_STREAM;
     memcpy(buf, message.c_str(), size);
     return size;
 }
@@ -274,7 +382,7 @@ void http_response::get_raw_response_lp_send(
 )
 {
     http_response::get_raw_response_str(response, ws);
-    ws->send_message_to_topic(send_topic, content);
+    ws->send_message_to_topic(send_topic, get_content());
 }
 
 std::ostream &operator<< (std::ostream &os, const http_response &r)
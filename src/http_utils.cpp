@@ -101,6 +101,7 @@ const int http_utils::http_locked = MHD_HTTP_LOCKED;
 const int http_utils::http_failed_dependency = MHD_HTTP_FAILED_DEPENDENCY;
 const int http_utils::http_unordered_collection = MHD_HTTP_UNORDERED_COLLECTION;
 const int http_utils::http_upgrade_required = MHD_HTTP_UPGRADE_REQUIRED;
+const int http_utils::http_too_many_requests = MHD_HTTP_TOO_MANY_REQUESTS;
 const int http_utils::http_retry_with = MHD_HTTP_RETRY_WITH;
 
 const int http_utils::http_internal_server_error =
@@ -192,6 +193,7 @@ const std::string http_utils::http_header_via = MHD_HTTP_HEADER_VIA;
 const std::string http_utils::http_header_warning = MHD_HTTP_HEADER_WARNING;
 const std::string http_utils::http_header_www_authenticate =
     MHD_HTTP_HEADER_WWW_AUTHENTICATE;
+const std::string http_utils::http_header_traceparent = "traceparent";
 
 const std::string http_utils::http_version_1_0 = MHD_HTTP_VERSION_1_0;
 const std::string http_utils::http_version_1_1 = MHD_HTTP_VERSION_1_1;
@@ -246,8 +248,12 @@ void get_ip_str(
     if(sa)
     {
         char to_ret[NI_MAXHOST];
-        getnameinfo(sa, sizeof (struct sockaddr), to_ret, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
-        result = to_ret;
+        socklen_t len = sa->sa_family == AF_INET6 ?
+            sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+        if(getnameinfo(sa, len, to_ret, NI_MAXHOST, NULL, 0, NI_NUMERICHOST) == 0)
+            result = to_ret;
+        else
+            result.clear();
     }
 }
 
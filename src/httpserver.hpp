@@ -25,10 +25,17 @@
 
 #include "httpserver/http_utils.hpp"
 #include "httpserver/details/http_endpoint.hpp"
+#include "httpserver/executor.hpp"
+#include "httpserver/async_completion.hpp"
 #include "httpserver/http_resource.hpp"
+#include "httpserver/shared_buffer.hpp"
+#include "httpserver/header_template.hpp"
 #include "httpserver/http_response.hpp"
 #include "httpserver/http_response_builder.hpp"
 #include "httpserver/http_request.hpp"
+#include "httpserver/request_trace.hpp"
 #include "httpserver/webserver.hpp"
+#include "httpserver/timer_queue.hpp"
+#include "httpserver/coroutine.hpp"
 
 #endif
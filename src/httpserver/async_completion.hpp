@@ -0,0 +1,123 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _ASYNC_COMPLETION_HPP_
+#define _ASYNC_COMPLETION_HPP_
+
+#include <pthread.h>
+
+struct MHD_Connection;
+
+namespace httpserver
+{
+
+class webserver;
+class http_request;
+class http_response;
+class http_resource;
+class request_trace;
+
+namespace details
+{
+    class async_render_task;
+    struct modded_request;
+};
+
+/**
+ * Handle passed to http_resource::render_async. The connection of the
+ * request stays suspended, without blocking its event thread, until
+ * complete is called; the response is then sent. complete can be called
+ * from any thread and must be called exactly once, even after the
+ * webserver is stopped: stop() answers the pending requests with 503 and
+ * the responses completing them later are dropped. The handle and its
+ * request stay valid until complete is called.
+**/
+class async_completion
+{
+    public:
+        /**
+         * Method used to end the request.
+         * @param response The response to send; ownership is taken. If 0x0
+         * the internal error page is sent.
+        **/
+        void complete(http_response* response);
+
+    private:
+        typedef void (http_resource::*render_ptr)(const http_request&, http_response**);
+
+        async_completion(MHD_Connection* connection, http_resource* resource,
+                render_ptr callback, const http_request* request,
+                request_trace* trace
+        );
+
+        ~async_completion();
+
+        //returns true if the connection has been suspended, false if the
+        //request was already completed and can be answered right away.
+        bool suspend_unless_completed(bool can_suspend);
+
+        bool is_completed();
+
+        //ends the request with 503, unless it is already completed
+        void cancel();
+
+        bool is_cancelled();
+
+        http_response* take_response();
+
+        void retain();
+
+        //the request is gone: later completions are dropped.
+        void abandon();
+
+        void release();
+
+        pthread_mutex_t lock;
+        int num_references;
+        bool completed;
+        bool suspended;
+        bool abandoned;
+        bool cancelled;
+        //complete has been called: the reference it holds is released
+        bool answered;
+        http_response* response;
+        MHD_Connection* connection;
+        http_resource* resource;
+        render_ptr callback;
+        //owned: a queued render task can outlive the request
+        const http_request* request;
+        //owned too, since the request points to it (get_trace)
+        request_trace* trace;
+
+        async_completion(const async_completion& b);
+        async_completion& operator=(const async_completion& b);
+
+        friend class webserver;
+        friend class http_resource;
+        friend class details::async_render_task;
+        friend struct details::modded_request;
+};
+
+};
+#endif //_ASYNC_COMPLETION_HPP_
@@ -0,0 +1,359 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _COROUTINE_HPP_
+#define _COROUTINE_HPP_
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include "httpserver/http_resource.hpp"
+#include "httpserver/async_completion.hpp"
+#include "httpserver/executor.hpp"
+#include "httpserver/timer_queue.hpp"
+
+namespace httpserver
+{
+
+template<typename T>
+class task;
+
+namespace details
+{
+
+template<typename T>
+struct task_promise_base
+{
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept
+    {
+        return {};
+    }
+
+    struct final_awaiter
+    {
+        bool await_ready() noexcept
+        {
+            return false;
+        }
+
+        template<typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> h) noexcept
+        {
+            if(h.promise().continuation)
+                return h.promise().continuation;
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept
+        {
+        }
+    };
+
+    final_awaiter final_suspend() noexcept
+    {
+        return {};
+    }
+
+    void unhandled_exception()
+    {
+        error = std::current_exception();
+    }
+};
+
+template<typename T>
+struct task_promise: task_promise_base<T>
+{
+    T value{};
+
+    task<T> get_return_object();
+
+    void return_value(T v)
+    {
+        value = std::move(v);
+    }
+
+    T result()
+    {
+        if(this->error)
+            std::rethrow_exception(this->error);
+        return std::move(value);
+    }
+};
+
+template<>
+struct task_promise<void>: task_promise_base<void>
+{
+    task<void> get_return_object();
+
+    void return_void()
+    {
+    }
+
+    void result()
+    {
+        if(this->error)
+            std::rethrow_exception(this->error);
+    }
+};
+
+//started eagerly and destroyed when it ends: drives a render_async
+//coroutine and completes the request with its result.
+struct detached_task
+{
+    struct promise_type
+    {
+        detached_task get_return_object() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+
+        void return_void() noexcept
+        {
+        }
+
+        void unhandled_exception() noexcept
+        {
+        }
+    };
+};
+
+} //details
+
+/**
+ * Lazily started coroutine producing a T. It starts when it is awaited and
+ * resumes its awaiter when it ends; exceptions are rethrown to the awaiter.
+**/
+template<typename T>
+class task
+{
+    public:
+        typedef details::task_promise<T> promise_type;
+
+        task(task&& b) noexcept:
+            handle(std::exchange(b.handle, nullptr))
+        {
+        }
+
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
+
+        ~task()
+        {
+            if(handle)
+                handle.destroy();
+        }
+
+        bool await_ready() const noexcept
+        {
+            return !handle || handle.done();
+        }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiter) noexcept
+        {
+            handle.promise().continuation = awaiter;
+            return handle;
+        }
+
+        T await_resume()
+        {
+            return handle.promise().result();
+        }
+
+    private:
+        explicit task(std::coroutine_handle<promise_type> handle):
+            handle(handle)
+        {
+        }
+
+        std::coroutine_handle<promise_type> handle;
+
+        friend struct details::task_promise<T>;
+};
+
+namespace details
+{
+
+template<typename T>
+task<T> task_promise<T>::get_return_object()
+{
+    return task<T>(std::coroutine_handle<task_promise<T> >::from_promise(*this));
+}
+
+inline task<void> task_promise<void>::get_return_object()
+{
+    return task<void>(std::coroutine_handle<task_promise<void> >::from_promise(*this));
+}
+
+inline void resume_coroutine(void* address)
+{
+    std::coroutine_handle<>::from_address(address).resume();
+}
+
+class resume_task: public executor_task
+{
+    public:
+        explicit resume_task(std::coroutine_handle<> handle):
+            handle(handle)
+        {
+        }
+
+        void run()
+        {
+            handle.resume();
+        }
+
+    private:
+        std::coroutine_handle<> handle;
+};
+
+} //details
+
+/**
+ * Awaitable suspending the coroutine for a number of milliseconds without
+ * blocking any thread. The coroutine is resumed on the timer thread of
+ * timer_queue::shared(). If the webserver is stopped meanwhile, the
+ * request is answered 503 by stop(); the coroutine still resumes with a
+ * valid request and its response is dropped.
+**/
+struct sleep_awaiter
+{
+    unsigned int delay_ms;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        timer_queue::shared().schedule(
+                delay_ms, &details::resume_coroutine, h.address()
+        );
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+};
+
+inline sleep_awaiter async_sleep(unsigned int delay_ms)
+{
+    return sleep_awaiter{delay_ms};
+}
+
+/**
+ * Awaitable moving the coroutine on a thread of the passed executor, e.g.
+ * to continue with CPU-bound work after a timer or an I/O callback.
+**/
+struct schedule_awaiter
+{
+    executor* target;
+
+    bool await_ready() const noexcept
+    {
+        return false;
+    }
+
+    void await_suspend(std::coroutine_handle<> h)
+    {
+        target->submit(new details::resume_task(h));
+    }
+
+    void await_resume() const noexcept
+    {
+    }
+};
+
+inline schedule_awaiter resume_on(executor& target)
+{
+    return schedule_awaiter{&target};
+}
+
+/**
+ * Resource whose requests are answered by a coroutine. The connection is
+ * suspended while the coroutine waits and resumed when it returns the
+ * response, so a few event threads can serve many waiting handlers. The
+ * webserver needs suspend_resume (or an executor) enabled.
+**/
+class coroutine_resource: public http_resource
+{
+    public:
+        coroutine_resource()
+        {
+            set_async(true);
+        }
+
+        /**
+         * Method used to answer to any request.
+         * @param req Request passed through http; it is valid until the
+         * coroutine returns, even if the webserver is stopped first.
+         * @return the response to send (0x0 sends the internal error page).
+        **/
+        virtual task<http_response*> render_async(const http_request& req) = 0;
+
+        void render_async(const http_request& req, async_completion& completion) final
+        {
+            drive(this, req, completion);
+        }
+
+    private:
+        static details::detached_task drive(coroutine_resource* resource,
+                const http_request& req, async_completion& completion
+        )
+        {
+            //the completion, and the request it owns, stay valid until
+            //complete is called, also when the webserver is stopped first.
+            http_response* response = 0x0;
+            try
+            {
+                response = co_await resource->render_async(req);
+            }
+            catch(...)
+            {
+                response = 0x0;
+            }
+            completion.complete(response);
+        }
+};
+
+} //httpserver
+
+#endif //__cpp_impl_coroutine
+
+#endif //_COROUTINE_HPP_
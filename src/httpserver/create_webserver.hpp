@@ -26,22 +26,31 @@
 #define _CREATE_WEBSERVER_HPP_
 
 #include <stdlib.h>
+#include <vector>
 #include "httpserver/http_utils.hpp"
 
 #define DEFAULT_WS_TIMEOUT 180
 #define DEFAULT_WS_PORT 9898
+#define DEFAULT_RATE_LIMIT_CLIENTS 65536
+#define DEFAULT_LOG_BUFFER 1024
+#define DEFAULT_ERROR_LOG_RATE 10
+#define DEFAULT_SLOW_REQUESTS 64
 
 namespace httpserver {
 
 class webserver;
+class executor;
 class http_request;
 class http_response;
+class request_trace;
 
 typedef void(*render_ptr)(const http_request&, http_response**);
 typedef bool(*validator_ptr)(const std::string&);
 typedef void(*unescaper_ptr)(char*);
 typedef void(*log_access_ptr)(const std::string&);
 typedef void(*log_error_ptr)(const std::string&);
+typedef void(*log_batch_ptr)(const std::string&);
+typedef void(*trace_export_ptr)(const request_trace&);
 
 class create_webserver
 {
@@ -84,7 +93,36 @@ class create_webserver
             _not_found_resource(0x0),
             _method_not_allowed_resource(0x0),
             _method_not_acceptable_resource(0x0),
-            _internal_error_resource(0x0)
+            _internal_error_resource(0x0),
+            _mmap_file_responses(false),
+            _daemon_count(1),
+            _cpu_affinity(std::vector<int>()),
+            _async_threads(0),
+            _async_executor(0x0),
+            _async_work_stealing(false),
+            _suspend_resume(false),
+            _max_in_flight(0),
+            _max_queued(0),
+            _adaptive_concurrency(false),
+            _retry_after(1),
+            _service_unavailable_resource(0x0),
+            _inherit_sockets(""),
+            _rate_limit(0),
+            _rate_limit_burst(0),
+            _rate_limit_clients(DEFAULT_RATE_LIMIT_CLIENTS),
+            _too_many_requests_resource(0x0),
+            _auto_ban_threshold(0),
+            _auto_ban_window(60),
+            _auto_ban_duration(300),
+            _metrics_path(""),
+            _log_access_batch(0x0),
+            _access_log_buffer(DEFAULT_LOG_BUFFER),
+            _error_log_rate(DEFAULT_ERROR_LOG_RATE),
+            _trace_export(0x0),
+            _slow_request_threshold(0),
+            _slow_requests_count(DEFAULT_SLOW_REQUESTS),
+            _slow_requests_path(""),
+            _slow_requests_signal(0)
         {
         }
 
@@ -126,7 +164,36 @@ class create_webserver
             _not_found_resource(0x0),
             _method_not_allowed_resource(0x0),
             _method_not_acceptable_resource(0x0),
-            _internal_error_resource(0x0)
+            _internal_error_resource(0x0),
+            _mmap_file_responses(false),
+            _daemon_count(1),
+            _cpu_affinity(std::vector<int>()),
+            _async_threads(0),
+            _async_executor(0x0),
+            _async_work_stealing(false),
+            _suspend_resume(false),
+            _max_in_flight(0),
+            _max_queued(0),
+            _adaptive_concurrency(false),
+            _retry_after(1),
+            _service_unavailable_resource(0x0),
+            _inherit_sockets(""),
+            _rate_limit(0),
+            _rate_limit_burst(0),
+            _rate_limit_clients(DEFAULT_RATE_LIMIT_CLIENTS),
+            _too_many_requests_resource(0x0),
+            _auto_ban_threshold(0),
+            _auto_ban_window(60),
+            _auto_ban_duration(300),
+            _metrics_path(""),
+            _log_access_batch(0x0),
+            _access_log_buffer(DEFAULT_LOG_BUFFER),
+            _error_log_rate(DEFAULT_ERROR_LOG_RATE),
+            _trace_export(0x0),
+            _slow_request_threshold(0),
+            _slow_requests_count(DEFAULT_SLOW_REQUESTS),
+            _slow_requests_path(""),
+            _slow_requests_signal(0)
         {
         }
 
@@ -161,10 +228,13 @@ class create_webserver
         {
             _per_IP_connection_limit = per_IP_connection_limit; return *this;
         }
+        //called on the logging thread with one line per completed request:
+        //time, client, method, path, status, bytes and latency.
         create_webserver& log_access(log_access_ptr log_access)
         {
             _log_access = log_access; return *this;
         }
+        //called on the logging thread with each error message, formatted.
         create_webserver& log_error(log_error_ptr log_error)
         {
             _log_error = log_error; return *this;
@@ -332,6 +402,209 @@ class create_webserver
         {
             _internal_error_resource = internal_error_resource; return *this;
         }
+        //serve file responses from a memory mapping of the file; useful
+        //with use_ssl, where MHD cannot use sendfile. The files must not
+        //be truncated while they are served (see shared_buffer::from_file).
+        create_webserver& mmap_file_responses()
+        {
+            _mmap_file_responses = true; return *this;
+        }
+        create_webserver& no_mmap_file_responses()
+        {
+            _mmap_file_responses = false; return *this;
+        }
+        //starts n daemons, each on its own SO_REUSEPORT listen socket, so
+        //that the kernel balances accepts among them.
+        create_webserver& daemon_count(int daemon_count)
+        {
+            _daemon_count = daemon_count; return *this;
+        }
+        //pins each worker thread to one of the passed CPUs (round robin).
+        //Per-thread state is allocated after pinning and so it is placed
+        //on the local NUMA node by first-touch. Ignored with EXTERNAL_EPOLL:
+        //the threads belong to the application.
+        create_webserver& cpu_affinity(const std::vector<int>& cpus)
+        {
+            _cpu_affinity = cpus; return *this;
+        }
+        create_webserver& cpu_affinity(int first_cpu, int last_cpu)
+        {
+            _cpu_affinity.clear();
+            for(int cpu = first_cpu; cpu <= last_cpu; cpu++)
+                _cpu_affinity.push_back(cpu);
+            return *this;
+        }
+        //runs the render_async calls of asynchronous resources on an
+        //internal pool of n threads.
+        create_webserver& async_threads(int async_threads)
+        {
+            _async_threads = async_threads; return *this;
+        }
+        //runs the render_async calls of asynchronous resources on the passed
+        //executor; the caller owns it, starts it and stops it (after the
+        //webserver: stop waits for the render tasks still queued).
+        create_webserver& async_executor(executor* async_executor)
+        {
+            _async_executor = async_executor; return *this;
+        }
+        //uses a work-stealing pool instead of a single shared queue for
+        //the threads started by async_threads.
+        create_webserver& async_work_stealing()
+        {
+            _async_work_stealing = true; return *this;
+        }
+        create_webserver& no_async_work_stealing()
+        {
+            _async_work_stealing = false; return *this;
+        }
+        //allows asynchronous resources to keep their connection suspended
+        //without an executor (e.g. coroutines waiting on timers or I/O).
+        //It is implied by comet, async_threads and async_executor. Without
+        //it, a render_async not completed when it returns gets a 500.
+        create_webserver& suspend_resume()
+        {
+            _suspend_resume = true; return *this;
+        }
+        create_webserver& no_suspend_resume()
+        {
+            _suspend_resume = false; return *this;
+        }
+        //bounds the requests rendered at the same time by the whole
+        //server; requests over it wait in a queue of max_queued requests
+        //(with their connection suspended) or get 503 when it is full.
+        create_webserver& max_in_flight(int max_in_flight)
+        {
+            _max_in_flight = max_in_flight; return *this;
+        }
+        create_webserver& max_queued(int max_queued)
+        {
+            _max_queued = max_queued; return *this;
+        }
+        //lowers the max_in_flight limit when latency grows and raises it
+        //back when it recovers (additive increase, multiplicative decrease).
+        create_webserver& adaptive_concurrency()
+        {
+            _adaptive_concurrency = true; return *this;
+        }
+        create_webserver& no_adaptive_concurrency()
+        {
+            _adaptive_concurrency = false; return *this;
+        }
+        //seconds sent in the Retry-After header of rejected requests.
+        create_webserver& retry_after(int retry_after)
+        {
+            _retry_after = retry_after; return *this;
+        }
+        create_webserver& service_unavailable_resource(
+                render_ptr service_unavailable_resource
+        )
+        {
+            _service_unavailable_resource = service_unavailable_resource;
+            return *this;
+        }
+        //takes the listen sockets of a running server that calls
+        //webserver::hand_off on the passed Unix socket path, instead of
+        //binding the port; one daemon is started per inherited socket.
+        //If they do not arrive in HANDOFF_RECEIVE_TIMEOUT ms once
+        //connected, the port is bound as usual.
+        create_webserver& inherit_sockets(const std::string& path)
+        {
+            _inherit_sockets = path; return *this;
+        }
+        //token bucket per client address (IPv6: per /64): burst requests at
+        //once, then requests_per_second; requests over it get 429 Too Many
+        //Requests with Retry-After, and a client with no token left has
+        //its new connections refused. burst defaults to requests_per_second.
+        create_webserver& rate_limit(double requests_per_second,
+                double burst = 0
+        )
+        {
+            _rate_limit = requests_per_second;
+            _rate_limit_burst = burst;
+            return *this;
+        }
+        //bound of the clients tracked by each rate limiter and by the auto
+        //ban detector; the least recently seen are forgotten first.
+        create_webserver& rate_limit_clients(size_t rate_limit_clients)
+        {
+            _rate_limit_clients = rate_limit_clients; return *this;
+        }
+        create_webserver& too_many_requests_resource(
+                render_ptr too_many_requests_resource
+        )
+        {
+            _too_many_requests_resource = too_many_requests_resource;
+            return *this;
+        }
+        //bans for ban_seconds the clients getting threshold 4xx answers
+        //(rate limit violations included) within window_seconds; banned
+        //clients have their connections refused before any parsing.
+        create_webserver& auto_ban(int threshold, int window_seconds = 60,
+                int ban_seconds = 300
+        )
+        {
+            _auto_ban_threshold = threshold;
+            _auto_ban_window = window_seconds;
+            _auto_ban_duration = ban_seconds;
+            return *this;
+        }
+        //serves request counters, latency histograms and gauges in the
+        //Prometheus text format at path; no metric is kept when unset.
+        create_webserver& metrics_path(const std::string& path)
+        {
+            _metrics_path = path; return *this;
+        }
+        //receives at once all the access log lines the logging thread
+        //collected (each ended by a newline): one write per batch.
+        create_webserver& log_access_batch(log_batch_ptr log_access_batch)
+        {
+            _log_access_batch = log_access_batch; return *this;
+        }
+        //log records (accesses and errors) each thread can have pending;
+        //the records logged while its buffer is full are dropped and counted.
+        create_webserver& access_log_buffer(size_t records)
+        {
+            _access_log_buffer = records; return *this;
+        }
+        //error messages logged each second for each message template; the
+        //others are counted and reported with the next one logged. 0 logs
+        //them all.
+        create_webserver& error_log_rate(int messages_per_second)
+        {
+            _error_log_rate = messages_per_second; return *this;
+        }
+        //times every request through its processing phases and passes the
+        //trace to the callback once the request is completed, on the
+        //thread that served it (keep it short: queue the export). Requests
+        //with a traceparent header continue that trace.
+        create_webserver& trace_export(trace_export_ptr trace_export)
+        {
+            _trace_export = trace_export; return *this;
+        }
+        //keeps the last requests that took threshold_ms or more from the
+        //request line to completion, with their phase timings, route,
+        //header sizes and serving thread (see webserver::get_slow_requests).
+        create_webserver& slow_requests(int threshold_ms,
+                size_t count = DEFAULT_SLOW_REQUESTS
+        )
+        {
+            _slow_request_threshold = threshold_ms;
+            _slow_requests_count = count;
+            return *this;
+        }
+        //serves the slow requests recorded at path, one line each.
+        create_webserver& slow_requests_path(const std::string& path)
+        {
+            _slow_requests_path = path; return *this;
+        }
+        //dumps the slow requests recorded to the error log (or stderr
+        //without one) when the process receives signal while the server
+        //runs. Servers sharing the signal dump all; the handler found is
+        //restored when the last of them stops.
+        create_webserver& slow_requests_signal(int signal)
+        {
+            _slow_requests_signal = signal; return *this;
+        }
 
     private:
         uint16_t _port;
@@ -372,6 +645,35 @@ class create_webserver
         render_ptr _method_not_allowed_resource;
         render_ptr _method_not_acceptable_resource;
         render_ptr _internal_error_resource;
+        bool _mmap_file_responses;
+        int _daemon_count;
+        std::vector<int> _cpu_affinity;
+        int _async_threads;
+        executor* _async_executor;
+        bool _async_work_stealing;
+        bool _suspend_resume;
+        int _max_in_flight;
+        int _max_queued;
+        bool _adaptive_concurrency;
+        int _retry_after;
+        render_ptr _service_unavailable_resource;
+        std::string _inherit_sockets;
+        double _rate_limit;
+        double _rate_limit_burst;
+        size_t _rate_limit_clients;
+        render_ptr _too_many_requests_resource;
+        int _auto_ban_threshold;
+        int _auto_ban_window;
+        int _auto_ban_duration;
+        std::string _metrics_path;
+        log_batch_ptr _log_access_batch;
+        size_t _access_log_buffer;
+        int _error_log_rate;
+        trace_export_ptr _trace_export;
+        int _slow_request_threshold;
+        size_t _slow_requests_count;
+        std::string _slow_requests_path;
+        int _slow_requests_signal;
 
         friend class webserver;
 };
@@ -0,0 +1,95 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _ABUSE_DETECTOR_HPP_
+#define _ABUSE_DETECTOR_HPP_
+
+#include <stddef.h>
+#include "details/client_table.hpp"
+
+struct sockaddr;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Bans for a while the clients (see client_key) that accumulate abuse
+ * signals (4xx answers, rate limit violations) too quickly. Signals are
+ * counted in a sliding window approximated by two fixed ones: the count
+ * of the previous window is weighted by the part of it still covered.
+ * Bans expire on their own; their state lives in a bounded client_table
+ * next to the counters.
+**/
+class abuse_detector
+{
+    public:
+        abuse_detector(int threshold, int window_seconds, int ban_seconds,
+                size_t max_clients
+        );
+
+        /**
+         * Method used to count an abuse signal from a client.
+         * @param addr The address of the client.
+         * @return true if the client has just been banned.
+        **/
+        bool record(const struct sockaddr* addr);
+
+        /**
+         * Method used to know if a client is banned.
+         * @param addr The address of the client.
+        **/
+        bool banned(const struct sockaddr* addr);
+
+        /**
+         * Method used to know how many bans have been given so far.
+        **/
+        unsigned long get_bans() const
+        {
+            return bans;
+        }
+
+    private:
+        struct client
+        {
+            long window;
+            int current;
+            int previous;
+            double banned_until;
+        };
+
+        const int threshold;
+        const int window_seconds;
+        const int ban_seconds;
+        unsigned long bans;
+        client_table<client> clients;
+};
+
+} //details
+
+} //httpserver
+
+#endif //_ABUSE_DETECTOR_HPP_
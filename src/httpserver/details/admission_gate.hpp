@@ -0,0 +1,173 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _ADMISSION_GATE_HPP_
+#define _ADMISSION_GATE_HPP_
+
+#include <pthread.h>
+#include <time.h>
+#include "http_utils.hpp"
+#include "details/priority_fifo.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+class admission_gate;
+
+/**
+ * Slot of an admission_gate held (or waited for) by a request.
+**/
+struct admission_ticket
+{
+    admission_gate* gate;
+    admission_gate* queued_on;
+    bool rejected;
+    struct timespec since;
+
+    admission_ticket():
+        gate(0x0),
+        queued_on(0x0),
+        rejected(false)
+    {
+    }
+};
+
+/**
+ * Bounds the requests rendered at the same time. Requests over the limit
+ * wait, with their connection suspended, in a bounded queue (FIFO within
+ * each priority class) and are resumed as slots are released; when the
+ * queue is full they are rejected at once.
+ * In adaptive mode the limit moves between 1 and the configured maximum:
+ * it grows by one while the gate is saturated and latency stays near the
+ * lowest observed, and shrinks by 10% when latency rises above twice that
+ * (AIMD), so that queueing happens in front of the gate and not inside
+ * the handlers.
+**/
+class admission_gate
+{
+    public:
+        enum result_T
+        {
+            ADMITTED,
+            QUEUED,
+            REJECTED
+        };
+
+        admission_gate(int max_in_flight, int max_queued, bool adaptive);
+
+        ~admission_gate();
+
+        /**
+         * Method used to take a slot for a request. When QUEUED is returned
+         * the connection has been suspended and is resumed once the ticket
+         * has been granted a slot (or rejected by reject_waiters).
+         * @param ticket The ticket of the request.
+         * @param connection The connection of the request.
+         * @param can_queue false if the connection cannot be suspended.
+         * @param priority The class of the request, used to pick the next
+         * waiting request to admit.
+        **/
+        result_T acquire(admission_ticket& ticket,
+                struct MHD_Connection* connection, bool can_queue,
+                priority_T priority = NORMAL_PRIORITY
+        );
+
+        /**
+         * Method used to give back the slot of a ticket, or to leave the
+         * queue if the ticket is still waiting. Does nothing otherwise.
+        **/
+        void release(admission_ticket& ticket);
+
+        /**
+         * Method used to reject and resume every waiting request. Until
+         * reopen is called, requests over the limit are rejected instead
+         * of queued.
+        **/
+        void reject_waiters();
+
+        void reopen();
+
+        int get_limit();
+
+        int get_in_flight();
+
+        int get_queued();
+
+        unsigned long get_rejected();
+
+    private:
+        struct waiter
+        {
+            admission_ticket* ticket;
+            struct MHD_Connection* connection;
+
+            bool operator==(const waiter& b) const
+            {
+                return ticket == b.ticket;
+            }
+        };
+
+        const int max_in_flight;
+        const int max_queued;
+        const bool adaptive;
+        int limit;
+        int in_flight;
+        unsigned long rejected;
+        bool closed;
+        priority_fifo<waiter> waiters;
+        pthread_mutex_t lock;
+
+        bool saturated;
+        int samples;
+        double latency_sum;
+        double min_latency;
+        int windows;
+
+        admission_gate(const admission_gate& b);
+        admission_gate& operator=(const admission_gate& b);
+
+        void grant(admission_ticket& ticket);
+        void reject(const waiter& w);
+        void sample(double latency);
+        void grant_waiters();
+};
+
+/**
+ * Gives back the slot held by the ticket, or leaves the queue it waits in.
+**/
+inline void release_ticket(admission_ticket& ticket)
+{
+    admission_gate* gate = ticket.gate != 0x0 ? ticket.gate : ticket.queued_on;
+    if(gate != 0x0)
+        gate->release(ticket);
+}
+
+} //details
+
+} //httpserver
+
+#endif //_ADMISSION_GATE_HPP_
@@ -0,0 +1,63 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _ATOMICS_HPP_
+#define _ATOMICS_HPP_
+
+#if defined(__CLANG_ATOMICS)
+
+#define atomic_increment(object) \
+    __c11_atomicadd_fetch(object, 1, __ATOMIC_RELAXED)
+
+#define atomic_decrement(object) \
+    __c11_atomic_sub_fetch(object, 1, __ATOMIC_ACQ_REL)
+
+#define atomic_read(object) \
+    __sync_fetch_and_add(object, 0)
+
+#elif defined(__GNUC_ATOMICS)
+
+#define atomic_increment(object) \
+    __atomic_add_fetch(object, 1, __ATOMIC_RELAXED)
+
+#define atomic_decrement(object) \
+    __atomic_sub_fetch(object, 1, __ATOMIC_ACQ_REL)
+
+#define atomic_read(object) \
+    __atomic_load_n(object, __ATOMIC_ACQUIRE)
+
+#else
+
+#define atomic_increment(object) \
+    __sync_add_and_fetch(object, 1)
+
+#define atomic_decrement(object) \
+    __sync_sub_and_fetch(object, 1)
+
+#define atomic_read(object) \
+    __sync_fetch_and_add(object, 0)
+
+#endif
+
+#endif //_ATOMICS_HPP_
@@ -0,0 +1,163 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _CLIENT_TABLE_HPP_
+#define _CLIENT_TABLE_HPP_
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <list>
+#include <map>
+
+struct sockaddr;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+#define CLIENT_TABLE_SHARDS 64
+
+/**
+ * Key identifying a client: an IPv4 address (mapped ones included) or an
+ * IPv6 /64 network, the smallest block usually given to a single customer.
+ * @param addr The address of the client.
+ * @param key Filled with the key.
+ * @return false if the address is neither IPv4 nor IPv6.
+**/
+bool client_key(const struct sockaddr* addr, uint64_t& key);
+
+/**
+ * State kept per client, spread over CLIENT_TABLE_SHARDS independently
+ * locked shards. Each shard keeps at most max_clients / CLIENT_TABLE_SHARDS
+ * entries and forgets the least recently seen client when full.
+**/
+template<typename V>
+class client_table
+{
+    public:
+        explicit client_table(size_t max_clients):
+            shard_capacity(max_clients / CLIENT_TABLE_SHARDS)
+        {
+            if(shard_capacity == 0)
+                shard_capacity = 1;
+            for(int i = 0; i < CLIENT_TABLE_SHARDS; i++)
+                pthread_mutex_init(&shards[i].lock, NULL);
+        }
+
+        ~client_table()
+        {
+            for(int i = 0; i < CLIENT_TABLE_SHARDS; i++)
+                pthread_mutex_destroy(&shards[i].lock);
+        }
+
+        /**
+         * Method used to access the entry of a client. The shard of the
+         * client stays locked until unlock is called, even if no entry
+         * is returned.
+         * @param client The key of the client.
+         * @param create true to create a missing entry (value initialized).
+         * @param created Set to true if the entry has just been created.
+         * @return the entry, or null if missing and not created.
+        **/
+        V* lock(uint64_t client, bool create, bool& created)
+        {
+            shard& s = shard_of(client);
+            pthread_mutex_lock(&s.lock);
+            created = false;
+            typename std::map<uint64_t, entry>::iterator it =
+                s.entries.find(client);
+            if(it != s.entries.end())
+            {
+                s.recent.splice(s.recent.begin(), s.recent, it->second.recent);
+                return &it->second.value;
+            }
+            if(!create)
+                return 0x0;
+
+            if(s.entries.size() >= shard_capacity)
+            {
+                s.entries.erase(s.recent.back());
+                s.recent.pop_back();
+            }
+            s.recent.push_front(client);
+            entry& e = s.entries[client];
+            e.value = V();
+            e.recent = s.recent.begin();
+            created = true;
+            return &e.value;
+        }
+
+        void unlock(uint64_t client)
+        {
+            pthread_mutex_unlock(&shard_of(client).lock);
+        }
+
+        size_t size()
+        {
+            size_t result = 0;
+            for(int i = 0; i < CLIENT_TABLE_SHARDS; i++)
+            {
+                pthread_mutex_lock(&shards[i].lock);
+                result += shards[i].entries.size();
+                pthread_mutex_unlock(&shards[i].lock);
+            }
+            return result;
+        }
+
+    private:
+        struct entry
+        {
+            V value;
+            std::list<uint64_t>::iterator recent;
+        };
+
+        struct shard
+        {
+            pthread_mutex_t lock;
+            std::map<uint64_t, entry> entries;
+            //most recently seen first
+            std::list<uint64_t> recent;
+        };
+
+        size_t shard_capacity;
+        shard shards[CLIENT_TABLE_SHARDS];
+
+        client_table(const client_table& b);
+        client_table& operator=(const client_table& b);
+
+        shard& shard_of(uint64_t client)
+        {
+            return shards[((client * 0x9E3779B97F4A7C15ULL) >> 32) %
+                CLIENT_TABLE_SHARDS];
+        }
+};
+
+} //details
+
+} //httpserver
+
+#endif //_CLIENT_TABLE_HPP_
@@ -56,13 +56,34 @@ class comet_manager
 
         void complete_request(MHD_Connection* connection_id);
 
-        comet_manager(const comet_manager&)
+        //queues the message (if not empty) to every connection and lets
+        //them end once their queue is empty; returns their number.
+        int close_all(const std::string& message);
+
+        //connections currently subscribed to some topic
+        int count_subscribers();
+
+        //resumes the connection if it has been suspended by read_message;
+        //the lock must be held.
+        void resume(MHD_Connection* connection_id);
+
+        comet_manager(const comet_manager&):
+            closing(false),
+            subscribers(0)
         {
+            pthread_mutex_init(&lock, NULL);
         }
 
         std::map<MHD_Connection*, std::deque<std::string> > q_messages;
         std::map<std::string, std::set<MHD_Connection*> > q_topics;
         std::map<MHD_Connection*, std::set<std::string> > q_subscriptions;
+        //connections suspended waiting for a message
+        std::set<MHD_Connection*> q_suspended;
+        bool closing;
+        int subscribers;
+        //guards the maps: they are used by the MHD threads and by the
+        //threads sending messages or draining the server
+        pthread_mutex_t lock;
         friend class httpserver::webserver;
 };
 
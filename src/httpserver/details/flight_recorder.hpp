@@ -0,0 +1,159 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _FLIGHT_RECORDER_HPP_
+#define _FLIGHT_RECORDER_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "request_trace.hpp"
+#include "details/thread_shards.hpp"
+
+//longer urls and routes are truncated
+#define SLOW_REQUEST_URL 256
+#define SLOW_REQUEST_ROUTE 128
+
+//phase offsets of the phases a request did not reach
+#define SLOW_REQUEST_NOT_REACHED ((uint64_t) -1)
+
+namespace httpserver
+{
+
+namespace details
+{
+
+struct slow_request
+{
+    //wall clock time the request has been received at, in microseconds
+    uint64_t start_time;
+    //microseconds from RECEIVED to each phase
+    uint64_t phases[request_trace::PHASES];
+    unsigned long thread;
+    int status;
+    char method[16];
+    char url[SLOW_REQUEST_URL];
+    char route[SLOW_REQUEST_ROUTE];
+    char trace_id[33];
+    unsigned int request_headers;
+    unsigned long request_header_bytes;
+    unsigned int response_headers;
+    unsigned long response_header_bytes;
+
+    uint64_t duration() const
+    {
+        return phases[request_trace::COMPLETED];
+    }
+};
+
+/**
+ * The last requests that took longer than a threshold, kept to explain
+ * latency spikes after the fact. Each thread writes the requests it
+ * served in a ring of its own (see thread_shards), so that recording
+ * takes no lock; the requests faster than the threshold cost only the
+ * comparison. Every slot carries a sequence number, odd while the slot is
+ * written, that lets readers skip the slots changing under them.
+**/
+class flight_recorder
+{
+    public:
+        /**
+         * @param threshold_us The time from RECEIVED to COMPLETED above
+         * which a request is recorded.
+         * @param size The number of requests kept (and of slots of each
+         * thread).
+        **/
+        flight_recorder(uint64_t threshold_us, size_t size);
+
+        bool is_slow(uint64_t duration_us) const
+        {
+            return duration_us >= threshold;
+        }
+
+        /**
+         * Method used to get the slot the next request of the calling
+         * thread is recorded in; it is published by commit.
+        **/
+        slow_request* reserve();
+
+        void commit();
+
+        /**
+         * Method used to get the last requests recorded.
+         * @param result The vector the requests are copied in, the one
+         * completed first first.
+        **/
+        void get_requests(std::vector<slow_request>& result);
+
+        /**
+         * Method used to append the last requests recorded to a dump, one
+         * line each.
+         * @param result The string the requests are appended to.
+        **/
+        void render(std::string& result);
+
+        static void render_request(std::string& result,
+                const slow_request& request
+        );
+
+    private:
+        struct slot
+        {
+            volatile unsigned long sequence;
+            slow_request request;
+        };
+
+        struct ring
+        {
+            //allocated by the first slow request of the thread
+            slot* volatile slots;
+            unsigned long written;
+
+            ring():
+                slots(0x0),
+                written(0)
+            {
+            }
+
+            ~ring()
+            {
+                delete[] slots;
+            }
+        };
+
+        const uint64_t threshold;
+        const size_t size;
+        thread_shards<ring> shards;
+
+        flight_recorder(const flight_recorder&);
+
+        flight_recorder& operator=(const flight_recorder&);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_FLIGHT_RECORDER_HPP_
@@ -26,32 +26,7 @@
 #define _HTTP_RESPONSE_PTR_HPP_
 
 #include "http_response.hpp"
-
-#if defined(__CLANG_ATOMICS)
-
-#define atomic_increment(object) \
-    __c11_atomicadd_fetch(object, 1, __ATOMIC_RELAXED)
-
-#define atomic_decrement(object) \
-    __c11_atomic_sub_fetch(object, 1, __ATOMIC_ACQ_REL)
-
-#elif defined(__GNUC_ATOMICS)
-
-#define atomic_increment(object) \
-    __atomic_add_fetch(object, 1, __ATOMIC_RELAXED)
-
-#define atomic_decrement(object) \
-    __atomic_sub_fetch(object, 1, __ATOMIC_ACQ_REL)
-
-#else
-
-#define atomic_increment(object) \
-    __sync_add_and_fetch(object, 1)
-
-#define atomic_decrement(object) \
-    __sync_sub_and_fetch(object, 1)
-
-#endif
+#include "details/atomics.hpp"
 
 namespace httpserver
 {
@@ -61,38 +36,37 @@ class webserver;
 namespace details
 {
 
+/**
+ * Smart pointer to an http_response. The reference counter lives inside
+ * the response itself so that neither empty pointers nor copies allocate.
+**/
 struct http_response_ptr
 {
     public:
         http_response_ptr(http_response* res = 0x0):
             res(res)
         {
-            num_references = new int(1);
+            if (res != 0x0) atomic_increment(&res->num_references);
         }
 
         http_response_ptr(const http_response_ptr& b):
-            res(b.res),
-            num_references(b.num_references)
+            res(b.res)
         {
-            atomic_increment(b.num_references);
+            if (res != 0x0) atomic_increment(&res->num_references);
         }
 
         ~http_response_ptr()
         {
-            if (atomic_decrement(num_references) != 0) return;
-
-            if (res != 0x0) delete res;
-            if (num_references != 0x0) delete num_references;
+            if (res != 0x0 && atomic_decrement(&res->num_references) == 0)
+                delete res;
 
             res = 0x0;
-            num_references = 0x0;
         }
 
         http_response_ptr& operator=(http_response_ptr b)
         {
             using std::swap;
 
-            swap(this->num_references, b.num_references);
             swap(this->res, b.res);
 
             return *this;
@@ -115,7 +89,6 @@ struct http_response_ptr
 
     private:
         http_response* res;
-        int* num_references;
         friend class ::httpserver::webserver;
 };
 
@@ -0,0 +1,130 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _IP_FILTER_HPP_
+#define _IP_FILTER_HPP_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct sockaddr;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Set of IP prefixes stored in a path-compressed binary radix trie.
+ * Addresses are kept as 128 bits: IPv4 addresses are stored mapped
+ * (::ffff:a.b.c.d), so an IPv4 rule also matches the same client seen
+ * through an IPv6 socket. A lookup walks at most one node per distinct
+ * prefix length on the path, whatever the number of entries.
+ * Rules are written as plain addresses, in CIDR notation (10.0.0.0/8,
+ * 2001:db8::/32) or with the "*" wildcard on whole IPv4 bytes or IPv6
+ * groups (10.1.*.*). Trailing wildcards become a shorter prefix; inner
+ * wildcards are expanded and are limited to two bytes.
+ * Modifications are not synchronized with lookups.
+**/
+class ip_filter
+{
+    public:
+        ip_filter();
+
+        /**
+         * Method used to add a rule.
+         * @param ip The rule (address, CIDR or wildcard notation).
+         * @throw bad_ip_format_exception if the rule cannot be parsed.
+        **/
+        void insert(const std::string& ip);
+
+        /**
+         * Method used to remove a rule previously inserted. Nothing
+         * happens if the rule is not present.
+         * @param ip The rule, written as (or equivalent to) when inserted.
+         * @throw bad_ip_format_exception if the rule cannot be parsed.
+        **/
+        void remove(const std::string& ip);
+
+        /**
+         * Method used to know if an address is covered by a rule.
+         * @param addr The address (AF_INET or AF_INET6).
+         * @return true if a rule matches it.
+        **/
+        bool contains(const struct sockaddr* addr) const;
+
+        /**
+         * Method used to know if an address is covered by a rule.
+         * @param ip The address, as a string.
+         * @return true if a rule matches it.
+        **/
+        bool contains(const std::string& ip) const;
+
+        /**
+         * Method used to know if an address is covered by a rule.
+         * @param addr 16 bytes of the address (IPv4 mapped).
+         * @return true if a rule matches it.
+        **/
+        bool contains(const unsigned char* addr) const;
+
+        size_t size() const
+        {
+            return entries;
+        }
+
+        bool empty() const
+        {
+            return entries == 0;
+        }
+
+        void clear();
+
+    private:
+        struct node
+        {
+            unsigned char key[16];
+            unsigned char length;
+            bool terminal;
+            uint32_t child[2];
+        };
+
+        std::vector<node> nodes;
+        std::vector<uint32_t> free_nodes;
+        uint32_t root;
+        size_t entries;
+
+        uint32_t alloc(const unsigned char* key, int length, bool terminal);
+        void release(uint32_t n);
+        void insert_prefix(const unsigned char* key, int length);
+        void remove_prefix(const unsigned char* key, int length);
+        void expand(const std::string& ip, bool insertion);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_IP_FILTER_HPP_
@@ -0,0 +1,214 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _LOG_SINK_HPP_
+#define _LOG_SINK_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <vector>
+
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+#include "details/thread_shards.hpp"
+
+//longer paths are truncated
+#define LOG_RECORD_TEXT 384
+
+//the drain thread delivers at least this often
+#define LOG_FLUSH_INTERVAL_MS 100
+
+//templates a log_throttle tells apart; more share the slots
+#define LOG_THROTTLE_TEMPLATES 64
+
+namespace httpserver
+{
+
+namespace details
+{
+
+struct log_record
+{
+    enum kind_T
+    {
+        ACCESS_LOG,
+        ERROR_LOG
+    };
+
+    kind_T kind;
+    struct timeval time;
+    union
+    {
+        struct sockaddr base;
+        struct sockaddr_in v4;
+        struct sockaddr_in6 v6;
+    } client;
+    const char* method;
+    int status;
+    uint64_t bytes;
+    uint64_t latency_us;
+    //error messages of the same template not logged since the last one
+    unsigned long suppressed;
+    char text[LOG_RECORD_TEXT];
+};
+
+/**
+ * Moves log records out of the threads serving requests. Every thread
+ * writes in its own single producer ring (see thread_shards) and never
+ * waits: when its ring is full the record is dropped and counted. A
+ * background thread empties the rings at every LOG_FLUSH_INTERVAL_MS, or
+ * as soon as a ring is half full, and hands all the records it found to
+ * the flush callback in one batch.
+**/
+class log_sink
+{
+    public:
+        typedef void(*flush_ptr)(void* cls, const log_record* records,
+                size_t count
+        );
+
+        /**
+         * @param ring_size Records each thread can have pending (rounded
+         * up to a power of two).
+         * @param flush Called on the drain thread with each batch.
+         * @param cls Passed to flush.
+        **/
+        log_sink(size_t ring_size, flush_ptr flush, void* cls);
+
+        /**
+         * Delivers the pending records and stops the drain thread.
+        **/
+        ~log_sink();
+
+        /**
+         * Method used to get a free record in the ring of the calling
+         * thread. Fill it and call commit.
+         * @return the record, or null if the ring is full (the record is
+         * counted as dropped).
+        **/
+        log_record* reserve();
+
+        /**
+         * Method used to publish the record got from reserve.
+        **/
+        void commit();
+
+        /**
+         * Method used to wait until the records committed before the call
+         * have been delivered.
+        **/
+        void flush();
+
+        /**
+         * Method used to know how many records have been dropped because a
+         * ring was full.
+        **/
+        unsigned long get_dropped();
+
+    private:
+        struct ring
+        {
+            log_record* slots;
+            volatile size_t head;
+            volatile size_t tail;
+            unsigned long dropped;
+
+            ~ring()
+            {
+                delete[] slots;
+            }
+        };
+
+        const size_t ring_size;
+        const flush_ptr deliver;
+        void* const cls;
+        thread_shards<ring> rings;
+        pthread_t drainer;
+        pthread_mutex_t guard;
+        pthread_cond_t wake;
+        pthread_cond_t drained;
+        bool stopping;
+        unsigned long passes;
+
+        static void* drain(void* self);
+
+        void drain_rings(std::vector<log_record>& batch);
+
+        log_sink(const log_sink&);
+
+        log_sink& operator=(const log_sink&);
+};
+
+/**
+ * Lets through at most a number of messages per second for each message
+ * template (a format string, compared by address) and counts the others,
+ * so that a storm of the same error costs one counter increment per
+ * message. No lock is taken; under contention the limit is approximate.
+**/
+class log_throttle
+{
+    public:
+        /**
+         * @param per_second Messages of a template logged each second; 0
+         * logs them all.
+        **/
+        explicit log_throttle(int per_second);
+
+        /**
+         * Method used to know if a message has to be logged.
+         * @param key The template of the message.
+         * @param suppressed Set to the messages of the template dropped
+         * since the last one logged.
+         * @return true if the message has to be logged.
+        **/
+        bool admit(const void* key, unsigned long& suppressed);
+
+    private:
+        struct slot
+        {
+            const void* key;
+            long second;
+            int count;
+            unsigned long suppressed;
+        };
+
+        const int per_second;
+        slot slots[LOG_THROTTLE_TEMPLATES];
+
+        slot& find(const void* key);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_LOG_SINK_HPP_
@@ -0,0 +1,195 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _METRICS_HPP_
+#define _METRICS_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string>
+#include "details/thread_shards.hpp"
+
+//routes beyond the limit are counted together with the unmatched requests
+#define METRICS_MAX_ROUTES 256
+
+#define METRICS_METHODS 10
+
+//1xx to 5xx
+#define METRICS_STATUS_CLASSES 5
+
+//latencies below 4us are exact, the others fall in one of the 4 buckets
+//their power of two is split in; the last bucket starts at 7 * 2^24us
+#define METRICS_LATENCY_BUCKETS 104
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Request counters and latency histograms, kept per thread (see
+ * thread_shards) and summed only when scraped. Every thread writes in its
+ * own shard without atomics nor locks. Scrapes read the shards while they
+ * are written: a value may miss the last increments but never goes back.
+**/
+class metrics
+{
+    public:
+        metrics();
+
+        ~metrics();
+
+        /**
+         * Method used to get the id a route is counted under. To be called
+         * at registration time: it takes a lock.
+         * @param route The url the resource is registered on.
+         * @return the id of the route (0, shared with the unmatched
+         * requests, once METRICS_MAX_ROUTES routes are known).
+        **/
+        int route_id(const std::string& route);
+
+        /**
+         * Method used to map a method name to its counters.
+         * @param method The method of the request.
+        **/
+        static int method_id(const char* method);
+
+        /**
+         * Method used to get the name of a method id ("OTHER" for the
+         * methods counted together).
+        **/
+        static const char* method_name(int method);
+
+        /**
+         * Method used to read the clock latencies are measured with.
+         * @return the microseconds elapsed since an arbitrary point.
+        **/
+        static uint64_t now();
+
+        /**
+         * Method used to count a completed request.
+         * @param route The id of the route that served it.
+         * @param method The id of its method.
+         * @param status The status code of the response.
+         * @param latency_us The time taken to answer it in microseconds.
+        **/
+        void record_request(int route, int method, int status,
+                uint64_t latency_us
+        );
+
+        void add_received(size_t bytes)
+        {
+            shards.local()->received += bytes;
+        }
+
+        void add_sent(size_t bytes)
+        {
+            shards.local()->sent += bytes;
+        }
+
+        void cache_hit()
+        {
+            shards.local()->cache_hits++;
+        }
+
+        void cache_miss()
+        {
+            shards.local()->cache_misses++;
+        }
+
+        /**
+         * Method used to append the counters to a scrape, in the
+         * Prometheus text format.
+         * @param result The string the metrics are appended to.
+        **/
+        void render(std::string& result);
+
+        /**
+         * Method used to append a gauge to a scrape, in the Prometheus
+         * text format.
+        **/
+        static void render_gauge(std::string& result, const char* name,
+                const char* help, double value
+        );
+
+        /**
+         * Method used to append a counter to a scrape, in the Prometheus
+         * text format.
+        **/
+        static void render_counter(std::string& result, const char* name,
+                const char* help, unsigned long long value
+        );
+
+        /**
+         * Method used to know which bucket of the histogram a latency
+         * falls in.
+        **/
+        static int latency_bucket(uint64_t latency_us);
+
+        /**
+         * Method used to know the (exclusive) upper bound of a bucket of
+         * the histogram in microseconds.
+        **/
+        static uint64_t latency_bound(int bucket);
+
+    private:
+        struct route_stats
+        {
+            uint64_t requests[METRICS_METHODS][METRICS_STATUS_CLASSES];
+            uint64_t latency[METRICS_LATENCY_BUCKETS];
+            uint64_t latency_sum;
+        };
+
+        struct shard
+        {
+            route_stats* volatile routes[METRICS_MAX_ROUTES];
+            uint64_t received;
+            uint64_t sent;
+            uint64_t cache_hits;
+            uint64_t cache_misses;
+
+            ~shard()
+            {
+                for(int i = 0; i < METRICS_MAX_ROUTES; i++)
+                    delete routes[i];
+            }
+        };
+
+        thread_shards<shard> shards;
+        pthread_mutex_t guard;
+        std::string routes[METRICS_MAX_ROUTES];
+        int routes_count;
+
+        metrics(const metrics&);
+
+        metrics& operator=(const metrics&);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_METRICS_HPP_
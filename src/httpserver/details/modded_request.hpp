@@ -25,8 +25,13 @@
 #ifndef _MODDED_REQUEST_HPP_
 #define _MODDED_REQUEST_HPP_
 
+#include <stdint.h>
 #include "binders.hpp"
 #include "details/http_response_ptr.hpp"
+#include "details/object_pool.hpp"
+#include "async_completion.hpp"
+#include "details/admission_gate.hpp"
+#include "request_trace.hpp"
 
 namespace httpserver
 {
@@ -46,6 +51,19 @@ struct modded_request
     http_request* dhr;
     http_response_ptr dhrs;
     bool second;
+    async_completion* async;
+    admission_ticket resource_ticket;
+    admission_ticket global_ticket;
+    bool admission_pending;
+    bool rate_checked;
+    uint64_t started;
+    int route_id;
+    int method_id;
+    request_trace* trace;
+    //the matched registration, recorded at routing time when tracing
+    std::string route;
+    unsigned int request_headers;
+    unsigned long request_header_bytes;
 
     modded_request():
         pp(0x0),
@@ -54,7 +72,16 @@ struct modded_request
         ws(0x0),
         dhr(0x0),
         dhrs(0x0),
-        second(false)
+        second(false),
+        async(0x0),
+        admission_pending(false),
+        rate_checked(false),
+        started(0),
+        route_id(0),
+        method_id(0),
+        trace(0x0),
+        request_headers(0),
+        request_header_bytes(0)
     {
     }
     ~modded_request()
@@ -63,10 +90,31 @@ struct modded_request
         {
             MHD_destroy_post_processor (pp);
         }
-        if(second)
+        if(async != 0x0)
+        {
+            async->abandon();
+            async->release();
+        }
+        release_ticket(resource_ticket);
+        release_ticket(global_ticket);
+        //an async completion owns its request and trace: a render task
+        //still queued can use them after the request is over
+        if(second && async == 0x0)
             delete dhr; //TODO: verify. It could be an error
         delete complete_uri;
         delete standardized_url;
+        if(async == 0x0)
+            delete trace;
+    }
+
+    static void* operator new(size_t size)
+    {
+        return pool_allocate(size);
+    }
+
+    static void operator delete(void* p)
+    {
+        pool_release(p);
     }
 
 };
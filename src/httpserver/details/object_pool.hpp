@@ -0,0 +1,51 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _OBJECT_POOL_HPP_
+#define _OBJECT_POOL_HPP_
+
+#include <stddef.h>
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Thread-local free lists used by the class-level allocation operators of
+ * the objects created for every request (modded_request, http_response).
+ * Blocks are kept in per-size lists owned by the thread that releases
+ * them, so steady-state traffic is served without calling the allocator.
+ * Lists are bounded and drained when their thread exits.
+**/
+void* pool_allocate(size_t size);
+
+void pool_release(void* p);
+
+} //details
+
+} //httpserver
+
+#endif //_OBJECT_POOL_HPP_
@@ -0,0 +1,161 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _PRIORITY_FIFO_HPP_
+#define _PRIORITY_FIFO_HPP_
+
+#include <deque>
+#include <stddef.h>
+#include "executor.hpp"
+
+namespace httpserver
+{
+
+namespace details
+{
+
+//items of a higher class served in a row before a waiting item of a
+//lower class is let through
+#define PRIORITY_STARVATION_LIMIT 8
+
+/**
+ * FIFO queue per priority class. pop serves the highest class first, but
+ * a class that has been passed over PRIORITY_STARVATION_LIMIT times in a
+ * row is served next, so that lower classes slow down under overload
+ * instead of starving. Not thread safe.
+**/
+template<typename T>
+class priority_fifo
+{
+    public:
+        priority_fifo():
+            items(0)
+        {
+            for(int i = 0; i < PRIORITY_CLASSES; i++)
+                passed_over[i] = 0;
+        }
+
+        void push(const T& item, priority_T priority)
+        {
+            queues[clamp(priority)].push_back(item);
+            items++;
+        }
+
+        bool pop(T& item)
+        {
+            int chosen = -1;
+            for(int i = 0; i < PRIORITY_CLASSES; i++)
+            {
+                if(queues[i].empty())
+                    continue;
+                if(chosen == -1)
+                    chosen = i;
+                else if(passed_over[i] >= PRIORITY_STARVATION_LIMIT)
+                {
+                    chosen = i;
+                    break;
+                }
+            }
+            if(chosen == -1)
+                return false;
+
+            passed_over[chosen] = 0;
+            for(int i = chosen + 1; i < PRIORITY_CLASSES; i++)
+            {
+                if(!queues[i].empty())
+                    passed_over[i]++;
+            }
+            item = queues[chosen].front();
+            queues[chosen].pop_front();
+            items--;
+            return true;
+        }
+
+        /**
+         * Removes the newest item of the lowest class below priority, to
+         * make room for an item of that priority.
+        **/
+        bool evict_below(priority_T priority, T& item)
+        {
+            for(int i = PRIORITY_CLASSES - 1; i > clamp(priority); i--)
+            {
+                if(!queues[i].empty())
+                {
+                    item = queues[i].back();
+                    queues[i].pop_back();
+                    items--;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool remove(const T& item)
+        {
+            for(int i = 0; i < PRIORITY_CLASSES; i++)
+            {
+                for(typename std::deque<T>::iterator it = queues[i].begin();
+                        it != queues[i].end(); ++it)
+                {
+                    if(*it == item)
+                    {
+                        queues[i].erase(it);
+                        items--;
+                        return true;
+                    }
+                }
+            }
+            return false;
+        }
+
+        size_t size() const
+        {
+            return items;
+        }
+
+        bool empty() const
+        {
+            return items == 0;
+        }
+
+    private:
+        std::deque<T> queues[PRIORITY_CLASSES];
+        int passed_over[PRIORITY_CLASSES];
+        size_t items;
+
+        static int clamp(priority_T priority)
+        {
+            if(priority < HIGH_PRIORITY)
+                return HIGH_PRIORITY;
+            if(priority > LOW_PRIORITY)
+                return LOW_PRIORITY;
+            return priority;
+        }
+};
+
+} //details
+
+} //httpserver
+
+#endif //_PRIORITY_FIFO_HPP_
@@ -0,0 +1,88 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _RATE_LIMITER_HPP_
+#define _RATE_LIMITER_HPP_
+
+#include <stddef.h>
+#include "details/client_table.hpp"
+
+struct sockaddr;
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Token bucket per client (see client_key): a client may send burst
+ * requests at once and then rate requests per second. The buckets live in
+ * a bounded client_table; forgetting the least recently seen client is
+ * harmless once it has been idle long enough to refill its bucket.
+**/
+class rate_limiter
+{
+    public:
+        rate_limiter(double rate, double burst, size_t max_clients);
+
+        /**
+         * Method used to take a token for a request of a client.
+         * @param addr The address of the client.
+         * @return 0 if the request can go on, otherwise the seconds to
+         * wait for the next token (1 at least).
+        **/
+        int consume(const struct sockaddr* addr);
+
+        /**
+         * Method used to know if a client has no token left, without
+         * taking one.
+         * @param addr The address of the client.
+        **/
+        bool exhausted(const struct sockaddr* addr);
+
+        size_t size()
+        {
+            return buckets.size();
+        }
+
+    private:
+        struct bucket
+        {
+            double tokens;
+            double last;
+        };
+
+        const double rate;
+        const double burst;
+        client_table<bucket> buckets;
+
+        void refill(bucket& b, bool created, double now);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_RATE_LIMITER_HPP_
@@ -0,0 +1,165 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _SNAPSHOT_HPP_
+#define _SNAPSHOT_HPP_
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Immutable object replaced as a whole by its writers while readers use
+ * it without locks. Readers announce themselves on one of two counters,
+ * picked by the parity of an epoch; a writer publishes the new version,
+ * then flips the epoch twice, each time waiting for the counter just left
+ * to drain, so that no reader can still hold the previous version when it
+ * is deleted. Readers never wait; writers are serialized and wait for the
+ * readers in progress only (the flips keep new readers out of the counter
+ * being drained).
+**/
+template<typename T>
+class snapshot
+{
+    public:
+        /**
+         * Scope in which a reader can use the current version.
+        **/
+        class read_guard
+        {
+            public:
+                explicit read_guard(snapshot& s):
+                    owner(s),
+                    parity(__sync_fetch_and_add(&s.epoch, 0) & 1)
+                {
+                    //full barrier: the version is read after the counter
+                    //is visible to the writers
+                    __sync_add_and_fetch(&s.readers[parity], 1);
+                    version = s.current;
+                }
+
+                ~read_guard()
+                {
+                    __sync_sub_and_fetch(&owner.readers[parity], 1);
+                }
+
+                const T* operator->() const
+                {
+                    return version;
+                }
+
+                const T& operator*() const
+                {
+                    return *version;
+                }
+
+            private:
+                snapshot& owner;
+                int parity;
+                const T* version;
+
+                read_guard(const read_guard& b);
+                read_guard& operator=(const read_guard& b);
+        };
+
+        explicit snapshot(T* initial):
+            current(initial),
+            epoch(0)
+        {
+            readers[0] = readers[1] = 0;
+            pthread_mutex_init(&update_lock, NULL);
+        }
+
+        ~snapshot()
+        {
+            delete current;
+            pthread_mutex_destroy(&update_lock);
+        }
+
+        /**
+         * Method used to start an update: it excludes the other writers
+         * until publish or unlock is called.
+         * @return the current version, to be copied and modified.
+        **/
+        const T& lock()
+        {
+            pthread_mutex_lock(&update_lock);
+            return *current;
+        }
+
+        void unlock()
+        {
+            pthread_mutex_unlock(&update_lock);
+        }
+
+        /**
+         * Method used to replace the current version and end the update
+         * started by lock. It returns once the previous version, deleted,
+         * is no longer used by any reader.
+         * @param next The new version; the snapshot takes ownership.
+        **/
+        void publish(T* next)
+        {
+            T* previous = current;
+            __sync_synchronize();
+            current = next;
+            __sync_synchronize();
+            for(int i = 0; i < 2; i++)
+            {
+                int parity = __sync_fetch_and_add(&epoch, 1) & 1;
+                for(int spins = 0;
+                        __sync_fetch_and_add(&readers[parity], 0) != 0; spins++)
+                {
+                    //a reader preempted in its scope needs the cpu
+                    if(spins < 64)
+                        sched_yield();
+                    else
+                        usleep(50);
+                }
+            }
+            pthread_mutex_unlock(&update_lock);
+            delete previous;
+        }
+
+    private:
+        T* volatile current;
+        int epoch;
+        int readers[2];
+        pthread_mutex_t update_lock;
+
+        snapshot(const snapshot& b);
+        snapshot& operator=(const snapshot& b);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_SNAPSHOT_HPP_
@@ -0,0 +1,76 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _SOCKET_HANDOFF_HPP_
+#define _SOCKET_HANDOFF_HPP_
+
+#include <string>
+#include <vector>
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Passing of listen sockets between processes over a Unix domain socket
+ * (SCM_RIGHTS). The running process listens on the path and sends its
+ * sockets to the successor that connects; the successor answers with one
+ * byte once it accepts on them. The path is only reachable by the owner
+ * and peers of other users are refused. All the functions return -1 or
+ * false on failure (always on systems without Unix domain sockets).
+**/
+
+//number of sockets that can be passed at once
+#define HANDOFF_MAX_SOCKETS 64
+
+//milliseconds a successor waits for the running process to listen
+#define HANDOFF_CONNECT_TIMEOUT 5000
+
+//milliseconds a successor waits for the sockets once connected
+#define HANDOFF_RECEIVE_TIMEOUT 5000
+
+int handoff_listen(const std::string& path);
+
+int handoff_accept(int listener, int timeout_ms);
+
+int handoff_connect(const std::string& path, int timeout_ms);
+
+bool handoff_send_sockets(int channel, const std::vector<int>& sockets);
+
+//the sockets received are close-on-exec
+bool handoff_receive_sockets(int channel, std::vector<int>& sockets,
+        int timeout_ms
+);
+
+bool handoff_send_ack(int channel);
+
+bool handoff_wait_ack(int channel, int timeout_ms);
+
+} //details
+
+} //httpserver
+
+#endif //_SOCKET_HANDOFF_HPP_
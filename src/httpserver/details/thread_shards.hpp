@@ -0,0 +1,133 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _THREAD_SHARDS_HPP_
+#define _THREAD_SHARDS_HPP_
+
+#include <pthread.h>
+#include <map>
+#include <vector>
+
+//registries a thread remembers its shard of without taking a lock
+#define THREAD_SHARDS_CACHED 4
+
+namespace httpserver
+{
+
+namespace details
+{
+
+struct cached_shard
+{
+    unsigned long owner;
+    void* shard;
+};
+
+//ids are never reused, so a stale entry cannot match a newer registry
+extern __thread cached_shard thread_shards_cache[THREAD_SHARDS_CACHED];
+
+unsigned long next_thread_shards_id();
+
+/**
+ * One T per thread, created the first time the thread asks for it and
+ * kept until the registry is destroyed (a thread that ends leaves its
+ * shard to the next thread with the same id). Only the owner thread
+ * writes in a shard; readers go through get_shards. A thread finds its
+ * shard in a thread-local cache and takes the lock only on a miss.
+**/
+template<typename T>
+class thread_shards
+{
+    public:
+        thread_shards():
+            id(next_thread_shards_id())
+        {
+            pthread_mutex_init(&guard, NULL);
+        }
+
+        ~thread_shards()
+        {
+            typename std::map<pthread_t, T*>::iterator it;
+            for(it = shards.begin(); it != shards.end(); ++it)
+                delete it->second;
+            pthread_mutex_destroy(&guard);
+        }
+
+        T* local()
+        {
+            cached_shard& cached = thread_shards_cache[id % THREAD_SHARDS_CACHED];
+            if(cached.owner == id)
+                return static_cast<T*>(cached.shard);
+            return attach();
+        }
+
+        /**
+         * Method used to get the shards created so far.
+         * @param result The vector the shards are copied in.
+        **/
+        void get_shards(std::vector<T*>& result)
+        {
+            pthread_mutex_lock(&guard);
+            result.clear();
+            typename std::map<pthread_t, T*>::const_iterator it;
+            for(it = shards.begin(); it != shards.end(); ++it)
+                result.push_back(it->second);
+            pthread_mutex_unlock(&guard);
+        }
+
+    private:
+        const unsigned long id;
+        pthread_mutex_t guard;
+        std::map<pthread_t, T*> shards;
+
+        T* attach()
+        {
+            pthread_t self = pthread_self();
+            pthread_mutex_lock(&guard);
+            typename std::map<pthread_t, T*>::iterator it = shards.find(self);
+            T* shard;
+            if(it != shards.end())
+                shard = it->second;
+            else
+            {
+                shard = new T();
+                shards[self] = shard;
+            }
+            pthread_mutex_unlock(&guard);
+            cached_shard& cached = thread_shards_cache[id % THREAD_SHARDS_CACHED];
+            cached.owner = id;
+            cached.shard = shard;
+            return shard;
+        }
+
+        thread_shards(const thread_shards&);
+
+        thread_shards& operator=(const thread_shards&);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_THREAD_SHARDS_HPP_
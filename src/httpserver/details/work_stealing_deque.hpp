@@ -0,0 +1,182 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _WORK_STEALING_DEQUE_HPP_
+#define _WORK_STEALING_DEQUE_HPP_
+
+#include <vector>
+
+namespace httpserver
+{
+
+namespace details
+{
+
+/**
+ * Chase-Lev deque ("Dynamic circular work-stealing deque", SPAA 2005, with
+ * the fences of Le et al., PPoPP 2013). Only the owner thread calls push
+ * and take, on the bottom end; any thread can call steal on the top end.
+ * Arrays replaced when growing are kept until destruction, since a thief
+ * can still be reading them.
+**/
+template<typename T>
+class work_stealing_deque
+{
+    public:
+        //the capacity is rounded up to a power of two
+        work_stealing_deque(long initial_capacity = 256):
+            top(0),
+            bottom(0),
+            items(0x0)
+        {
+            circular_array* a = new circular_array(round_capacity(initial_capacity));
+            retired.push_back(a);
+            items = a;
+        }
+
+        ~work_stealing_deque()
+        {
+            for(unsigned int i = 0; i < retired.size(); i++)
+                delete retired[i];
+        }
+
+        void push(T* item)
+        {
+            long b = bottom;
+            long t = top;
+            __sync_synchronize();
+            circular_array* a = items;
+            if(b - t > a->capacity - 1)
+            {
+                a = a->grow(b, t);
+                retired.push_back(a);
+                items = a;
+            }
+            a->put(b, item);
+            __sync_synchronize();
+            bottom = b + 1;
+        }
+
+        T* take()
+        {
+            long b = bottom - 1;
+            circular_array* a = items;
+            bottom = b;
+            __sync_synchronize();
+            long t = top;
+            if(t > b)
+            {
+                bottom = b + 1;
+                return 0x0;
+            }
+            T* item = a->get(b);
+            if(t == b)
+            {
+                if(!__sync_bool_compare_and_swap(&top, t, t + 1))
+                    item = 0x0;
+                bottom = b + 1;
+            }
+            return item;
+        }
+
+        T* steal()
+        {
+            long t = top;
+            __sync_synchronize();
+            long b = bottom;
+            //the array and its slot are read after bottom: otherwise an
+            //array replaced by a concurrent push can be seen
+            __sync_synchronize();
+            if(t >= b)
+                return 0x0;
+            circular_array* a = items;
+            T* item = a->get(t);
+            if(!__sync_bool_compare_and_swap(&top, t, t + 1))
+                return 0x0;
+            return item;
+        }
+
+        bool empty() const
+        {
+            return bottom <= top;
+        }
+
+    private:
+        struct circular_array
+        {
+            long capacity;
+            T* volatile* slots;
+
+            explicit circular_array(long capacity):
+                capacity(capacity),
+                slots(new T* volatile[capacity])
+            {
+            }
+
+            ~circular_array()
+            {
+                delete[] slots;
+            }
+
+            T* get(long i) const
+            {
+                return slots[i & (capacity - 1)];
+            }
+
+            void put(long i, T* item)
+            {
+                slots[i & (capacity - 1)] = item;
+            }
+
+            circular_array* grow(long b, long t) const
+            {
+                circular_array* a = new circular_array(capacity * 2);
+                for(long i = t; i < b; i++)
+                    a->put(i, get(i));
+                return a;
+            }
+        };
+
+        static long round_capacity(long capacity)
+        {
+            long rounded = 1;
+            while(rounded < capacity)
+                rounded <<= 1;
+            return rounded;
+        }
+
+        volatile long top;
+        volatile long bottom;
+        circular_array* volatile items;
+        std::vector<circular_array*> retired;
+
+        work_stealing_deque(const work_stealing_deque& b);
+        work_stealing_deque& operator=(const work_stealing_deque& b);
+};
+
+} //details
+
+} //httpserver
+
+#endif //_WORK_STEALING_DEQUE_HPP_
@@ -0,0 +1,195 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _EXECUTOR_HPP_
+#define _EXECUTOR_HPP_
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+namespace httpserver
+{
+
+/**
+ * Classes of requests and tasks. Under load, higher classes are served
+ * first; lower classes are still served now and then, so they are never
+ * starved.
+**/
+enum priority_T
+{
+    HIGH_PRIORITY = 0,
+    NORMAL_PRIORITY = 1,
+    LOW_PRIORITY = 2
+};
+
+#define PRIORITY_CLASSES 3
+
+namespace details
+{
+    template<typename T> class priority_fifo;
+}
+
+/**
+ * Unit of work run by an executor.
+**/
+class executor_task
+{
+    public:
+        virtual ~executor_task()
+        {
+        }
+
+        virtual void run() = 0;
+};
+
+/**
+ * Interface of the objects that run the asynchronous render calls of the
+ * webserver. An executor takes the ownership of the submitted tasks and
+ * deletes them once they have run. Tasks submitted before stop is called
+ * are always run.
+**/
+class executor
+{
+    public:
+        virtual ~executor()
+        {
+        }
+
+        virtual void start()
+        {
+        }
+
+        virtual void stop()
+        {
+        }
+
+        /**
+         * Method used to schedule a task. It can be called from any thread.
+         * @param task The task to run; the executor deletes it after running it.
+        **/
+        virtual void submit(executor_task* task) = 0;
+
+        /**
+         * Method used to schedule a task of a priority class. Executors
+         * that do not support priorities run it as submit(task) does.
+         * @param task The task to run; the executor deletes it after running it.
+         * @param priority The class of the task.
+        **/
+        virtual void submit(executor_task* task, priority_T priority)
+        {
+            submit(task);
+        }
+};
+
+/**
+ * Executor running tasks on a fixed number of threads, in FIFO order
+ * within each priority class.
+**/
+class thread_pool_executor: public executor
+{
+    public:
+        explicit thread_pool_executor(int threads);
+
+        ~thread_pool_executor();
+
+        void start();
+
+        void stop();
+
+        void submit(executor_task* task);
+
+        void submit(executor_task* task, priority_T priority);
+
+    private:
+        int num_threads;
+        bool running;
+        details::priority_fifo<executor_task*>* tasks;
+        std::vector<pthread_t> threads;
+        pthread_mutex_t tasks_lock;
+        pthread_cond_t tasks_cond;
+
+        thread_pool_executor(const thread_pool_executor& b);
+        thread_pool_executor& operator=(const thread_pool_executor& b);
+
+        static void* worker(void* self);
+};
+
+/**
+ * Executor where each worker owns a Chase-Lev deque. Tasks submitted by a
+ * worker go to its own deque; tasks submitted from other threads (the
+ * event threads of the webserver) are spread over per-worker injection
+ * queues. Idle workers steal from random victims and park when there is
+ * no work left, so that no single queue is shared by all the threads.
+ * High and low priority tasks bypass the deques: they are kept in two
+ * shared queues, looked at before and after the normal tasks.
+**/
+class work_stealing_executor: public executor
+{
+    public:
+        explicit work_stealing_executor(int threads);
+
+        ~work_stealing_executor();
+
+        void start();
+
+        void stop();
+
+        void submit(executor_task* task);
+
+        void submit(executor_task* task, priority_T priority);
+
+    private:
+        struct worker;
+
+        int num_threads;
+        volatile bool running;
+        std::vector<worker*> workers;
+        std::vector<pthread_t> threads;
+        std::deque<executor_task*> urgent;
+        std::deque<executor_task*> background;
+        long urgent_count;
+        long background_count;
+        pthread_mutex_t shared_lock;
+        long pending;
+        int sleepers;
+        unsigned int next_victim;
+        pthread_mutex_t park_lock;
+        pthread_cond_t park_cond;
+
+        work_stealing_executor(const work_stealing_executor& b);
+        work_stealing_executor& operator=(const work_stealing_executor& b);
+
+        executor_task* find_task(worker* w);
+        executor_task* take_shared(std::deque<executor_task*>& queue,
+                long* count
+        );
+        void park(worker* w);
+        void wake();
+
+        static void* work(void* self);
+};
+
+};
+#endif //_EXECUTOR_HPP_
@@ -0,0 +1,104 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _HEADER_TEMPLATE_HPP_
+#define _HEADER_TEMPLATE_HPP_
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+namespace httpserver
+{
+
+class http_response;
+
+/**
+ * Fixed set of headers, footers and cookies shared by many responses.
+ * Entries are validated when they are added and cookies are serialized
+ * once, so that decorating a response is a single pass over a flat array.
+ * A template is attached by reference to a response builder: it has to
+ * outlive every response built with it and should not be modified once
+ * attached. Headers set directly on the builder override the ones in
+ * the template with the same name.
+**/
+class header_template
+{
+    public:
+        header_template()
+        {
+        }
+
+        /**
+         * Adds a header to the template.
+         * @param key The name of the header; it must be a valid token.
+         * @param value The value of the header; it cannot contain CR or LF.
+         * @throw http::bad_header_format_exception if the header is invalid.
+        **/
+        header_template& with_header(const std::string& key,
+                const std::string& value
+        );
+
+        /**
+         * Adds a footer to the template.
+         * @throw http::bad_header_format_exception if the footer is invalid.
+        **/
+        header_template& with_footer(const std::string& key,
+                const std::string& value
+        );
+
+        /**
+         * Adds a cookie to the template. The Set-Cookie value is built here
+         * and not each time a response is decorated.
+         * @throw http::bad_header_format_exception if the cookie is invalid.
+        **/
+        header_template& with_cookie(const std::string& key,
+                const std::string& value
+        );
+
+        size_t size() const
+        {
+            return entries.size();
+        }
+
+    private:
+        struct entry
+        {
+            std::string key;
+            std::string value;
+            bool footer;
+            bool cookie;
+        };
+
+        std::vector<entry> entries;
+
+        header_template& add(const std::string& key,
+                const std::string& value, bool footer, bool cookie
+        );
+
+        friend class http_response;
+};
+
+};
+#endif //_HEADER_TEMPLATE_HPP_
@@ -37,6 +37,7 @@ namespace httpserver
 {
 
 class webserver;
+class request_trace;
 
 namespace http
 {
@@ -362,6 +363,15 @@ class http_request
         {
             return this->requestor_port;
         }
+        /**
+         * Method used to get the trace of the request, to read its ids
+         * or to propagate it (see request_trace::get_traceparent).
+         * @return the trace, or null if the webserver does not trace.
+        **/
+        const request_trace* get_trace() const
+        {
+            return this->trace;
+        }
         bool check_digest_auth(const std::string& realm,
                 const std::string& password,
                 int nonce_timeout, bool& reload_nonce
@@ -373,7 +383,8 @@ class http_request
          * Default constructor of the class. It is a specific responsibility of apis to initialize this type of objects.
         **/
         http_request():
-            content(""), content_size_limit(static_cast<size_t>(-1))
+            content(""), content_size_limit(static_cast<size_t>(-1)),
+            trace(0x0)
         {
         }
         /**
@@ -396,7 +407,8 @@ class http_request
             content_size_limit(b.content_size_limit),
             version(b.version),
             requestor(b.requestor),
-            underlying_connection(b.underlying_connection)
+            underlying_connection(b.underlying_connection),
+            trace(b.trace)
         {
         }
         std::string user;
@@ -417,6 +429,7 @@ class http_request
 
         short requestor_port;
         struct MHD_Connection* underlying_connection;
+        const request_trace* trace;
 
         void set_underlying_connection(struct MHD_Connection* conn)
         {
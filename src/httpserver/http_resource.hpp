@@ -26,6 +26,7 @@
 #define _http_resource_hpp_
 #include <map>
 #include <string>
+#include "httpserver/executor.hpp"
 
 #ifdef DEBUG
 #include <iostream>
@@ -37,6 +38,7 @@ namespace httpserver
 class webserver;
 class http_request;
 class http_response;
+class async_completion;
 
 namespace details
 {
@@ -142,6 +144,76 @@ class http_resource
         {
             render(req, res);
         }
+        /**
+         * Method used to answer to a request without blocking the event
+         * thread. It is called only for resources set as asynchronous, on
+         * the executor of the webserver or, if it has none, on the event
+         * thread (see create_webserver::suspend_resume). The default
+         * implementation calls the render method matching the request and
+         * completes with its response.
+         * @param req Request passed through http
+         * @param completion Object to complete, exactly once, with the response
+        **/
+        virtual void render_async(const http_request& req, async_completion& completion);
+        /**
+         * Method used to set if the resource has to be rendered through
+         * render_async instead of the synchronous render methods.
+         * @param async true to render the resource asynchronously
+        **/
+        void set_async(bool async)
+        {
+            this->async = async;
+        }
+        /**
+         * Method used to know if the resource is rendered asynchronously
+         * @return true if the resource is asynchronous
+        **/
+        bool is_async() const
+        {
+            return this->async;
+        }
+        /**
+         * Method used to bound the requests to this resource rendered at
+         * the same time. Requests over the limit wait in a queue, with
+         * their connection suspended, and are answered with 503 Service
+         * Unavailable when the queue is full. It has to be called before
+         * the resource is registered.
+         * @param max_in_flight maximum number of concurrent renders (0: no limit)
+         * @param max_queued maximum number of waiting requests
+         * @param adaptive true to lower the limit automatically when the
+         * latency of the resource grows (max_in_flight is the upper bound)
+        **/
+        void set_concurrency_limit(int max_in_flight, int max_queued = 0,
+                bool adaptive = false
+        )
+        {
+            this->max_in_flight = max_in_flight;
+            this->max_queued = max_queued;
+            this->adaptive_limit = adaptive;
+        }
+        /**
+         * Method used to bound the rate of the requests of each client to
+         * this resource (token bucket per client address, in addition to
+         * create_webserver::rate_limit). Requests over the rate are
+         * answered with 429 Too Many Requests. It has to be called before
+         * the resource is registered.
+         * @param requests_per_second sustained rate (0: no limit)
+         * @param burst requests accepted at once (default: the rate)
+        **/
+        void set_rate_limit(double requests_per_second, double burst = 0)
+        {
+            this->rate_limit = requests_per_second;
+            this->rate_limit_burst = burst;
+        }
+        /**
+         * Method used to know the priority class the resource has been
+         * registered with (see webserver::register_resource).
+         * @return the priority class of the resource
+        **/
+        priority_T get_priority() const
+        {
+            return this->priority;
+        }
         /**
          * Method used to set if a specific method is allowed or not on this request
          * @param method method to set permission on
@@ -199,18 +271,42 @@ class http_resource
         /**
          * Constructor of the class
         **/
-        http_resource()
+        http_resource():
+            async(false),
+            max_in_flight(0),
+            max_queued(0),
+            adaptive_limit(false),
+            priority(NORMAL_PRIORITY),
+            rate_limit(0),
+            rate_limit_burst(0)
         {
             resource_init(allowed_methods);
         }
         /**
          * Copy constructor
         **/
-        http_resource(const http_resource& b) : allowed_methods(b.allowed_methods) { }
+        http_resource(const http_resource& b) :
+            allowed_methods(b.allowed_methods),
+            async(b.async),
+            max_in_flight(b.max_in_flight),
+            max_queued(b.max_queued),
+            adaptive_limit(b.adaptive_limit),
+            priority(b.priority),
+            rate_limit(b.rate_limit),
+            rate_limit_burst(b.rate_limit_burst)
+        {
+        }
 
         http_resource& operator = (const http_resource& b)
         {
             allowed_methods = b.allowed_methods;
+            async = b.async;
+            max_in_flight = b.max_in_flight;
+            max_queued = b.max_queued;
+            adaptive_limit = b.adaptive_limit;
+            priority = b.priority;
+            rate_limit = b.rate_limit;
+            rate_limit_burst = b.rate_limit_burst;
             return (*this);
         }
 
@@ -218,6 +314,13 @@ class http_resource
         friend class webserver;
         friend void resource_init(std::map<std::string, bool>& res);
         std::map<std::string, bool> allowed_methods;
+        bool async;
+        int max_in_flight;
+        int max_queued;
+        bool adaptive_limit;
+        priority_T priority;
+        double rate_limit;
+        double rate_limit_burst;
 };
 
 };
@@ -32,6 +32,8 @@
 #include <vector>
 
 #include "httpserver/binders.hpp"
+#include "httpserver/shared_buffer.hpp"
+#include "httpserver/header_template.hpp"
 
 struct MHD_Connection;
 
@@ -73,6 +75,15 @@ class http_response
 
         http_response(const http_response_builder& builder);
 
+#if __cplusplus >= 201103L
+        /**
+         * Builds the response moving content, headers, footers and cookies
+         * out of the builder instead of copying them.
+         * @param builder The builder to consume.
+        **/
+        http_response(http_response_builder&& builder);
+#endif
+
         /**
          * Copy constructor
          * @param b The http_response object to copy attributes value from.
@@ -86,9 +97,12 @@ class http_response
             reload_nonce(b.reload_nonce),
             fp(b.fp),
             filename(b.filename),
+            file_size(b.file_size),
+            shared_content(b.shared_content),
             headers(b.headers),
             footers(b.footers),
             cookies(b.cookies),
+            fixed_headers(b.fixed_headers),
             topics(b.topics),
             keepalive_secs(b.keepalive_secs),
             keepalive_msg(b.keepalive_msg),
@@ -101,23 +115,56 @@ class http_response
             enqueue_response(b.enqueue_response),
             completed(b.completed),
             ws(b.ws),
-            connection_id(b.connection_id)
+            connection_id(b.connection_id),
+            num_references(0)
         {
         }
 
         ~http_response();
+
+        /**
+         * Responses are allocated from a thread-local pool, so that
+         * creating one for every request does not hit the allocator.
+        **/
+        static void* operator new(size_t size);
+        static void operator delete(void* p);
+
+        static void* operator new(size_t size, void* where)
+        {
+            return where;
+        }
+
+        static void operator delete(void* p, void* where)
+        {
+        }
+
         /**
          * Method used to get the content from the response.
          * @return the content in string form
         **/
         std::string get_content()
         {
+            if(!this->shared_content.empty())
+                return std::string(shared_content.data(), shared_content.size());
             return this->content;
         }
 
         void get_content(std::string& result)
         {
-            result = this->content;
+            if(!this->shared_content.empty())
+                result.assign(shared_content.data(), shared_content.size());
+            else
+                result = this->content;
+        }
+
+        /**
+         * Method used to get the shared buffer holding the content of the
+         * response (empty if the response was built from a string).
+         * @return the shared buffer, without copying its bytes.
+        **/
+        const shared_buffer& get_shared_content() const
+        {
+            return this->shared_content;
         }
 
         /**
@@ -246,9 +293,13 @@ class http_response
         bool reload_nonce;
         int fp;
         std::string filename;
+        //bytes of the file once a file response is built
+        size_t file_size;
+        shared_buffer shared_content;
         std::map<std::string, std::string, http::header_comparator> headers;
         std::map<std::string, std::string, http::header_comparator> footers;
         std::map<std::string, std::string, http::header_comparator> cookies;
+        const header_template* fixed_headers;
         std::vector<std::string> topics;
         int keepalive_secs;
         std::string keepalive_msg;
@@ -265,6 +316,10 @@ class http_response
 
         webserver* ws;
         MHD_Connection* connection_id;
+        int num_references;
+
+        //length of the body sent, once the raw response is built
+        size_t body_size() const;
 
         void get_raw_response_str(MHD_Response** res, webserver* ws = 0x0);
         void get_raw_response_file(MHD_Response** res, webserver* ws = 0x0);
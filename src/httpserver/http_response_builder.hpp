@@ -26,7 +26,10 @@
 #define _HTTP_RESPONSE_BUILDER_HPP_
 #include <map>
 #include <string>
+#include <utility>
 #include "httpserver/http_response.hpp"
+#include "httpserver/shared_buffer.hpp"
+#include "httpserver/header_template.hpp"
 
 struct MHD_Connection;
 
@@ -87,11 +90,13 @@ class http_response_builder
             _headers(std::map<std::string, std::string, http::header_comparator>()),
             _footers(std::map<std::string, std::string, http::header_comparator>()),
             _cookies(std::map<std::string, std::string, http::header_comparator>()),
+            _fixed_headers(0x0),
             _topics(std::vector<std::string>()),
             _keepalive_secs(-1),
             _keepalive_msg(""),
             _send_topic(""),
             _ce(0x0),
+            _shared_content(),
             _get_raw_response(&http_response::get_raw_response_str),
             _decorate_response(&http_response::decorate_response_str),
             _enqueue_response(&http_response::enqueue_response_str)
@@ -114,11 +119,83 @@ class http_response_builder
             _headers(std::map<std::string, std::string, http::header_comparator>()),
             _footers(std::map<std::string, std::string, http::header_comparator>()),
             _cookies(std::map<std::string, std::string, http::header_comparator>()),
+            _fixed_headers(0x0),
             _topics(std::vector<std::string>()),
             _keepalive_secs(-1),
             _keepalive_msg(""),
             _send_topic(""),
             _ce(0x0),
+            _shared_content(),
+            _get_raw_response(&http_response::get_raw_response_str),
+            _decorate_response(&http_response::decorate_response_str),
+            _enqueue_response(&http_response::enqueue_response_str)
+        {
+            _headers[http::http_utils::http_header_content_type] = content_type;
+        }
+
+#if __cplusplus >= 201103L
+        /**
+         * Builds a string response moving the passed content inside the
+         * builder; the content is moved again when the builder is passed
+         * as an rvalue to the http_response constructor.
+        **/
+        explicit http_response_builder(
+            std::string&& content_hook,
+            int response_code = 200,
+            const std::string& content_type = "text/plain",
+            bool autodelete = true
+        ):
+            _content_hook(std::move(content_hook)),
+            _response_code(response_code),
+            _autodelete(autodelete),
+            _realm(""),
+            _opaque(""),
+            _reload_nonce(false),
+            _headers(std::map<std::string, std::string, http::header_comparator>()),
+            _footers(std::map<std::string, std::string, http::header_comparator>()),
+            _cookies(std::map<std::string, std::string, http::header_comparator>()),
+            _fixed_headers(0x0),
+            _topics(std::vector<std::string>()),
+            _keepalive_secs(-1),
+            _keepalive_msg(""),
+            _send_topic(""),
+            _ce(0x0),
+            _shared_content(),
+            _get_raw_response(&http_response::get_raw_response_str),
+            _decorate_response(&http_response::decorate_response_str),
+            _enqueue_response(&http_response::enqueue_response_str)
+        {
+            _headers[http::http_utils::http_header_content_type] = content_type;
+        }
+#endif
+
+        /**
+         * Builds a response whose content is a shared_buffer. The bytes are
+         * never copied: the response keeps a reference to the buffer and
+         * hands its memory directly to the daemon.
+        **/
+        http_response_builder(
+            const shared_buffer& content_hook,
+            int response_code = 200,
+            const std::string& content_type = "text/plain",
+            bool autodelete = true
+        ):
+            _content_hook(""),
+            _response_code(response_code),
+            _autodelete(autodelete),
+            _realm(""),
+            _opaque(""),
+            _reload_nonce(false),
+            _headers(std::map<std::string, std::string, http::header_comparator>()),
+            _footers(std::map<std::string, std::string, http::header_comparator>()),
+            _cookies(std::map<std::string, std::string, http::header_comparator>()),
+            _fixed_headers(0x0),
+            _topics(std::vector<std::string>()),
+            _keepalive_secs(-1),
+            _keepalive_msg(""),
+            _send_topic(""),
+            _ce(0x0),
+            _shared_content(content_hook),
             _get_raw_response(&http_response::get_raw_response_str),
             _decorate_response(&http_response::decorate_response_str),
             _enqueue_response(&http_response::enqueue_response_str)
@@ -136,11 +213,13 @@ class http_response_builder
             _headers(b._headers),
             _footers(b._footers),
             _cookies(b._cookies),
+            _fixed_headers(b._fixed_headers),
             _topics(b._topics),
             _keepalive_secs(b._keepalive_secs),
             _keepalive_msg(b._keepalive_msg),
             _send_topic(b._send_topic),
             _ce(b._ce),
+            _shared_content(b._shared_content),
             _get_raw_response(b._get_raw_response),
             _decorate_response(b._decorate_response),
             _enqueue_response(b._enqueue_response)
@@ -158,11 +237,13 @@ class http_response_builder
             _headers = b._headers;
             _footers = b._footers;
             _cookies = b._cookies;
+            _fixed_headers = b._fixed_headers;
             _topics = b._topics;
             _keepalive_secs = b._keepalive_secs;
             _keepalive_msg = b._keepalive_msg;
             _send_topic = b._send_topic;
             _ce = b._ce;
+            _shared_content = b._shared_content;
             _get_raw_response = b._get_raw_response;
             _decorate_response = b._decorate_response;
             _enqueue_response = b._enqueue_response;
@@ -178,6 +259,17 @@ class http_response_builder
             return *this;
         }
 
+        /**
+         * Creates the response described by the builder. The response is
+         * drawn from the thread-local pool and is owned by the caller
+         * (usually it is handed to the webserver through render).
+         * @return a newly allocated response.
+        **/
+        http_response* build() const
+        {
+            return new http_response(*this);
+        }
+
         http_response_builder& file_response()
         {
             _get_raw_response = &http_response::get_raw_response_file;
@@ -260,6 +352,16 @@ class http_response_builder
             _cookies[key] = value; return *this;
         }
 
+        /**
+         * Attaches a set of fixed headers to the response. The template is
+         * referenced, not copied, and must outlive the response.
+         * @param fixed_headers The template to attach.
+        **/
+        http_response_builder& with_header_template(const header_template& fixed_headers)
+        {
+            _fixed_headers = &fixed_headers; return *this;
+        }
+
     private:
         std::string _content_hook;
         int _response_code;
@@ -270,12 +372,14 @@ class http_response_builder
         std::map<std::string, std::string, http::header_comparator> _headers;
         std::map<std::string, std::string, http::header_comparator> _footers;
         std::map<std::string, std::string, http::header_comparator> _cookies;
+        const header_template* _fixed_headers;
         std::vector<std::string> _topics;
         int _keepalive_secs;
         std::string _keepalive_msg;
         std::string _send_topic;
         cycle_callback_ptr _cycle_callback;
         details::cache_entry* _ce;
+        shared_buffer _shared_content;
 
         void (http_response::*_get_raw_response)(MHD_Response**, webserver*);
         void (http_response::*_decorate_response)(MHD_Response*);
@@ -58,6 +58,14 @@ class file_access_exception: public std::exception
     }
 };
 
+class bad_header_format_exception: public std::exception
+{
+    virtual const char* what() const throw()
+    {
+        return "Header is badly formatted!";
+    }
+};
+
 class http_utils
 {
     public:
@@ -81,7 +89,10 @@ class http_utils
 #else
         INTERNAL_SELECT = MHD_USE_SELECT_INTERNALLY | MHD_USE_EPOLL_LINUX_ONLY | MHD_USE_EPOLL_TURBO, 
 #endif
-        THREAD_PER_CONNECTION = MHD_USE_THREAD_PER_CONNECTION | MHD_USE_POLL
+        THREAD_PER_CONNECTION = MHD_USE_THREAD_PER_CONNECTION | MHD_USE_POLL,
+        //no thread: the application polls webserver::get_epoll_fd in its
+        //own event loop and calls webserver::run_once (Linux only)
+        EXTERNAL_EPOLL = MHD_USE_EPOLL_LINUX_ONLY
     };
 
     enum policy_T
@@ -150,6 +161,7 @@ class http_utils
     static const int http_failed_dependency;
     static const int http_unordered_collection;
     static const int http_upgrade_required;
+    static const int http_too_many_requests;
     static const int http_retry_with;
 
     static const int http_internal_server_error;
@@ -213,6 +225,8 @@ class http_utils
     static const std::string http_header_via;
     static const std::string http_header_warning;
     static const std::string http_header_www_authenticate;
+    /* W3C Trace Context */
+    static const std::string http_header_traceparent;
 
     static const std::string http_version_1_0;
     static const std::string http_version_1_1;
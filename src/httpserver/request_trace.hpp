@@ -0,0 +1,189 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _REQUEST_TRACE_HPP_
+#define _REQUEST_TRACE_HPP_
+
+#include <stdint.h>
+#include <string>
+
+namespace httpserver
+{
+
+class webserver;
+
+/**
+ * Timing of a request through the phases of its processing, collected
+ * when the webserver is created with create_webserver::trace_export, and
+ * its place in a distributed trace (W3C Trace Context): a request coming
+ * with a valid traceparent header continues that trace, any other starts
+ * a new one. The request is a span of its own, child of the traceparent.
+**/
+class request_trace
+{
+    public:
+        enum phase_T
+        {
+            //the request line has been read
+            RECEIVED,
+            //headers, arguments and body are in the http_request
+            PARSED,
+            //the resource answering the request has been looked up
+            ROUTED,
+            //the response object is ready (resource or error page)
+            RENDERED,
+            //the response has been converted for the network layer
+            RESPONSE_BUILT,
+            //the response has been queued on the connection
+            ENQUEUED,
+            //the response has been sent or the connection has been closed
+            COMPLETED,
+            PHASES
+        };
+
+        /**
+         * Method used to get the time a phase has been reached.
+         * @param phase The phase.
+         * @return microseconds on a monotonic clock; 0 if the request did
+         * not reach the phase.
+        **/
+        uint64_t get_phase_time(phase_T phase) const
+        {
+            return phases[phase];
+        }
+
+        /**
+         * Method used to get the time spent between two phases.
+         * @return microseconds; 0 if any of the two was not reached.
+        **/
+        uint64_t get_duration(phase_T from, phase_T to) const
+        {
+            if(phases[from] == 0 || phases[to] < phases[from])
+                return 0;
+            return phases[to] - phases[from];
+        }
+
+        /**
+         * Method used to get the wall clock time of the RECEIVED phase.
+         * @return microseconds since the epoch.
+        **/
+        uint64_t get_start_time() const
+        {
+            return start_time;
+        }
+
+        /**
+         * Method used to get the id of the trace (32 hex digits).
+        **/
+        const std::string& get_trace_id() const
+        {
+            return trace_id;
+        }
+
+        /**
+         * Method used to get the id of the span of this request (16 hex
+         * digits).
+        **/
+        const std::string& get_span_id() const
+        {
+            return span_id;
+        }
+
+        /**
+         * Method used to get the id of the parent span, taken from the
+         * traceparent header.
+         * @return the id, or an empty string if the trace started here.
+        **/
+        const std::string& get_parent_id() const
+        {
+            return parent_id;
+        }
+
+        bool is_sampled() const
+        {
+            return (flags & 0x01) != 0;
+        }
+
+        /**
+         * Method used to get the traceparent header to send along with the
+         * calls made while serving the request, so that they are children
+         * of its span.
+        **/
+        std::string get_traceparent() const;
+
+        const std::string& get_method() const
+        {
+            return method;
+        }
+
+        const std::string& get_url() const
+        {
+            return url;
+        }
+
+        /**
+         * Method used to get the status code sent (0 if no response has
+         * been sent).
+        **/
+        int get_status() const
+        {
+            return status;
+        }
+
+    private:
+        uint64_t phases[PHASES];
+        uint64_t start_time;
+        std::string trace_id;
+        std::string span_id;
+        std::string parent_id;
+        unsigned int flags;
+        std::string method;
+        std::string url;
+        int status;
+
+        request_trace();
+
+        /**
+         * Method used to record the time a phase is reached; the first
+         * time counts.
+        **/
+        void mark(phase_T phase);
+
+        /**
+         * Method used to place the request in the trace named by a
+         * traceparent header, or in a new trace if the header is not
+         * valid.
+        **/
+        void continue_trace(const std::string& traceparent);
+
+        request_trace(const request_trace&);
+
+        request_trace& operator=(const request_trace&);
+
+        friend class webserver;
+        friend void* uri_log(void* cls, const char* uri);
+};
+
+};
+#endif //_REQUEST_TRACE_HPP_
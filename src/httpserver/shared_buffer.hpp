@@ -0,0 +1,122 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _SHARED_BUFFER_HPP_
+#define _SHARED_BUFFER_HPP_
+
+#include <string>
+#include <stddef.h>
+
+namespace httpserver
+{
+
+/**
+ * Immutable, reference counted block of bytes used as response content.
+ * Copying a shared_buffer never copies the bytes: all the copies point to
+ * the same block, that is released when the last copy is destroyed.
+ * This makes it possible to build a large payload once and hand it to any
+ * number of responses (or to the cache) without duplicating it.
+**/
+class shared_buffer
+{
+    public:
+        /**
+         * Builds an empty buffer.
+        **/
+        shared_buffer();
+
+        /**
+         * Builds a buffer holding a copy of the passed string.
+         * @param content The bytes to copy inside the buffer.
+        **/
+        explicit shared_buffer(const std::string& content);
+
+        /**
+         * Builds a buffer holding a copy of the passed bytes.
+         * @param content Pointer to the bytes to copy.
+         * @param size Number of bytes to copy.
+        **/
+        shared_buffer(const char* content, size_t size);
+
+#if __cplusplus >= 201103L
+        /**
+         * Builds a buffer stealing the storage of the passed string.
+         * @param content The string to move inside the buffer.
+        **/
+        explicit shared_buffer(std::string&& content);
+#endif
+
+        shared_buffer(const shared_buffer& b);
+
+        ~shared_buffer();
+
+        shared_buffer& operator=(const shared_buffer& b);
+
+        /**
+         * Builds a buffer swapping in the content of the passed string.
+         * No byte is copied; after the call content is empty.
+         * @param content The string whose storage is taken.
+         * @return a buffer owning the former content of the string.
+        **/
+        static shared_buffer take(std::string& content);
+
+        /**
+         * Builds a buffer mapping the content of a file in memory.
+         * Pages are loaded lazily by the kernel and shared with the page cache.
+         * Small files are read in memory instead. Truncating a mapped file
+         * is not supported: reading past its new end raises SIGBUS.
+         * On systems without mmap the file is read in memory.
+         * @param filename The path of the file to map.
+         * @return a buffer exposing the content of the file.
+        **/
+        static shared_buffer from_file(const std::string& filename);
+
+        const char* data() const;
+
+        size_t size() const;
+
+        bool empty() const
+        {
+            return size() == 0;
+        }
+
+        /**
+         * Method used to know how many shared_buffer objects point to the
+         * same block.
+         * @return the number of references to the block (0 if empty).
+        **/
+        int use_count() const;
+
+    private:
+        struct block;
+
+        explicit shared_buffer(block* b);
+
+        void release();
+
+        block* blk;
+};
+
+};
+#endif //_SHARED_BUFFER_HPP_
@@ -0,0 +1,100 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#if !defined (_HTTPSERVER_HPP_INSIDE_) && !defined (HTTPSERVER_COMPILATION)
+#error "Only <httpserver.hpp> or <httpserverpp> can be included directly."
+#endif
+
+#ifndef _TIMER_QUEUE_HPP_
+#define _TIMER_QUEUE_HPP_
+
+#include <queue>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+
+namespace httpserver
+{
+
+typedef void(*timer_callback_ptr)(void*);
+
+/**
+ * Runs callbacks after a delay on a single background thread, so that any
+ * number of pending timers costs no thread. Callbacks should be short:
+ * they delay the timers expiring after them.
+**/
+class timer_queue
+{
+    public:
+        timer_queue();
+
+        ~timer_queue();
+
+        /**
+         * Method used to run a callback after a delay.
+         * @param delay_ms Milliseconds to wait; 0 runs it as soon as possible.
+         * @param callback The function to call on the timer thread.
+         * @param arg The argument passed to the callback.
+        **/
+        void schedule(unsigned int delay_ms, timer_callback_ptr callback,
+                void* arg
+        );
+
+        /**
+         * Method used to get the queue shared by the whole process.
+         * It is never destroyed, so that it can be used up to exit.
+        **/
+        static timer_queue& shared();
+
+    private:
+        struct timer
+        {
+            struct timespec deadline;
+            unsigned long sequence;
+            timer_callback_ptr callback;
+            void* arg;
+
+            bool operator<(const timer& b) const
+            {
+                //std::priority_queue is a max-heap
+                if(deadline.tv_sec != b.deadline.tv_sec)
+                    return deadline.tv_sec > b.deadline.tv_sec;
+                if(deadline.tv_nsec != b.deadline.tv_nsec)
+                    return deadline.tv_nsec > b.deadline.tv_nsec;
+                return sequence > b.sequence;
+            }
+        };
+
+        std::priority_queue<timer> timers;
+        unsigned long next_sequence;
+        bool running;
+        bool started;
+        pthread_t thread;
+        pthread_mutex_t timers_lock;
+        pthread_cond_t timers_cond;
+
+        timer_queue(const timer_queue& b);
+        timer_queue& operator=(const timer_queue& b);
+
+        static void* run(void* self);
+};
+
+};
+#endif //_TIMER_QUEUE_HPP_
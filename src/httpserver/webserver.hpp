@@ -29,6 +29,8 @@
 #define METHOD_ERROR "Method not Allowed"
 #define NOT_METHOD_ERROR "Method not Acceptable"
 #define GENERIC_ERROR "Internal Error"
+#define SERVICE_UNAVAILABLE_ERROR "Service Unavailable"
+#define TOO_MANY_REQUESTS_ERROR "Too Many Requests"
 
 #include <cstring>
 #include <map>
@@ -44,12 +46,15 @@
 #include <stdexcept>
 
 #include "httpserver/create_webserver.hpp"
+#include "httpserver/executor.hpp"
 
 namespace httpserver {
 
 class http_resource;
 class http_response;
 class create_webserver;
+class executor;
+class async_completion;
 
 namespace http {
 struct ip_representation;
@@ -62,6 +67,17 @@ namespace details {
     struct modded_request;
     struct cache_entry;
     class comet_manager;
+    class admission_gate;
+    class rate_limiter;
+    class abuse_detector;
+    class ip_filter;
+    class metrics;
+    class log_sink;
+    class log_throttle;
+    class flight_recorder;
+    struct log_record;
+    class async_render_task;
+    template<typename T> class snapshot;
 }
 
 class webserver_exception : public std::runtime_error
@@ -73,6 +89,32 @@ public:
 	}
 };
 
+/**
+ * Outcome of webserver::drain.
+**/
+struct drain_report
+{
+    //requests in progress when the drain started
+    int in_flight;
+    //requests completed during the drain (including the ones received
+    //on already open connections after it started)
+    int completed;
+    //requests still in progress at the deadline, cut by the stop
+    int aborted;
+    //long polling connections closed
+    int comet_closed;
+    bool timed_out;
+
+    drain_report():
+        in_flight(0),
+        completed(0),
+        aborted(0),
+        comet_closed(0),
+        timed_out(false)
+    {
+    }
+};
+
 /**
  * Class representing the webserver. Main class of the apis.
 **/
@@ -96,6 +138,55 @@ class webserver
          * @return true if the webserver is stopped.
         **/
         bool stop();
+        /**
+         * Method used to stop the webserver gracefully. New connections
+         * are refused at once; the requests in progress are let complete
+         * and answered with "Connection: close"; long polling connections
+         * receive the final message (if any) and are closed. The server is
+         * then stopped, after at most timeout_ms milliseconds.
+         * @param timeout_ms deadline for the requests in progress
+         * @param comet_message last message sent to long polling clients
+         * @return the counts of the requests completed and aborted
+        **/
+        drain_report drain(int timeout_ms,
+                const std::string& comet_message = ""
+        );
+        /**
+         * Method used to pass the listen sockets to a successor process
+         * (e.g. a new version of the binary) without refusing connections.
+         * It waits for a server created with create_webserver::inherit_sockets
+         * on the same path, sends it the sockets over the Unix socket at
+         * path and, once the successor accepts on them, drains.
+         * @param path Unix socket path where the successor connects
+         * @param timeout_ms deadline for the successor to connect and
+         * acknowledge, and then for the drain
+         * @param report if not null, filled with the drain report
+         * @return true if the sockets have been handed off and the server
+         * is stopped; false if it is still serving.
+        **/
+        bool hand_off(const std::string& path, int timeout_ms,
+                drain_report* report = 0x0
+        );
+        /**
+         * Method used to get the file descriptor to watch when the server
+         * is started with the EXTERNAL_EPOLL start method. It is an epoll
+         * descriptor: register it for reading in the application event
+         * loop and call run_once when it becomes readable.
+         * @return the descriptor, or -1 if the server is not running in
+         * EXTERNAL_EPOLL mode.
+        **/
+        int get_epoll_fd() const;
+        /**
+         * Method used to drive a server started with the EXTERNAL_EPOLL
+         * start method: it waits at most timeout_ms milliseconds for
+         * network events (less if a connection times out earlier) and
+         * processes the ready connections in the calling thread.
+         * The server must be stopped from the same thread.
+         * @param timeout_ms maximum wait; 0 does not wait, -1 waits until
+         * an event arrives
+         * @return false if the server is not running in EXTERNAL_EPOLL mode
+        **/
+        bool run_once(int timeout_ms = 0);
         /**
          * Method used to evaluate if the server is running or not.
          * @return true if the webserver is running
@@ -113,11 +204,69 @@ class webserver
                 http_resource* res, bool family = false
         );
 
+        /**
+         * Method used to register a resource with a priority class.
+         * Under load, requests to higher classes are admitted first by the
+         * concurrency limits and, for asynchronous resources, rendered
+         * first by the executor; lower classes are slowed down but never
+         * starved. Health checks and control endpoints are usually
+         * registered as HIGH_PRIORITY, batch endpoints as LOW_PRIORITY.
+         * @param resource The url pointing to the resource.
+         * @param http_resource http_resource pointer to register.
+         * @param priority The priority class of the resource.
+         * @param family boolean indicating whether the resource is registered for the endpoint and its child or not.
+         * @return true if the resource was registered
+        **/
+        bool register_resource(const std::string& resource,
+                http_resource* res, priority_T priority, bool family = false
+        );
+
         void unregister_resource(const std::string& resource);
         void ban_ip(const std::string& ip);
         void allow_ip(const std::string& ip);
         void unban_ip(const std::string& ip);
         void disallow_ip(const std::string& ip);
+        /**
+         * Method used to replace the ban list (policy REJECT) or the
+         * allowance list (policy ACCEPT) with the rules in a file, one per
+         * line in the syntax of ban_ip; "#" starts a comment. The new list
+         * is built aside and swapped in at once while connections keep
+         * being accepted. Prefer it to many ban_ip calls on large lists:
+         * each of those copies the list.
+         * @param filename The file to read.
+         * @param policy The list to replace.
+         * @return the number of rules loaded.
+         * @throw file_access_exception if the file cannot be read and
+         * bad_ip_format_exception on a bad rule; the list is unchanged.
+        **/
+        size_t load_ip_list(const std::string& filename,
+                http::http_utils::policy_T policy
+        );
+        /**
+         * Method used to get the metrics served at
+         * create_webserver::metrics_path, in the Prometheus text format.
+         * Counters are summed over the threads at each call.
+         * @param result The string the metrics are appended to.
+         * @return false if the server keeps no metrics.
+        **/
+        bool get_metrics(std::string& result);
+        /**
+         * Method used to know how many log records (accesses and errors)
+         * have been dropped because the buffer of their thread was full (see
+         * create_webserver::access_log_buffer).
+        **/
+        unsigned long get_dropped_logs();
+        /**
+         * Method used to get the requests kept by the flight recorder (see
+         * create_webserver::slow_requests), the one completed first first.
+         * Each line has the wall clock time the request has been received
+         * at, the serving thread, method, url, route and status, the
+         * microseconds from its reception to each phase of request_trace
+         * ("-" for the phases not reached) and the sizes of the headers.
+         * @param result The string the requests are appended to.
+         * @return false if the server keeps no slow request.
+        **/
+        bool get_slow_requests(std::string& result);
 
         void send_message_to_topic(const std::string& topic,
                 const std::string& message
@@ -218,20 +367,65 @@ class webserver
         render_ptr method_not_allowed_resource;
         render_ptr method_not_acceptable_resource;
         render_ptr internal_error_resource;
+        const bool mmap_file_responses;
+        const int daemon_count;
+        const std::vector<int> cpu_affinity;
+        int next_cpu;
+        executor* async_executor;
+        bool own_async_executor;
+        //render tasks submitted and not deleted yet by the executor;
+        //guarded by mutexwait, like completions and stopping
+        int async_tasks;
+        //completions of the async requests in progress
+        std::set<async_completion*> completions;
+        //set by stop(): async renders and admission queues are refused
+        bool stopping;
+        bool suspend_resume;
+        int in_flight;
+        volatile bool draining;
+        int drained;
+        details::admission_gate* global_gate;
+        std::map<http_resource*, details::admission_gate*> resource_gates;
+        const int retry_after;
+        render_ptr service_unavailable_resource;
+        const std::string inherit_sockets;
+        const double rate_limit;
+        const double rate_limit_burst;
+        const size_t rate_limit_clients;
+        render_ptr too_many_requests_resource;
+        details::rate_limiter* client_limiter;
+        std::map<http_resource*, details::rate_limiter*> resource_limiters;
+        details::abuse_detector* abuse;
+        int epoll_fd;
+        details::metrics* request_metrics;
+        http_resource* metrics_endpoint;
+        std::map<http_resource*, int> metrics_routes;
+        const log_batch_ptr log_access_batch;
+        details::log_sink* logger;
+        details::log_throttle* error_throttle;
+        const trace_export_ptr trace_export;
+        details::flight_recorder* slow_requests;
+        http_resource* slow_requests_endpoint;
+        const int slow_requests_signal;
+        int slow_requests_pipe[2];
         std::map<details::http_endpoint, http_resource*> registered_resources;
         std::map<std::string, http_resource*> registered_resources_str;
 
         std::map<std::string, details::cache_entry*> response_cache;
         int next_to_choose;
         pthread_rwlock_t cache_guard;
-        std::set<http::ip_representation> bans;
-        std::set<http::ip_representation> allowances;
+        details::snapshot<details::ip_filter>* bans;
+        details::snapshot<details::ip_filter>* allowances;
 
         std::vector<details::daemon_item*> daemons;
         std::vector<pthread_t> threads;
 
         details::comet_manager* internal_comet_manager;
 
+        void pin_worker_thread();
+
+        void stop_accepting();
+
         static void* select(void* self);
         static void* cleaner(void* self);
 
@@ -242,6 +436,21 @@ class webserver
                 details::modded_request* mr, bool force_our = false
         );
         void not_found_page(http_response** dhrs, details::modded_request* mr);
+        void service_unavailable_page(http_response** dhrs,
+                details::modded_request* mr
+        );
+        int admit(MHD_Connection* connection, details::modded_request* mr,
+                http_resource* hrm
+        );
+        void too_many_requests_page(http_response** dhrs,
+                details::modded_request* mr, int wait
+        );
+        int throttle(MHD_Connection* connection, http_resource* hrm);
+        void log_access_record(MHD_Connection* connection,
+                details::modded_request* mr
+        );
+        void record_slow_request(details::modded_request* mr);
+        static void* dump_slow_requests(void* self);
 
         static int method_not_acceptable_page
         (
@@ -315,6 +524,14 @@ class webserver
                 struct details::modded_request* mr, const char* method
         );
 
+        int enqueue_answer(MHD_Connection* connection,
+                struct details::modded_request* mr, http_response* dhrs
+        );
+
+        int finalize_async_answer(MHD_Connection* connection,
+                struct details::modded_request* mr
+        );
+
         int complete_request(MHD_Connection* connection,
                 struct details::modded_request* mr,
                 const char* version, const char* method
@@ -324,13 +541,16 @@ class webserver
                 const struct sockaddr* addr, socklen_t addrlen
         );
         friend void error_log(void* cls, const char* fmt, va_list ap);
-        friend void access_log(webserver* cls, std::string uri);
+        friend void deliver_logs(void* cls, const details::log_record* records,
+                size_t count
+        );
         friend void* uri_log(void* cls, const char* uri);
         friend size_t unescaper_func(void * cls,
                 struct MHD_Connection *c, char *s
         );
         friend size_t internal_unescaper(void * cls, char *s);
         friend class http_response;
+        friend class details::async_render_task;
 };
 
 };
@@ -0,0 +1,139 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "request_trace.hpp"
+
+using namespace std;
+
+namespace httpserver
+{
+
+//xorshift64*: ids have to be unique, not unpredictable
+static __thread uint64_t id_state = 0;
+
+static uint64_t random_id()
+{
+    if(id_state == 0)
+    {
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        id_state = ((uint64_t) now.tv_sec << 32) ^ now.tv_nsec ^
+            ((uint64_t) (size_t) &id_state << 16) ^ (uint64_t) pthread_self();
+        if(id_state == 0)
+            id_state = 0x9E3779B97F4A7C15ULL;
+    }
+    id_state ^= id_state >> 12;
+    id_state ^= id_state << 25;
+    id_state ^= id_state >> 27;
+    return id_state * 0x2545F4914F6CDD1DULL;
+}
+
+static void append_hex(string& result, uint64_t value)
+{
+    static const char digits[] = "0123456789abcdef";
+    for(int shift = 60; shift >= 0; shift -= 4)
+        result += digits[(value >> shift) & 0x0F];
+}
+
+static bool hex(const string& s, size_t begin, size_t length)
+{
+    for(size_t i = begin; i < begin + length; i++)
+    {
+        if(!((s[i] >= '0' && s[i] <= '9') || (s[i] >= 'a' && s[i] <= 'f')))
+            return false;
+    }
+    return true;
+}
+
+//ids made only of zeros are invalid
+static bool valid_id(const string& s, size_t begin, size_t length)
+{
+    return hex(s, begin, length) &&
+        s.find_first_not_of('0', begin) < begin + length;
+}
+
+request_trace::request_trace():
+    start_time(0),
+    flags(0),
+    status(0)
+{
+    memset(phases, 0, sizeof(phases));
+}
+
+void request_trace::mark(phase_T phase)
+{
+    if(phases[phase] != 0)
+        return;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    phases[phase] = (uint64_t) now.tv_sec * 1000000 + now.tv_nsec / 1000;
+    if(phase == RECEIVED)
+    {
+        struct timeval wall;
+        gettimeofday(&wall, NULL);
+        start_time = (uint64_t) wall.tv_sec * 1000000 + wall.tv_usec;
+    }
+}
+
+void request_trace::continue_trace(const string& traceparent)
+{
+    //<version>-<trace id>-<parent id>-<flags>: version 00 has exactly
+    //these fields, later versions may only append others
+    bool valid = traceparent.size() >= 55 && hex(traceparent, 0, 2) &&
+        traceparent.compare(0, 2, "ff") != 0 &&
+        (traceparent.size() == 55 ||
+         (traceparent.compare(0, 2, "00") != 0 && traceparent[55] == '-')) &&
+        traceparent[2] == '-' && valid_id(traceparent, 3, 32) &&
+        traceparent[35] == '-' && valid_id(traceparent, 36, 16) &&
+        traceparent[52] == '-' && hex(traceparent, 53, 2);
+    if(valid)
+    {
+        trace_id = traceparent.substr(3, 32);
+        parent_id = traceparent.substr(36, 16);
+        flags = strtoul(traceparent.substr(53, 2).c_str(), 0x0, 16);
+    }
+    else
+    {
+        trace_id.clear();
+        append_hex(trace_id, random_id());
+        append_hex(trace_id, random_id());
+        parent_id.clear();
+        flags = 0x01;
+    }
+    span_id.clear();
+    append_hex(span_id, random_id());
+}
+
+string request_trace::get_traceparent() const
+{
+    static const char digits[] = "0123456789abcdef";
+    string result = "00-" + trace_id + "-" + span_id + "-";
+    result += digits[(flags >> 4) & 0x0F];
+    result += digits[flags & 0x0F];
+    return result;
+}
+
+};
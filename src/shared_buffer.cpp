@@ -0,0 +1,239 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include <errno.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#if defined(__MINGW32__) || defined(__CYGWIN32__)
+#define _WINDOWS
+#else
+#include <sys/mman.h>
+#endif
+
+#include "http_utils.hpp"
+#include "shared_buffer.hpp"
+#include "details/atomics.hpp"
+
+using namespace std;
+
+//files up to this size are read instead of mapped: the copy is cheap and
+//a truncation of the file cannot affect them
+#define MAPPED_FILE_MIN_SIZE 65536
+
+namespace httpserver
+{
+
+struct shared_buffer::block
+{
+    int num_references;
+    std::string content;
+    void* mapped;
+    size_t mapped_size;
+
+    block():
+        num_references(1),
+        mapped(0x0),
+        mapped_size(0)
+    {
+    }
+
+    ~block()
+    {
+#ifndef _WINDOWS
+        if(mapped != 0x0)
+            munmap(mapped, mapped_size);
+#endif
+    }
+
+    const char* data() const
+    {
+        if(mapped != 0x0)
+            return static_cast<const char*>(mapped);
+        return content.data();
+    }
+
+    size_t size() const
+    {
+        if(mapped != 0x0)
+            return mapped_size;
+        return content.size();
+    }
+};
+
+shared_buffer::shared_buffer():
+    blk(0x0)
+{
+}
+
+shared_buffer::shared_buffer(block* b):
+    blk(b)
+{
+}
+
+shared_buffer::shared_buffer(const std::string& content):
+    blk(new block())
+{
+    blk->content = content;
+}
+
+shared_buffer::shared_buffer(const char* content, size_t size):
+    blk(new block())
+{
+    blk->content.assign(content, size);
+}
+
+#if __cplusplus >= 201103L
+shared_buffer::shared_buffer(std::string&& content):
+    blk(new block())
+{
+    blk->content.swap(content);
+}
+#endif
+
+shared_buffer::shared_buffer(const shared_buffer& b):
+    blk(b.blk)
+{
+    if(blk != 0x0)
+        atomic_increment(&blk->num_references);
+}
+
+shared_buffer::~shared_buffer()
+{
+    release();
+}
+
+shared_buffer& shared_buffer::operator=(const shared_buffer& b)
+{
+    if(b.blk != 0x0)
+        atomic_increment(&b.blk->num_references);
+    release();
+    blk = b.blk;
+    return *this;
+}
+
+void shared_buffer::release()
+{
+    if(blk != 0x0 && atomic_decrement(&blk->num_references) == 0)
+        delete blk;
+    blk = 0x0;
+}
+
+shared_buffer shared_buffer::take(std::string& content)
+{
+    block* b = new block();
+    b->content.swap(content);
+    return shared_buffer(b);
+}
+
+shared_buffer shared_buffer::from_file(const std::string& filename)
+{
+#ifndef _WINDOWS
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd == -1)
+        throw http::file_access_exception();
+
+    struct stat st;
+    if(fstat(fd, &st) == -1)
+    {
+        close(fd);
+        throw http::file_access_exception();
+    }
+    if(st.st_size == 0)
+    {
+        close(fd);
+        return shared_buffer();
+    }
+
+    if(st.st_size <= MAPPED_FILE_MIN_SIZE)
+    {
+        block* b = new block();
+        b->content.resize(st.st_size);
+        size_t done = 0;
+        while(done < b->content.size())
+        {
+            ssize_t r = read(fd, &b->content[done], b->content.size() - done);
+            if(r == -1 && errno == EINTR)
+                continue;
+            if(r <= 0)
+                break;
+            done += r;
+        }
+        close(fd);
+        if(done != b->content.size())
+        {
+            delete b;
+            throw http::file_access_exception();
+        }
+        return shared_buffer(b);
+    }
+
+    void* mapped = mmap(0x0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    //a file shrunk meanwhile would fault past its end
+    struct stat mapped_st;
+    bool shrunk = fstat(fd, &mapped_st) == -1 || mapped_st.st_size < st.st_size;
+    close(fd);
+    if(mapped == MAP_FAILED)
+        throw http::file_access_exception();
+    if(shrunk)
+    {
+        munmap(mapped, st.st_size);
+        throw http::file_access_exception();
+    }
+
+    block* b = new block();
+    b->mapped = mapped;
+    b->mapped_size = st.st_size;
+    return shared_buffer(b);
+#else
+    char* content = 0x0;
+    size_t size = http::load_file(filename.c_str(), &content);
+    block* b = new block();
+    b->content.assign(content, size);
+    free(content);
+    return shared_buffer(b);
+#endif
+}
+
+const char* shared_buffer::data() const
+{
+    if(blk == 0x0)
+        return "";
+    return blk->data();
+}
+
+size_t shared_buffer::size() const
+{
+    if(blk == 0x0)
+        return 0;
+    return blk->size();
+}
+
+int shared_buffer::use_count() const
+{
+    if(blk == 0x0)
+        return 0;
+    return blk->num_references;
+}
+
+};
@@ -0,0 +1,130 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "timer_queue.hpp"
+
+namespace httpserver
+{
+
+timer_queue::timer_queue():
+    next_sequence(0),
+    running(true),
+    started(false)
+{
+    pthread_mutex_init(&timers_lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+#ifdef CLOCK_MONOTONIC
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif
+    pthread_cond_init(&timers_cond, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+timer_queue::~timer_queue()
+{
+    pthread_mutex_lock(&timers_lock);
+    running = false;
+    pthread_cond_signal(&timers_cond);
+    pthread_mutex_unlock(&timers_lock);
+    if(started)
+        pthread_join(thread, NULL);
+    pthread_mutex_destroy(&timers_lock);
+    pthread_cond_destroy(&timers_cond);
+}
+
+timer_queue& timer_queue::shared()
+{
+    static timer_queue* queue = new timer_queue();
+    return *queue;
+}
+
+static void now(struct timespec* ts)
+{
+#ifdef CLOCK_MONOTONIC
+    clock_gettime(CLOCK_MONOTONIC, ts);
+#else
+    clock_gettime(CLOCK_REALTIME, ts);
+#endif
+}
+
+void timer_queue::schedule(
+        unsigned int delay_ms,
+        timer_callback_ptr callback,
+        void* arg
+)
+{
+    timer t;
+    now(&t.deadline);
+    t.deadline.tv_sec += delay_ms / 1000;
+    t.deadline.tv_nsec += (delay_ms % 1000) * 1000000L;
+    if(t.deadline.tv_nsec >= 1000000000L)
+    {
+        t.deadline.tv_sec++;
+        t.deadline.tv_nsec -= 1000000000L;
+    }
+    t.callback = callback;
+    t.arg = arg;
+
+    pthread_mutex_lock(&timers_lock);
+    t.sequence = next_sequence++;
+    timers.push(t);
+    if(!started)
+    {
+        started = pthread_create(&thread, NULL, &timer_queue::run, this) == 0;
+    }
+    pthread_cond_signal(&timers_cond);
+    pthread_mutex_unlock(&timers_lock);
+}
+
+void* timer_queue::run(void* self)
+{
+    timer_queue* queue = static_cast<timer_queue*>(self);
+    pthread_mutex_lock(&queue->timers_lock);
+    while(queue->running)
+    {
+        if(queue->timers.empty())
+        {
+            pthread_cond_wait(&queue->timers_cond, &queue->timers_lock);
+            continue;
+        }
+
+        timer t = queue->timers.top();
+        struct timespec ts;
+        now(&ts);
+        if(ts.tv_sec < t.deadline.tv_sec ||
+            (ts.tv_sec == t.deadline.tv_sec && ts.tv_nsec < t.deadline.tv_nsec))
+        {
+            pthread_cond_timedwait(&queue->timers_cond, &queue->timers_lock,
+                    &t.deadline
+            );
+            continue;
+        }
+
+        queue->timers.pop();
+        pthread_mutex_unlock(&queue->timers_lock);
+        t.callback(t.arg);
+        pthread_mutex_lock(&queue->timers_lock);
+    }
+    pthread_mutex_unlock(&queue->timers_lock);
+    return 0x0;
+}
+
+};
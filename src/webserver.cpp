@@ -21,23 +21,32 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <iostream>
+#include <fstream>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <time.h>
 
 #if defined(__MINGW32__) || defined(__CYGWIN32__)
 #include <winsock2.h>
 #define _WINDOWS
 #else
 #include <netinet/ip.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
 #endif
 
 #include <signal.h>
 #include <fcntl.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/epoll.h>
+#endif
 #include <algorithm>
 
 #include <microhttpd.h>
@@ -47,6 +56,7 @@
 #include "http_resource.hpp"
 #include "http_response.hpp"
 #include "http_request.hpp"
+#include "request_trace.hpp"
 #include "http_response_builder.hpp"
 #include "details/http_endpoint.hpp"
 #include "string_utilities.hpp"
@@ -55,6 +65,18 @@
 #include "webserver.hpp"
 #include "details/modded_request.hpp"
 #include "details/cache_entry.hpp"
+#include "details/atomics.hpp"
+#include "executor.hpp"
+#include "async_completion.hpp"
+#include "details/admission_gate.hpp"
+#include "details/rate_limiter.hpp"
+#include "details/abuse_detector.hpp"
+#include "details/socket_handoff.hpp"
+#include "details/ip_filter.hpp"
+#include "details/snapshot.hpp"
+#include "details/metrics.hpp"
+#include "details/log_sink.hpp"
+#include "details/flight_recorder.hpp"
 
 #define _REENTRANT 1
 
@@ -85,6 +107,94 @@ struct daemon_item
     }
 };
 
+class async_render_task: public executor_task
+{
+    public:
+        //counted in ws->async_tasks by the caller, under ws->mutexwait
+        async_render_task(async_completion* completion, webserver* ws):
+            completion(completion),
+            ws(ws)
+        {
+            completion->retain();
+        }
+
+        //the executor deletes the task once run (or dropped)
+        ~async_render_task()
+        {
+            completion->release();
+            pthread_mutex_lock(&ws->mutexwait);
+            if(--ws->async_tasks == 0)
+                pthread_cond_broadcast(&ws->mutexcond);
+            pthread_mutex_unlock(&ws->mutexwait);
+        }
+
+        void run()
+        {
+            try
+            {
+                completion->resource->render_async(
+                        *completion->request,
+                        *completion
+                );
+            }
+            catch(...)
+            {
+                //the webserver sends the internal error page
+                completion->complete(0x0);
+            }
+        }
+
+    private:
+        async_completion* completion;
+        webserver* ws;
+};
+
+class metrics_resource: public http_resource
+{
+    public:
+        explicit metrics_resource(webserver* ws):
+            ws(ws)
+        {
+            disallow_all();
+            set_allowing(http::http_utils::http_method_get, true);
+        }
+
+        void render_GET(const http_request&, http_response** res)
+        {
+            string text;
+            ws->get_metrics(text);
+            *res = new http_response(http_response_builder(text, 200,
+                        "text/plain; version=0.0.4").string_response()
+            );
+        }
+
+    private:
+        webserver* ws;
+};
+
+class slow_requests_resource: public http_resource
+{
+    public:
+        explicit slow_requests_resource(webserver* ws):
+            ws(ws)
+        {
+            disallow_all();
+            set_allowing(http::http_utils::http_method_get, true);
+        }
+
+        void render_GET(const http_request&, http_response** res)
+        {
+            string text;
+            ws->get_slow_requests(text);
+            *res = new http_response(http_response_builder(text, 200,
+                        "text/plain").string_response()
+            );
+        }
+
+    private:
+        webserver* ws;
+};
+
 }
 
 using namespace http;
@@ -92,7 +202,7 @@ using namespace http;
 int policy_callback (void *, const struct sockaddr*, socklen_t);
 void error_log(void*, const char*, va_list);
 void* uri_log(void*, const char*);
-void access_log(webserver*, string);
+void deliver_logs(void*, const details::log_record*, size_t);
 size_t unescaper_func(void*, struct MHD_Connection*, char*);
 size_t internal_unescaper(void*, char*);
 
@@ -110,6 +220,86 @@ struct compare_value
 static void catcher (int sig)
 {
 }
+
+//servers dumping their slow requests on a signal: the handler only
+//wakes the dumper thread of each server registered for the signal it got,
+//writing in the pipe of the server
+#define SLOW_REQUESTS_LISTENERS 16
+
+struct slow_requests_listener
+{
+    volatile int signal;
+    volatile int fd;
+};
+
+static slow_requests_listener slow_requests_listeners[SLOW_REQUESTS_LISTENERS];
+static pthread_mutex_t slow_requests_guard = PTHREAD_MUTEX_INITIALIZER;
+//the handler installed before the first server registered for a signal,
+//restored when the last one leaves
+static struct sigaction slow_requests_previous[NSIG];
+static int slow_requests_registered[NSIG];
+
+static void slow_requests_catcher (int sig)
+{
+    int saved = errno;
+    char command = 'd';
+    for(int i = 0; i < SLOW_REQUESTS_LISTENERS; i++)
+    {
+        if(slow_requests_listeners[i].signal != sig)
+            continue;
+        //the pipe does not block: when full, a dump is pending anyway
+        ssize_t written = write(slow_requests_listeners[i].fd, &command, 1);
+        (void) written;
+    }
+    errno = saved;
+}
+
+static bool register_slow_requests_listener(int sig, int fd)
+{
+    if(sig <= 0 || sig >= NSIG)
+        return false;
+    pthread_mutex_lock(&slow_requests_guard);
+    int slot = -1;
+    for(int i = 0; i < SLOW_REQUESTS_LISTENERS && slot == -1; i++)
+    {
+        if(slow_requests_listeners[i].signal == 0)
+            slot = i;
+    }
+    if(slot != -1)
+    {
+        slow_requests_listeners[slot].fd = fd;
+        __sync_synchronize();
+        slow_requests_listeners[slot].signal = sig;
+        if(slow_requests_registered[sig]++ == 0)
+        {
+            struct sigaction action;
+            action.sa_handler = &slow_requests_catcher;
+            sigemptyset(&action.sa_mask);
+            action.sa_flags = SA_RESTART;
+            sigaction(sig, &action, &slow_requests_previous[sig]);
+        }
+    }
+    pthread_mutex_unlock(&slow_requests_guard);
+    return slot != -1;
+}
+
+static void unregister_slow_requests_listener(int sig, int fd)
+{
+    pthread_mutex_lock(&slow_requests_guard);
+    for(int i = 0; i < SLOW_REQUESTS_LISTENERS; i++)
+    {
+        if(slow_requests_listeners[i].signal != sig ||
+                slow_requests_listeners[i].fd != fd)
+            continue;
+        slow_requests_listeners[i].signal = 0;
+        __sync_synchronize();
+        slow_requests_listeners[i].fd = -1;
+        if(--slow_requests_registered[sig] == 0)
+            sigaction(sig, &slow_requests_previous[sig], 0x0);
+        break;
+    }
+    pthread_mutex_unlock(&slow_requests_guard);
+}
 #endif
 
 static void ignore_sigpipe ()
@@ -175,9 +365,47 @@ webserver::webserver(const create_webserver& params):
     method_not_allowed_resource(params._method_not_allowed_resource),
     method_not_acceptable_resource(params._method_not_acceptable_resource),
     internal_error_resource(params._internal_error_resource),
+    mmap_file_responses(params._mmap_file_responses),
+    daemon_count(params._daemon_count),
+    cpu_affinity(params._cpu_affinity),
+    next_cpu(0),
+    async_executor(params._async_executor),
+    own_async_executor(false),
+    async_tasks(0),
+    stopping(false),
+    suspend_resume(params._suspend_resume),
+    in_flight(0),
+    draining(false),
+    drained(0),
+    global_gate(0x0),
+    retry_after(params._retry_after),
+    service_unavailable_resource(params._service_unavailable_resource),
+    inherit_sockets(params._inherit_sockets),
+    rate_limit(params._rate_limit),
+    rate_limit_burst(params._rate_limit_burst),
+    rate_limit_clients(params._rate_limit_clients),
+    too_many_requests_resource(params._too_many_requests_resource),
+    client_limiter(0x0),
+    abuse(0x0),
+    epoll_fd(-1),
+    request_metrics(0x0),
+    metrics_endpoint(0x0),
+    log_access_batch(params._log_access_batch),
+    logger(0x0),
+    error_throttle(0x0),
+    trace_export(params._trace_export),
+    slow_requests(0x0),
+    slow_requests_endpoint(0x0),
+    slow_requests_signal(params._slow_requests_signal),
     next_to_choose(0),
+    bans(new details::snapshot<details::ip_filter>(new details::ip_filter())),
+    allowances(new details::snapshot<details::ip_filter>(
+                new details::ip_filter())
+    ),
     internal_comet_manager(new details::comet_manager())
 {
+    slow_requests_pipe[0] = -1;
+    slow_requests_pipe[1] = -1;
     if(single_resource != 0x0)
         this->single_resource = true;
     else
@@ -187,6 +415,64 @@ webserver::webserver(const create_webserver& params):
     pthread_rwlock_init(&runguard, NULL);
     pthread_cond_init(&mutexcond, NULL);
     pthread_rwlock_init(&cache_guard, NULL);
+    if(async_executor == 0x0 && params._async_threads > 0)
+    {
+        if(params._async_work_stealing)
+            async_executor = new work_stealing_executor(params._async_threads);
+        else
+            async_executor = new thread_pool_executor(params._async_threads);
+        own_async_executor = true;
+    }
+    if(comet_enabled || async_executor != 0x0)
+        suspend_resume = true;
+    if(rate_limit > 0)
+    {
+        client_limiter = new details::rate_limiter(rate_limit,
+                rate_limit_burst > 0 ? rate_limit_burst : rate_limit,
+                rate_limit_clients
+        );
+    }
+    if(params._auto_ban_threshold > 0)
+    {
+        abuse = new details::abuse_detector(params._auto_ban_threshold,
+                params._auto_ban_window, params._auto_ban_duration,
+                rate_limit_clients
+        );
+    }
+    if(params._max_in_flight > 0)
+    {
+        global_gate = new details::admission_gate(params._max_in_flight,
+                params._max_queued, params._adaptive_concurrency
+        );
+    }
+    if(!params._metrics_path.empty())
+    {
+        request_metrics = new details::metrics();
+        metrics_endpoint = new details::metrics_resource(this);
+        register_resource(params._metrics_path, metrics_endpoint);
+    }
+    if(log_access != 0x0 || log_access_batch != 0x0 || log_error != 0x0)
+    {
+        logger = new details::log_sink(params._access_log_buffer,
+                &deliver_logs, this
+        );
+    }
+    if(log_error != 0x0)
+        error_throttle = new details::log_throttle(params._error_log_rate);
+    if(params._slow_request_threshold > 0)
+    {
+        slow_requests = new details::flight_recorder(
+                (uint64_t) params._slow_request_threshold * 1000,
+                params._slow_requests_count
+        );
+        if(!params._slow_requests_path.empty())
+        {
+            slow_requests_endpoint = new details::slow_requests_resource(this);
+            register_resource(params._slow_requests_path,
+                    slow_requests_endpoint
+            );
+        }
+    }
 }
 
 webserver::~webserver()
@@ -197,6 +483,25 @@ webserver::~webserver()
     pthread_rwlock_destroy(&cache_guard);
     pthread_cond_destroy(&mutexcond);
     delete internal_comet_manager;
+    delete bans;
+    delete allowances;
+    if(own_async_executor)
+        delete async_executor;
+    delete global_gate;
+    for(map<http_resource*, details::admission_gate*>::iterator it =
+            resource_gates.begin(); it != resource_gates.end(); ++it)
+        delete it->second;
+    delete client_limiter;
+    delete abuse;
+    for(map<http_resource*, details::rate_limiter*>::iterator it =
+            resource_limiters.begin(); it != resource_limiters.end(); ++it)
+        delete it->second;
+    delete metrics_endpoint;
+    delete request_metrics;
+    delete logger;
+    delete error_throttle;
+    delete slow_requests_endpoint;
+    delete slow_requests;
 }
 
 void webserver::sweet_kill()
@@ -214,7 +519,53 @@ void webserver::request_completed (
     details::modded_request* mr = static_cast<details::modded_request*>(*con_cls);
     if (mr == 0x0) return;
 
-    if (mr->ws != 0x0) mr->ws->internal_comet_manager->complete_request(mr->dhrs->connection_id);
+    if (mr->async != 0x0)
+    {
+        webserver* ws = static_cast<webserver*>(cls);
+        pthread_mutex_lock(&ws->mutexwait);
+        ws->completions.erase(mr->async);
+        pthread_mutex_unlock(&ws->mutexwait);
+    }
+
+    if (mr->ws != 0x0 && mr->dhrs.ptr() != 0x0)
+        mr->ws->internal_comet_manager->complete_request(mr->dhrs->connection_id);
+
+    //the request has been counted in flight by its first call to
+    //answer_to_connection, that sets standardized_url
+    webserver* ws = static_cast<webserver*>(cls);
+    if (mr->standardized_url != 0x0)
+    {
+        if (ws->request_metrics != 0x0 && mr->dhrs.ptr() != 0x0)
+        {
+            ws->request_metrics->record_request(mr->route_id, mr->method_id,
+                    mr->dhrs->get_response_code(),
+                    details::metrics::now() - mr->started
+            );
+        }
+        if (ws->log_access != 0x0 || ws->log_access_batch != 0x0)
+            ws->log_access_record(connection, mr);
+        if (ws->draining)
+            atomic_increment(&ws->drained);
+        if (atomic_decrement(&ws->in_flight) == 0 && ws->draining)
+        {
+            pthread_mutex_lock(&ws->mutexwait);
+            pthread_cond_broadcast(&ws->mutexcond);
+            pthread_mutex_unlock(&ws->mutexwait);
+        }
+    }
+
+    if (mr->trace != 0x0)
+    {
+        mr->trace->mark(request_trace::COMPLETED);
+        if (mr->dhrs.ptr() != 0x0)
+            mr->trace->status = mr->dhrs->get_response_code();
+        if (ws->slow_requests != 0x0 && ws->slow_requests->is_slow(
+                    mr->trace->get_duration(request_trace::RECEIVED,
+                        request_trace::COMPLETED)))
+            ws->record_slow_request(mr);
+        if (ws->trace_export != 0x0)
+            ws->trace_export(*mr->trace);
+    }
 
     delete mr;
     mr = 0x0;
@@ -233,11 +584,41 @@ bool webserver::register_resource(const std::string& resource, http_resource* hr
         registered_resources_str.insert(
             pair<string, http_resource*>(idx.get_url_complete(), result.first->second)
         );
+        if(hrm->max_in_flight > 0 && !resource_gates.count(hrm))
+        {
+            resource_gates[hrm] = new details::admission_gate(
+                    hrm->max_in_flight, hrm->max_queued, hrm->adaptive_limit
+            );
+        }
+        if(hrm->rate_limit > 0 && !resource_limiters.count(hrm))
+        {
+            resource_limiters[hrm] = new details::rate_limiter(
+                    hrm->rate_limit,
+                    hrm->rate_limit_burst > 0 ? hrm->rate_limit_burst :
+                        hrm->rate_limit,
+                    rate_limit_clients
+            );
+        }
+        if(request_metrics != 0x0 && !metrics_routes.count(hrm))
+            metrics_routes[hrm] = request_metrics->route_id(idx.get_url_complete());
     }
 
     return result.second;
 }
 
+bool webserver::register_resource(
+        const std::string& resource,
+        http_resource* hrm,
+        priority_T priority,
+        bool family
+)
+{
+    if(!register_resource(resource, hrm, family))
+        return false;
+    hrm->priority = priority;
+    return true;
+}
+
 MHD_socket create_socket (int domain, int type, int protocol)
 {
     int sock_cloexec = SOCK_CLOEXEC;
@@ -260,6 +641,62 @@ MHD_socket create_socket (int domain, int type, int protocol)
     return fd;
 }
 
+MHD_socket create_reuseport_socket(
+        const struct sockaddr* bind_address,
+        uint16_t port,
+        bool use_ipv6
+)
+{
+#if defined(SO_REUSEPORT) && !defined(_WINDOWS)
+    struct sockaddr_in addr4;
+    struct sockaddr_in6 addr6;
+    const struct sockaddr* addr;
+    socklen_t addr_len;
+
+    if(bind_address != 0x0)
+    {
+        addr = bind_address;
+        addr_len = bind_address->sa_family == AF_INET6 ?
+            sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+    }
+    else if(use_ipv6)
+    {
+        memset(&addr6, 0, sizeof(addr6));
+        addr6.sin6_family = AF_INET6;
+        addr6.sin6_port = htons(port);
+        addr6.sin6_addr = in6addr_any;
+        addr = (const struct sockaddr*) &addr6;
+        addr_len = sizeof(addr6);
+    }
+    else
+    {
+        memset(&addr4, 0, sizeof(addr4));
+        addr4.sin_family = AF_INET;
+        addr4.sin_port = htons(port);
+        addr4.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr = (const struct sockaddr*) &addr4;
+        addr_len = sizeof(addr4);
+    }
+
+    MHD_socket fd = create_socket(addr->sa_family, SOCK_STREAM, 0);
+    if(fd == -1)
+        return -1;
+
+    int on = 1;
+    if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) != 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0 ||
+        bind(fd, addr, addr_len) != 0 ||
+        listen(fd, SOMAXCONN) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
 bool webserver::start(bool blocking)
 {
 
@@ -278,7 +715,7 @@ bool webserver::start(bool blocking)
 
     iov.push_back(gen(MHD_OPTION_NOTIFY_COMPLETED,
                 (intptr_t) &request_completed,
-                NULL
+                this
     ));
     iov.push_back(gen(MHD_OPTION_URI_LOG_CALLBACK, (intptr_t) &uri_log, this));
     iov.push_back(gen(MHD_OPTION_EXTERNAL_LOGGER, (intptr_t) &error_log, this));
@@ -296,6 +733,26 @@ bool webserver::start(bool blocking)
         cout << "Cannot specify maximum number of threads when using a thread per connection" << endl;
         throw ::httpserver::webserver_exception();
     }
+    if(daemon_count > 1 && bind_socket != 0)
+    {
+        cout << "Cannot start more daemons on a single bind socket" << endl;
+        throw ::httpserver::webserver_exception();
+    }
+    if(inherit_sockets != "" && bind_socket != 0)
+    {
+        cout << "Cannot inherit sockets and use a bind socket" << endl;
+        throw ::httpserver::webserver_exception();
+    }
+    if(start_method == http_utils::EXTERNAL_EPOLL && max_threads != 0)
+    {
+        cout << "Cannot specify maximum number of threads when using an external event loop" << endl;
+        throw ::httpserver::webserver_exception();
+    }
+    if(start_method == http_utils::EXTERNAL_EPOLL && blocking)
+    {
+        cout << "Cannot block when using an external event loop" << endl;
+        throw ::httpserver::webserver_exception();
+    }
 
     if(max_threads != 0)
         iov.push_back(gen(MHD_OPTION_THREAD_POOL_SIZE, max_threads));
@@ -341,8 +798,6 @@ bool webserver::start(bool blocking)
         iov.push_back(gen(MHD_OPTION_HTTPS_CRED_TYPE, cred_type));
 #endif //HAVE_GNUTLS
 
-    iov.push_back(gen(MHD_OPTION_END, 0, NULL ));
-
     int start_conf = start_method;
     if(use_ssl)
         start_conf |= MHD_USE_SSL;
@@ -352,29 +807,174 @@ bool webserver::start(bool blocking)
         start_conf |= MHD_USE_DEBUG;
     if(pedantic)
         start_conf |= MHD_USE_PEDANTIC_CHECKS;
-    if(comet_enabled)
+    if(suspend_resume)
         start_conf |= MHD_USE_SUSPEND_RESUME;
+    //needed by MHD_quiesce_daemon (see drain); some MHD versions do not
+    //support it with a thread per connection.
+    if(start_method != http_utils::THREAD_PER_CONNECTION)
+        start_conf |= MHD_USE_PIPE_FOR_SHUTDOWN;
 
 #ifdef USE_FASTOPEN
     start_conf |= MHD_USE_TCP_FASTOPEN;
 #endif
 
+    vector<int> inherited;
+    int handoff_channel = -1;
+    if(inherit_sockets != "")
+    {
+        handoff_channel = details::handoff_connect(inherit_sockets,
+                HANDOFF_CONNECT_TIMEOUT
+        );
+        if(handoff_channel == -1)
+        {
+            cout << gettext("Unable to inherit the listen sockets from: ") <<
+                inherit_sockets << endl;
+            throw ::httpserver::webserver_exception();
+        }
+        if(!details::handoff_receive_sockets(handoff_channel, inherited,
+                    HANDOFF_RECEIVE_TIMEOUT))
+        {
+            //the running process keeps its sockets without our ack
+            cout << gettext("No listen sockets received, binding them: ") <<
+                inherit_sockets << endl;
+            close(handoff_channel);
+            handoff_channel = -1;
+        }
+    }
+    int daemons_to_start = inherited.empty() ? daemon_count : inherited.size();
+
     this->running = true;
+    this->draining = false;
+    this->stopping = false;
+    internal_comet_manager->closing = false;
+    if(global_gate != 0x0)
+        global_gate->reopen();
+    for(map<http_resource*, details::admission_gate*>::iterator it =
+            resource_gates.begin(); it != resource_gates.end(); ++it)
+        it->second->reopen();
+
+    if(own_async_executor)
+        async_executor->start();
+
+    for(int i = 0; i < daemons_to_start; i++)
+    {
+        vector<struct MHD_OptionItem> daemon_iov(iov);
+        if(!inherited.empty())
+        {
+            daemon_iov.push_back(gen(MHD_OPTION_LISTEN_SOCKET, inherited[i]));
+        }
+        else if(daemon_count > 1)
+        {
+            MHD_socket listen_socket =
+                create_reuseport_socket(bind_address, port, use_ipv6);
+            if(listen_socket == -1)
+            {
+                cout << gettext("Unable to create listen socket on port: ") <<
+                    this->port << endl;
+                stop();
+                throw ::httpserver::webserver_exception();
+            }
+            daemon_iov.push_back(gen(MHD_OPTION_LISTEN_SOCKET, listen_socket));
+        }
+        daemon_iov.push_back(gen(MHD_OPTION_END, 0, NULL ));
 
-    struct MHD_Daemon* daemon = MHD_start_daemon
-    (
-            start_conf, this->port, &policy_callback, this,
-            &answer_to_connection, this, MHD_OPTION_ARRAY,
-            &iov[0], MHD_OPTION_END
-    );
-    if(NULL == daemon)
+        struct MHD_Daemon* daemon = MHD_start_daemon
+        (
+                start_conf, this->port, &policy_callback, this,
+                &answer_to_connection, this, MHD_OPTION_ARRAY,
+                &daemon_iov[0], MHD_OPTION_END
+        );
+        if(NULL == daemon)
+        {
+            cout << gettext("Unable to connect daemon to port: ") <<
+                this->port << endl;
+            if(!inherited.empty())
+            {
+                //no acknowledgement: the previous process keeps serving
+                for(unsigned int j = i; j < inherited.size(); j++)
+                    close(inherited[j]);
+                close(handoff_channel);
+            }
+            else if(daemon_count > 1)
+                close(daemon_iov[daemon_iov.size() - 2].value);
+            stop();
+            throw ::httpserver::webserver_exception();
+        }
+        details::daemon_item* di = new details::daemon_item(this, daemon);
+        daemons.push_back(di);
+    }
+
+#ifdef __linux__
+    if(start_method == http_utils::EXTERNAL_EPOLL)
     {
-        cout << gettext("Unable to connect daemon to port: ") <<
-            this->port << endl;
-        throw ::httpserver::webserver_exception();
+        //a single daemon is watched through its own epoll descriptor;
+        //more daemons are gathered under one
+        if(daemons.size() == 1)
+        {
+            const union MHD_DaemonInfo* info = MHD_get_daemon_info(
+                    daemons[0]->daemon, MHD_DAEMON_INFO_EPOLL_FD_LINUX_ONLY
+            );
+            epoll_fd = info != 0x0 ? info->epoll_fd : -1;
+        }
+        else
+        {
+            epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+            for(unsigned int i = 0; i < daemons.size() && epoll_fd != -1; i++)
+            {
+                const union MHD_DaemonInfo* info = MHD_get_daemon_info(
+                        daemons[i]->daemon, MHD_DAEMON_INFO_EPOLL_FD_LINUX_ONLY
+                );
+                struct epoll_event event;
+                event.events = EPOLLIN;
+                event.data.ptr = daemons[i];
+                if(info == 0x0 ||
+                        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, info->epoll_fd, &event) == -1)
+                {
+                    close(epoll_fd);
+                    epoll_fd = -1;
+                }
+            }
+        }
+        if(epoll_fd == -1)
+        {
+            cout << gettext("Unable to get the epoll descriptor of the daemons") << endl;
+            if(handoff_channel != -1)
+                close(handoff_channel);
+            stop();
+            throw ::httpserver::webserver_exception();
+        }
+    }
+#endif
+
+#ifndef __MINGW32__
+    if(slow_requests != 0x0 && slow_requests_signal > 0 &&
+            pipe(slow_requests_pipe) == 0)
+    {
+        fcntl(slow_requests_pipe[1], F_SETFL, O_NONBLOCK);
+        pthread_t dumper;
+        if(pthread_create(&dumper, NULL, &webserver::dump_slow_requests, this) == 0)
+        {
+            threads.push_back(dumper);
+            if(!register_slow_requests_listener(slow_requests_signal,
+                        slow_requests_pipe[1]))
+                cout << gettext("Unable to dump the slow requests on the signal") << endl;
+        }
+        else
+        {
+            close(slow_requests_pipe[0]);
+            close(slow_requests_pipe[1]);
+            slow_requests_pipe[0] = -1;
+            slow_requests_pipe[1] = -1;
+        }
+    }
+#endif
+
+    if(handoff_channel != -1)
+    {
+        //the previous process can stop accepting
+        details::handoff_send_ack(handoff_channel);
+        close(handoff_channel);
     }
-    details::daemon_item* di = new details::daemon_item(this, daemon);
-    daemons.push_back(di);
 
     bool value_onclose = false;
     if(blocking)
@@ -388,19 +988,129 @@ bool webserver::start(bool blocking)
     return value_onclose;
 }
 
+void webserver::pin_worker_thread()
+{
+#ifdef __linux__
+    //under EXTERNAL_EPOLL the callbacks run on the thread of the caller
+    if(cpu_affinity.empty() || start_method == http_utils::EXTERNAL_EPOLL)
+        return;
+    //a thread is pinned once by each server it works for
+    static __thread const webserver* pinned_by = 0x0;
+    if(pinned_by == this)
+        return;
+    pinned_by = this;
+
+    int slot = atomic_increment(&next_cpu) - 1;
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu_affinity[slot % cpu_affinity.size()], &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+}
+
+int webserver::get_epoll_fd() const
+{
+    return this->running ? epoll_fd : -1;
+}
+
+bool webserver::run_once(int timeout_ms)
+{
+    if(!this->running || epoll_fd == -1)
+        return false;
+#ifdef __linux__
+    typedef vector<details::daemon_item*>::const_iterator daemon_item_it;
+    for(daemon_item_it it = daemons.begin(); it != daemons.end(); ++it)
+    {
+        MHD_UNSIGNED_LONG_LONG mhd_timeout;
+        if(MHD_get_timeout((*it)->daemon, &mhd_timeout) == MHD_YES &&
+                (timeout_ms < 0 || mhd_timeout < (MHD_UNSIGNED_LONG_LONG) timeout_ms))
+            timeout_ms = (int) mhd_timeout;
+    }
+
+    if(timeout_ms != 0)
+    {
+        struct epoll_event event;
+        epoll_wait(epoll_fd, &event, 1, timeout_ms);
+    }
+
+    //MHD_run does not block in this mode: it processes what is ready
+    for(daemon_item_it it = daemons.begin(); it != daemons.end(); ++it)
+        MHD_run((*it)->daemon);
+#endif
+    return true;
+}
+
 bool webserver::is_running()
 {
     return this->running;
 }
 
+void webserver::stop_accepting()
+{
+    //the listen sockets are ours unless bind_socket was passed by the
+    //caller; quiescing twice does nothing
+    typedef vector<details::daemon_item*>::const_iterator daemon_item_it;
+    for(daemon_item_it it = daemons.begin(); it != daemons.end(); ++it)
+    {
+        MHD_socket listen_socket = MHD_quiesce_daemon((*it)->daemon);
+        if(listen_socket != -1 && bind_socket == 0)
+            close(listen_socket);
+    }
+}
+
 bool webserver::stop()
 {
     if(!this->running) return false;
 
+    //MHD_stop_daemon aborts on suspended connections: while the daemons
+    //still run, every suspended connection is resumed and the requests
+    //coming meanwhile are not suspended anymore.
+    stop_accepting();
+
     pthread_mutex_lock(&mutexwait);
     this->running = false;
-    pthread_cond_signal(&mutexcond);
+    this->stopping = true;
+    pthread_cond_broadcast(&mutexcond);
+    vector<async_completion*> pending(completions.begin(), completions.end());
+    for(unsigned int i = 0; i < pending.size(); i++)
+        pending[i]->retain();
+    pthread_mutex_unlock(&mutexwait);
+
+    //render_async calls still pending are answered 503; their later
+    //complete is dropped
+    for(unsigned int i = 0; i < pending.size(); i++)
+    {
+        pending[i]->cancel();
+        pending[i]->release();
+    }
+    if(global_gate != 0x0)
+        global_gate->reject_waiters();
+    for(map<http_resource*, details::admission_gate*>::iterator it =
+            resource_gates.begin(); it != resource_gates.end(); ++it)
+        it->second->reject_waiters();
+    internal_comet_manager->close_all("");
+
+    //the render tasks of this server end before the executor is stopped;
+    //an executor shared with the application keeps running
+    pthread_mutex_lock(&mutexwait);
+    while(async_tasks > 0)
+        pthread_cond_wait(&mutexcond, &mutexwait);
     pthread_mutex_unlock(&mutexwait);
+    if(own_async_executor)
+        async_executor->stop();
+
+#ifndef __MINGW32__
+    if(slow_requests_pipe[1] != -1)
+    {
+        unregister_slow_requests_listener(slow_requests_signal,
+                slow_requests_pipe[1]
+        );
+        //if the pipe is full the dumper is awake already
+        char command = 'q';
+        ssize_t written = write(slow_requests_pipe[1], &command, 1);
+        (void) written;
+    }
+#endif
     for(unsigned int i = 0; i < threads.size(); ++i)
     {
         void* t_res;
@@ -408,14 +1118,131 @@ bool webserver::stop()
         free(t_res);
     }
     threads.clear();
+#ifndef __MINGW32__
+    if(slow_requests_pipe[1] != -1)
+    {
+        close(slow_requests_pipe[0]);
+        close(slow_requests_pipe[1]);
+        slow_requests_pipe[0] = -1;
+        slow_requests_pipe[1] = -1;
+    }
+#endif
+
     typedef vector<details::daemon_item*>::const_iterator daemon_item_it;
 
+    if(epoll_fd != -1 && daemons.size() > 1)
+        close(epoll_fd);
+    epoll_fd = -1;
+
     for(daemon_item_it it = daemons.begin(); it != daemons.end(); ++it)
         delete *it;
     daemons.clear();
 
     shutdown(bind_socket, 2);
 
+    //the requests served so far are in the access log on return
+    if(logger != 0x0)
+        logger->flush();
+
+    return true;
+}
+
+drain_report webserver::drain(int timeout_ms, const string& comet_message)
+{
+    drain_report report;
+    if(!this->running)
+        return report;
+
+    drained = 0;
+    draining = true;
+    report.in_flight = atomic_read(&in_flight);
+
+    stop_accepting();
+
+    report.comet_closed = internal_comet_manager->close_all(comet_message);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+    if(deadline.tv_nsec >= 1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    if(epoll_fd != -1)
+    {
+        //no thread serves the requests in progress: the caller's loop is
+        //stuck here, so the drain drives the daemons itself
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        while(atomic_read(&in_flight) > 0 && (now.tv_sec < deadline.tv_sec ||
+                    (now.tv_sec == deadline.tv_sec && now.tv_nsec < deadline.tv_nsec)))
+        {
+            run_once(10);
+            clock_gettime(CLOCK_REALTIME, &now);
+        }
+    }
+    else
+    {
+        pthread_mutex_lock(&mutexwait);
+        while(atomic_read(&in_flight) > 0 && !report.timed_out)
+        {
+            report.timed_out = pthread_cond_timedwait(&mutexcond, &mutexwait,
+                    &deadline
+            ) == ETIMEDOUT;
+        }
+        pthread_mutex_unlock(&mutexwait);
+    }
+
+    report.aborted = atomic_read(&in_flight);
+    report.timed_out = report.aborted > 0;
+    report.completed = atomic_read(&drained);
+
+    //idle keep-alive connections are closed with the daemons
+    stop();
+    return report;
+}
+
+bool webserver::hand_off(const string& path, int timeout_ms,
+        drain_report* report
+)
+{
+    if(!this->running)
+        return false;
+
+    vector<int> sockets;
+    typedef vector<details::daemon_item*>::const_iterator daemon_item_it;
+    for(daemon_item_it it = daemons.begin(); it != daemons.end(); ++it)
+    {
+        const union MHD_DaemonInfo* info = MHD_get_daemon_info(
+                (*it)->daemon, MHD_DAEMON_INFO_LISTEN_FD
+        );
+        if(info != 0x0)
+            sockets.push_back(info->listen_fd);
+    }
+
+    int listener = details::handoff_listen(path);
+    if(listener == -1)
+        return false;
+    int channel = details::handoff_accept(listener, timeout_ms);
+    close(listener);
+    unlink(path.c_str());
+    if(channel == -1)
+        return false;
+
+    //until the successor acknowledges, both processes accept on the
+    //same sockets: no connection is refused during the switch
+    bool handed_off = details::handoff_send_sockets(channel, sockets) &&
+        details::handoff_wait_ack(channel, timeout_ms);
+    close(channel);
+    if(!handed_off)
+        return false;
+
+    drain_report drained = drain(timeout_ms);
+    if(report != 0x0)
+        *report = drained;
     return true;
 }
 
@@ -426,40 +1253,267 @@ void webserver::unregister_resource(const string& resource)
     this->registered_resources.erase(he.url_complete);
 }
 
-void webserver::ban_ip(const string& ip)
+//the lists are read without locks by the policy callback: they are
+//copied, modified and swapped
+static void update_ip_filter(details::snapshot<details::ip_filter>* list,
+        const string& ip, bool insertion
+)
 {
-    ip_representation t_ip(ip);
-    set<ip_representation>::iterator it = this->bans.find(t_ip);
-    if(it != this->bans.end() && (t_ip.weight() < (*it).weight()))
+    details::ip_filter* next = new details::ip_filter(list->lock());
+    try
+    {
+        if(insertion)
+            next->insert(ip);
+        else
+            next->remove(ip);
+    }
+    catch(...)
     {
-        this->bans.erase(it);
-        this->bans.insert(t_ip);
+        delete next;
+        list->unlock();
+        throw;
     }
-    else
-        this->bans.insert(t_ip);
+    list->publish(next);
+}
+
+void webserver::ban_ip(const string& ip)
+{
+    update_ip_filter(this->bans, ip, true);
 }
 
 void webserver::allow_ip(const string& ip)
 {
-    ip_representation t_ip(ip);
-    set<ip_representation>::iterator it = this->allowances.find(t_ip);
-    if(it != this->allowances.end() && (t_ip.weight() < (*it).weight()))
-    {
-        this->allowances.erase(it);
-        this->allowances.insert(t_ip);
-    }
-    else
-        this->allowances.insert(t_ip);
+    update_ip_filter(this->allowances, ip, true);
 }
 
 void webserver::unban_ip(const string& ip)
 {
-    this->bans.erase(ip);
+    update_ip_filter(this->bans, ip, false);
 }
 
 void webserver::disallow_ip(const string& ip)
 {
-    this->allowances.erase(ip);
+    update_ip_filter(this->allowances, ip, false);
+}
+
+size_t webserver::load_ip_list(const string& filename,
+        http_utils::policy_T policy
+)
+{
+    ifstream file(filename.c_str());
+    if(!file.is_open())
+        throw http::file_access_exception();
+
+    details::ip_filter* next = new details::ip_filter();
+    string line;
+    try
+    {
+        while(getline(file, line))
+        {
+            size_t comment = line.find('#');
+            if(comment != string::npos)
+                line.erase(comment);
+            size_t begin = line.find_first_not_of(" \t\r");
+            if(begin == string::npos)
+                continue;
+            size_t end = line.find_last_not_of(" \t\r");
+            next->insert(line.substr(begin, end - begin + 1));
+        }
+    }
+    catch(...)
+    {
+        delete next;
+        throw;
+    }
+
+    size_t entries = next->size();
+    details::snapshot<details::ip_filter>* list =
+        policy == http_utils::REJECT ? this->bans : this->allowances;
+    list->lock();
+    list->publish(next);
+    return entries;
+}
+
+unsigned long webserver::get_dropped_logs()
+{
+    return logger != 0x0 ? logger->get_dropped() : 0;
+}
+
+void webserver::log_access_record(MHD_Connection* connection,
+        details::modded_request* mr
+)
+{
+    details::log_record* record = logger->reserve();
+    if(record == 0x0)
+        return;
+    record->kind = details::log_record::ACCESS_LOG;
+    gettimeofday(&record->time, NULL);
+    record->client.base.sa_family = AF_UNSPEC;
+    const union MHD_ConnectionInfo* info = MHD_get_connection_info(
+            connection, MHD_CONNECTION_INFO_CLIENT_ADDRESS
+    );
+    if(info != 0x0 && info->client_addr != 0x0)
+    {
+        if(info->client_addr->sa_family == AF_INET6)
+            memcpy(&record->client.v6, info->client_addr, sizeof(struct sockaddr_in6));
+        else if(info->client_addr->sa_family == AF_INET)
+            memcpy(&record->client.v4, info->client_addr, sizeof(struct sockaddr_in));
+    }
+    record->method = details::metrics::method_name(mr->method_id);
+    record->status = 0;
+    record->bytes = 0;
+    if(mr->dhrs.ptr() != 0x0)
+    {
+        record->status = mr->dhrs->get_response_code();
+        record->bytes = mr->dhrs->body_size();
+    }
+    record->latency_us = details::metrics::now() - mr->started;
+    size_t length = mr->complete_uri->size() < LOG_RECORD_TEXT - 1 ?
+        mr->complete_uri->size() : LOG_RECORD_TEXT - 1;
+    memcpy(record->text, mr->complete_uri->data(), length);
+    record->text[length] = '\0';
+    logger->commit();
+}
+
+bool webserver::get_metrics(std::string& result)
+{
+    if(request_metrics == 0x0)
+        return false;
+    request_metrics->render(result);
+
+    unsigned int connections = 0;
+    typedef vector<details::daemon_item*>::const_iterator daemon_item_it;
+    for(daemon_item_it it = daemons.begin(); it != daemons.end(); ++it)
+    {
+        const union MHD_DaemonInfo* info = MHD_get_daemon_info(
+                (*it)->daemon, MHD_DAEMON_INFO_CURRENT_CONNECTIONS
+        );
+        if(info != 0x0)
+            connections += info->num_connections;
+    }
+    details::metrics::render_gauge(result, "httpserver_connections",
+            "Connections currently open.", connections
+    );
+    details::metrics::render_gauge(result, "httpserver_requests_in_flight",
+            "Requests received and not completed yet.", atomic_read(&in_flight)
+    );
+    details::metrics::render_gauge(result, "httpserver_comet_subscribers",
+            "Connections subscribed to comet topics.",
+            internal_comet_manager->count_subscribers()
+    );
+    if(logger != 0x0)
+    {
+        details::metrics::render_counter(result,
+                "httpserver_dropped_logs_total",
+                "Log records dropped because a buffer was full.",
+                logger->get_dropped()
+        );
+    }
+    return true;
+}
+
+bool webserver::get_slow_requests(std::string& result)
+{
+    if(slow_requests == 0x0)
+        return false;
+    slow_requests->render(result);
+    return true;
+}
+
+void webserver::record_slow_request(details::modded_request* mr)
+{
+    const request_trace& trace = *mr->trace;
+    details::slow_request* r = slow_requests->reserve();
+    r->start_time = trace.get_start_time();
+    for(int i = 0; i < request_trace::PHASES; i++)
+    {
+        request_trace::phase_T phase = (request_trace::phase_T) i;
+        r->phases[i] = trace.get_phase_time(phase) == 0 ?
+            SLOW_REQUEST_NOT_REACHED :
+            trace.get_duration(request_trace::RECEIVED, phase);
+    }
+    r->thread = (unsigned long) pthread_self();
+    r->status = trace.get_status();
+    snprintf(r->method, sizeof(r->method), "%s",
+            trace.get_method().empty() ? "-" : trace.get_method().c_str()
+    );
+    snprintf(r->url, sizeof(r->url), "%s", trace.get_url().c_str());
+    snprintf(r->trace_id, sizeof(r->trace_id), "%s",
+            trace.get_trace_id().c_str()
+    );
+
+    snprintf(r->route, sizeof(r->route), "%s", mr->route.c_str());
+
+    //as sent: "name: value\r\n"
+    r->request_headers = mr->request_headers;
+    r->request_header_bytes = mr->request_header_bytes;
+    r->response_headers = 0;
+    r->response_header_bytes = 0;
+    if(mr->dhrs.ptr() != 0x0)
+    {
+        typedef map<string, string, header_comparator> header_map;
+        header_map headers;
+        mr->dhrs->get_headers(headers);
+        for(header_map::const_iterator it = headers.begin(); it != headers.end(); ++it)
+            r->response_header_bytes += it->first.size() + it->second.size() + 4;
+        r->response_headers = headers.size();
+    }
+    slow_requests->commit();
+}
+
+void* webserver::dump_slow_requests(void* self)
+{
+#ifndef __MINGW32__
+    webserver* ws = static_cast<webserver*>(self);
+    char command;
+    while(true)
+    {
+        ssize_t got = read(ws->slow_requests_pipe[0], &command, 1);
+        if(got < 0 && errno == EINTR)
+            continue;
+        if(got <= 0 || !ws->running)
+            break;
+
+        vector<details::slow_request> requests;
+        ws->slow_requests->get_requests(requests);
+        char buf[128];
+        snprintf(buf, sizeof(buf), "%u slow requests recorded\n",
+                (unsigned int) requests.size()
+        );
+        string dump = buf;
+        for(vector<details::slow_request>::const_iterator it = requests.begin();
+                it != requests.end(); ++it)
+            details::flight_recorder::render_request(dump, *it);
+
+        if(ws->log_error == 0x0)
+        {
+            fputs(dump.c_str(), stderr);
+            fflush(stderr);
+            continue;
+        }
+        //through the logging thread, as the other error messages (but
+        //never throttled)
+        size_t begin = 0;
+        while(begin < dump.size())
+        {
+            size_t end = dump.find('\n', begin);
+            details::log_record* record = ws->logger->reserve();
+            if(record != 0x0)
+            {
+                record->kind = details::log_record::ERROR_LOG;
+                gettimeofday(&record->time, NULL);
+                record->suppressed = 0;
+                size_t length = end - begin < LOG_RECORD_TEXT - 1 ?
+                    end - begin : LOG_RECORD_TEXT - 1;
+                memcpy(record->text, dump.data() + begin, length);
+                record->text[length] = '\0';
+                ws->logger->commit();
+            }
+            begin = end + 1;
+        }
+    }
+#endif
+    return 0x0;
 }
 
 int webserver::build_request_header (
@@ -527,15 +1581,29 @@ int webserver::build_request_args (
 
 int policy_callback (void *cls, const struct sockaddr* addr, socklen_t addrlen)
 {
+    (static_cast<webserver*>(cls))->pin_worker_thread();
+
+    if((static_cast<webserver*>(cls))->abuse != 0x0 &&
+            (static_cast<webserver*>(cls))->abuse->banned(addr))
+        return MHD_NO;
+
+    //no token left: the client would only be answered 429
+    if((static_cast<webserver*>(cls))->client_limiter != 0x0 &&
+            (static_cast<webserver*>(cls))->client_limiter->exhausted(addr))
+        return MHD_NO;
+
     if(!(static_cast<webserver*>(cls))->ban_system_enabled) return MHD_YES;
 
+    details::snapshot<details::ip_filter>::read_guard
+        bans(*(static_cast<webserver*>(cls))->bans);
+    details::snapshot<details::ip_filter>::read_guard
+        allowances(*(static_cast<webserver*>(cls))->allowances);
+
     if((((static_cast<webserver*>(cls))->default_policy == http_utils::ACCEPT) &&
-       ((static_cast<webserver*>(cls))->bans.count(addr)) &&
-       (!(static_cast<webserver*>(cls))->allowances.count(addr))
+       (bans->contains(addr)) && (!allowances->contains(addr))
     ) ||
     (((static_cast<webserver*>(cls))->default_policy == http_utils::REJECT)
-       && ((!(static_cast<webserver*>(cls))->allowances.count(addr)) ||
-       ((static_cast<webserver*>(cls))->bans.count(addr)))
+       && ((!allowances->contains(addr)) || (bans->contains(addr)))
     ))
     {
         return MHD_NO;
@@ -546,21 +1614,107 @@ int policy_callback (void *cls, const struct sockaddr* addr, socklen_t addrlen)
 
 void* uri_log(void* cls, const char* uri)
 {
+    //pin before allocating so that per-thread state is NUMA-local
+    (static_cast<webserver*>(cls))->pin_worker_thread();
+
     struct details::modded_request* mr = new details::modded_request();
     mr->complete_uri = new string(uri);
     mr->second = false;
+    //the flight recorder needs the phases of every request to find the
+    //slow ones
+    if((static_cast<webserver*>(cls))->trace_export != 0x0 ||
+            (static_cast<webserver*>(cls))->slow_requests != 0x0)
+    {
+        mr->trace = new request_trace();
+        mr->trace->mark(request_trace::RECEIVED);
+    }
     return ((void*)mr);
 }
 
 void error_log(void* cls, const char* fmt, va_list ap)
 {
     webserver* dws = static_cast<webserver*>(cls);
-    if(dws->log_error != 0x0) dws->log_error(fmt);
+    if(dws->log_error == 0x0)
+        return;
+    //a storm of the same error stops here, before any formatting
+    unsigned long suppressed;
+    if(!dws->error_throttle->admit(fmt, suppressed))
+        return;
+    details::log_record* record = dws->logger->reserve();
+    if(record == 0x0)
+        return;
+    record->kind = details::log_record::ERROR_LOG;
+    gettimeofday(&record->time, NULL);
+    record->suppressed = suppressed;
+    //the slot belongs to this thread until commit
+    int length = vsnprintf(record->text, LOG_RECORD_TEXT, fmt, ap);
+    if(length < 0)
+        length = 0;
+    if(length >= LOG_RECORD_TEXT)
+        length = LOG_RECORD_TEXT - 1;
+    while(length > 0 && (record->text[length - 1] == '\n' ||
+                record->text[length - 1] == '\r'))
+        record->text[--length] = '\0';
+    dws->logger->commit();
 }
 
-void access_log(webserver* dws, string uri)
+void deliver_logs(void* cls, const details::log_record* records, size_t count)
 {
-    if(dws->log_access != 0x0) dws->log_access(uri);
+    webserver* dws = static_cast<webserver*>(cls);
+    string lines;
+    string line;
+    for(size_t i = 0; i < count; i++)
+    {
+        const details::log_record& r = records[i];
+        char buf[128];
+        if(r.kind == details::log_record::ERROR_LOG)
+        {
+            line = r.text;
+            if(r.suppressed > 0)
+            {
+                snprintf(buf, sizeof(buf), " (%lu similar messages suppressed)",
+                        r.suppressed
+                );
+                line += buf;
+            }
+            if(dws->log_error != 0x0)
+                dws->log_error(line);
+            continue;
+        }
+        struct tm when;
+        gmtime_r(&r.time.tv_sec, &when);
+        strftime(buf, sizeof(buf), "time=%Y-%m-%dT%H:%M:%S", &when);
+        line = buf;
+        snprintf(buf, sizeof(buf), ".%03dZ client=", (int) (r.time.tv_usec / 1000));
+        line += buf;
+        string client;
+        if(r.client.base.sa_family == AF_INET || r.client.base.sa_family == AF_INET6)
+            get_ip_str(&r.client.base, client);
+        line += client.empty() ? "-" : client;
+        line += " method=";
+        line += r.method;
+        line += " path=\"";
+        for(const char* c = r.text; *c != '\0'; c++)
+        {
+            if(*c == '"' || *c == '\\')
+                line += '\\';
+            line += *c;
+        }
+        snprintf(buf, sizeof(buf), "\" status=%d bytes=%llu latency_us=%llu",
+                r.status, (unsigned long long) r.bytes,
+                (unsigned long long) r.latency_us
+        );
+        line += buf;
+        if(dws->log_access != 0x0)
+            dws->log_access(line);
+        if(dws->log_access_batch != 0x0)
+        {
+            lines += line;
+            lines += '\n';
+        }
+    }
+    if(dws->log_access_batch != 0x0 && !lines.empty())
+        dws->log_access_batch(lines);
 }
 
 size_t unescaper_func(void * cls, struct MHD_Connection *c, char *s)
@@ -638,6 +1792,105 @@ void webserver::internal_error_page(
         *dhrs = new http_response(http_response_builder(GENERIC_ERROR, http_utils::http_internal_server_error).string_response());
 }
 
+void webserver::service_unavailable_page(
+        http_response** dhrs,
+        details::modded_request* mr
+)
+{
+    if(service_unavailable_resource != 0x0)
+        service_unavailable_resource(*mr->dhr, dhrs);
+    if(*dhrs == 0x0)
+        *dhrs = new http_response(http_response_builder(SERVICE_UNAVAILABLE_ERROR, http_utils::http_service_unavailable).string_response());
+    if(!(*dhrs)->headers.count(http_utils::http_header_retry_after))
+    {
+        char seconds[16];
+        snprintf(seconds, sizeof seconds, "%d", retry_after);
+        (*dhrs)->headers[http_utils::http_header_retry_after] = seconds;
+    }
+}
+
+void webserver::too_many_requests_page(
+        http_response** dhrs,
+        details::modded_request* mr,
+        int wait
+)
+{
+    if(too_many_requests_resource != 0x0)
+        too_many_requests_resource(*mr->dhr, dhrs);
+    if(*dhrs == 0x0)
+        *dhrs = new http_response(http_response_builder(TOO_MANY_REQUESTS_ERROR, http_utils::http_too_many_requests).string_response());
+    if(!(*dhrs)->headers.count(http_utils::http_header_retry_after))
+    {
+        char seconds[16];
+        snprintf(seconds, sizeof seconds, "%d", wait);
+        (*dhrs)->headers[http_utils::http_header_retry_after] = seconds;
+    }
+}
+
+int webserver::throttle(MHD_Connection* connection, http_resource* hrm)
+{
+    const union MHD_ConnectionInfo* info = MHD_get_connection_info(
+            connection, MHD_CONNECTION_INFO_CLIENT_ADDRESS
+    );
+    if(info == 0x0 || info->client_addr == 0x0)
+        return 0;
+
+    //a token of the server is spent even if the resource refuses the
+    //request: refused requests count against a flooding client
+    int wait = 0;
+    if(client_limiter != 0x0)
+        wait = client_limiter->consume(info->client_addr);
+    map<http_resource*, details::rate_limiter*>::iterator it =
+        resource_limiters.find(hrm);
+    if(wait == 0 && it != resource_limiters.end())
+        wait = it->second->consume(info->client_addr);
+    return wait;
+}
+
+int webserver::admit(
+        MHD_Connection* connection,
+        struct details::modded_request* mr,
+        http_resource* hrm
+)
+{
+    //the resource gate is taken first, so that a request waiting for a
+    //slot of the server does not block the other resources.
+    map<http_resource*, details::admission_gate*>::iterator it =
+        resource_gates.find(hrm);
+    details::admission_gate* gates[2] = {
+        it != resource_gates.end() ? it->second : 0x0,
+        global_gate
+    };
+    details::admission_ticket* tickets[2] = {
+        &mr->resource_ticket,
+        &mr->global_ticket
+    };
+    for(int i = 0; i < 2; i++)
+    {
+        if(gates[i] == 0x0 || tickets[i]->gate != 0x0)
+            continue;
+        if(tickets[i]->rejected)
+            return details::admission_gate::REJECTED;
+
+        int result = gates[i]->acquire(*tickets[i], connection,
+                suspend_resume, hrm->priority
+        );
+        if(result == details::admission_gate::QUEUED)
+        {
+            //the request has to outlive this call
+            if(!mr->second)
+            {
+                mr->dhr = new http_request(*mr->dhr);
+                mr->second = true;
+            }
+            mr->admission_pending = true;
+        }
+        if(result != details::admission_gate::ADMITTED)
+            return result;
+    }
+    return details::admission_gate::ADMITTED;
+}
+
 int webserver::bodyless_requests_answer(
     MHD_Connection* connection, const char* method,
     const char* version, struct details::modded_request* mr
@@ -645,7 +1898,11 @@ int webserver::bodyless_requests_answer(
 {
     http_request req;
     mr->dhr = &(req);
-    return complete_request(connection, mr, version, method);
+    int to_ret = complete_request(connection, mr, version, method);
+    //unless copied to outlive the call, the request is gone
+    if(!mr->second)
+        mr->dhr = 0x0;
+    return to_ret;
 }
 
 int webserver::bodyfull_requests_answer_first_step(
@@ -707,6 +1964,8 @@ int webserver::bodyfull_requests_answer_second_step(
     cout << "Writing content: " << upload_data << endl;
 #endif //DEBUG
     mr->dhr->grow_content(upload_data, *upload_data_size);
+    if(request_metrics != 0x0)
+        request_metrics->add_received(*upload_data_size);
 
     if (mr->pp != NULL) MHD_post_process(mr->pp, upload_data, *upload_data_size);
     *upload_data_size = 0;
@@ -748,6 +2007,15 @@ void webserver::end_request_construction(
             &build_request_cookie,
             (void*) mr->dhr
     );
+    //bodyless requests do not last until completion: the flight recorder
+    //takes the size of the headers now
+    if(slow_requests != 0x0)
+    {
+        map<string, string, header_comparator>::const_iterator it;
+        for(it = mr->dhr->headers.begin(); it != mr->dhr->headers.end(); ++it)
+            mr->request_header_bytes += it->first.size() + it->second.size() + 4;
+        mr->request_headers = mr->dhr->headers.size();
+    }
 
     mr->dhr->set_path(mr->standardized_url->c_str());
     mr->dhr->set_method(method);
@@ -776,6 +2044,16 @@ void webserver::end_request_construction(
     {
         mr->dhr->set_digested_user(digested_user);
     }
+    if(mr->trace != 0x0)
+    {
+        mr->trace->continue_trace(
+                mr->dhr->get_header(http_utils::http_header_traceparent)
+        );
+        mr->trace->method = method;
+        mr->trace->url = *mr->complete_uri;
+        mr->dhr->trace = mr->trace;
+        mr->trace->mark(request_trace::PARSED);
+    }
 }
 
 int webserver::finalize_answer(
@@ -784,15 +2062,14 @@ int webserver::finalize_answer(
         const char* method
 )
 {
-    int to_ret = MHD_NO;
     http_response* dhrs = 0x0;
 
     map<string, http_resource*>::iterator fe;
 
     http_resource* hrm;
+    const details::http_endpoint* matched = 0x0;
 
     bool found = false;
-    struct MHD_Response* raw_response;
     if(!single_resource)
     {
         const char* st_url = mr->standardized_url->c_str();
@@ -859,6 +2136,7 @@ int webserver::finalize_answer(
                     }
 
                     hrm = found_endpoint->second;
+                    matched = &found_endpoint->first;
                 }
             }
         }
@@ -871,9 +2149,101 @@ int webserver::finalize_answer(
     else
     {
         hrm = registered_resources.begin()->second;
+        matched = &registered_resources.begin()->first;
         found = true;
     }
     mr->dhr->set_underlying_connection(connection);
+    if(mr->trace != 0x0)
+    {
+        mr->trace->mark(request_trace::ROUTED);
+        if(matched != 0x0)
+            matched->get_url_complete(mr->route);
+        else if(found)
+            mr->route = fe->first;
+    }
+
+    if(found && request_metrics != 0x0)
+    {
+        map<http_resource*, int>::const_iterator route = metrics_routes.find(hrm);
+        if(route != metrics_routes.end())
+            mr->route_id = route->second;
+    }
+
+    if(found && !mr->rate_checked &&
+            (client_limiter != 0x0 || !resource_limiters.empty()) &&
+            hrm->is_allowed(method))
+    {
+        //requests resumed from an admission queue come back here
+        mr->rate_checked = true;
+        int wait = throttle(connection, hrm);
+        if(wait > 0)
+        {
+            too_many_requests_page(&dhrs, mr, wait);
+            return enqueue_answer(connection, mr, dhrs);
+        }
+    }
+
+    if(found && (global_gate != 0x0 || !resource_gates.empty()) &&
+            hrm->is_allowed(method))
+    {
+        int admission = admit(connection, mr, hrm);
+        if(admission == details::admission_gate::QUEUED)
+            return MHD_YES;
+        if(admission == details::admission_gate::REJECTED)
+        {
+            service_unavailable_page(&dhrs, mr);
+            return enqueue_answer(connection, mr, dhrs);
+        }
+    }
+
+    if(found && hrm->is_async() && hrm->is_allowed(method))
+    {
+        //the request has to outlive this call
+        if(!mr->second)
+        {
+            mr->dhr = new http_request(*mr->dhr);
+            mr->second = true;
+        }
+
+        //once stop() has answered the pending completions nothing would
+        //resume a new one
+        details::async_render_task* task = 0x0;
+        pthread_mutex_lock(&mutexwait);
+        if(!stopping)
+        {
+            mr->async = new async_completion(connection, hrm, mr->callback,
+                    mr->dhr, mr->trace
+            );
+            completions.insert(mr->async);
+            task = new details::async_render_task(mr->async, this);
+            async_tasks++;
+        }
+        pthread_mutex_unlock(&mutexwait);
+        if(task == 0x0)
+        {
+            service_unavailable_page(&dhrs, mr);
+            return enqueue_answer(connection, mr, dhrs);
+        }
+
+        if(async_executor != 0x0)
+            async_executor->submit(task, hrm->priority);
+        else
+        {
+            task->run();
+            delete task;
+        }
+
+        if(mr->async->suspend_unless_completed(suspend_resume))
+            return MHD_YES;
+        if(!mr->async->is_completed())
+        {
+            //without suspend_resume nothing could deliver a completion
+            //coming after render_async returned: it has been abandoned
+            internal_error_page(&dhrs, mr);
+            return enqueue_answer(connection, mr, dhrs);
+        }
+        return finalize_async_answer(connection, mr);
+    }
 
     if(found)
     {
@@ -902,6 +2272,40 @@ int webserver::finalize_answer(
     {
         not_found_page(&dhrs, mr);
     }
+    return enqueue_answer(connection, mr, dhrs);
+}
+
+int webserver::finalize_async_answer(
+        MHD_Connection* connection,
+        struct details::modded_request* mr
+)
+{
+    if(!mr->async->is_completed())
+        return MHD_YES;
+
+    http_response* dhrs = 0x0;
+    if(mr->async->is_cancelled())
+        service_unavailable_page(&dhrs, mr);
+    else if((dhrs = mr->async->take_response()) == 0x0)
+        internal_error_page(&dhrs, mr);
+    return enqueue_answer(connection, mr, dhrs);
+}
+
+int webserver::enqueue_answer(
+        MHD_Connection* connection,
+        struct details::modded_request* mr,
+        http_response* dhrs
+)
+{
+    int to_ret = MHD_NO;
+    struct MHD_Response* raw_response;
+
+    //the render is over: the slots go to the next waiting requests
+    details::release_ticket(mr->global_ticket);
+    details::release_ticket(mr->resource_ticket);
+
+    if(mr->trace != 0x0)
+        mr->trace->mark(request_trace::RENDERED);
     mr->dhrs = dhrs;
     mr->dhrs->underlying_connection = connection;
     try
@@ -931,9 +2335,35 @@ int webserver::finalize_answer(
         internal_error_page(&dhrs, mr, true);
         dhrs->get_raw_response(&raw_response, this);
     }
+    if(mr->trace != 0x0)
+        mr->trace->mark(request_trace::RESPONSE_BUILT);
     dhrs->decorate_response(raw_response);
+    if(request_metrics != 0x0)
+    {
+        request_metrics->add_sent(dhrs->body_size());
+    }
+    bool close_connection = draining;
+    if(abuse != 0x0 && dhrs->get_response_code() >= 400 &&
+            dhrs->get_response_code() < 500)
+    {
+        const union MHD_ConnectionInfo* info = MHD_get_connection_info(
+                connection, MHD_CONNECTION_INFO_CLIENT_ADDRESS
+        );
+        //just banned: its keep-alive connection goes too
+        if(info != 0x0 && info->client_addr != 0x0 &&
+                abuse->record(info->client_addr))
+            close_connection = true;
+    }
+    if(close_connection)
+    {
+        MHD_add_response_header(raw_response,
+                http_utils::http_header_connection.c_str(), "close"
+        );
+    }
     to_ret = dhrs->enqueue_response(connection, raw_response);
     MHD_destroy_response (raw_response);
+    if(mr->trace != 0x0)
+        mr->trace->mark(request_trace::ENQUEUED);
     return to_ret;
 }
 
@@ -979,6 +2409,19 @@ int webserver::answer_to_connection(void* cls, MHD_Connection* connection,
     struct details::modded_request* mr =
         static_cast<struct details::modded_request*>(*con_cls);
 
+    if(mr->async != 0x0)
+    {
+        return static_cast<webserver*>(cls)->
+            finalize_async_answer(connection, mr);
+    }
+
+    if(mr->admission_pending)
+    {
+        mr->admission_pending = false;
+        return static_cast<webserver*>(cls)->
+            finalize_answer(connection, mr, method);
+    }
+
     if(mr->second != false)
     {
         return static_cast<webserver*>(cls)->
@@ -993,16 +2436,19 @@ int webserver::answer_to_connection(void* cls, MHD_Connection* connection,
     }
 
     mr->standardized_url = new string();
+    atomic_increment(&static_cast<webserver*>(cls)->in_flight);
+    if(static_cast<webserver*>(cls)->request_metrics != 0x0 ||
+            static_cast<webserver*>(cls)->log_access != 0x0 ||
+            static_cast<webserver*>(cls)->log_access_batch != 0x0)
+    {
+        mr->started = details::metrics::now();
+        mr->method_id = details::metrics::method_id(method);
+    }
     internal_unescaper((void*) static_cast<webserver*>(cls), (char*) url);
     http_utils::standardize_url(url, *mr->standardized_url);
 
     bool body = false;
 
-    access_log(
-            static_cast<webserver*>(cls),
-            *(mr->complete_uri) + " METHOD: " + method
-    );
-
     if( 0 == strcasecmp(method, http_utils::http_method_get.c_str()))
     {
         mr->callback = &http_resource::render_GET;
@@ -1099,12 +2545,21 @@ http_response* webserver::get_from_cache(
         }
         *ce = (*it).second;
         pthread_rwlock_unlock(&cache_guard);
+        if(request_metrics != 0x0)
+        {
+            if(*valid)
+                request_metrics->cache_hit();
+            else
+                request_metrics->cache_miss();
+        }
         return (*it).second->response.ptr();
     }
     else
     {
         pthread_rwlock_unlock(&cache_guard);
         *valid = false;
+        if(request_metrics != 0x0)
+            request_metrics->cache_miss();
         return 0x0;
     }
 }
@@ -20,8 +20,14 @@
 
 #include "littletest.hpp"
 #include <curl/curl.h>
+#include <cstdio>
+#include <unistd.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdexcept>
 #include <string>
 #include <map>
+#include <vector>
 #include "httpserver.hpp"
 
 using namespace httpserver;
@@ -69,6 +75,22 @@ class long_content_resource : public http_resource
         }
 };
 
+class shared_content_resource : public http_resource
+{
+    public:
+        shared_content_resource():
+            content(lorem_ipsum)
+        {
+        }
+
+        void render_GET(const http_request& req, http_response** res)
+        {
+            *res = new http_response(http_response_builder(content, 200, "text/plain").string_response());
+        }
+
+        shared_buffer content;
+};
+
 class header_test_resource : public http_resource
 {
     public:
@@ -80,6 +102,276 @@ class header_test_resource : public http_resource
         }
 };
 
+class header_template_resource : public http_resource
+{
+    public:
+        header_template_resource()
+        {
+            fixed_headers.with_header("KEY", "VALUE")
+                .with_header("Content-Type", "application/json")
+                .with_cookie("name", "cookie");
+        }
+
+        void render_GET(const http_request& req, http_response** res)
+        {
+            http_response_builder hrb("OK", 200, "text/plain");
+            hrb.with_header_template(fixed_headers);
+            *res = new http_response(hrb.string_response());
+        }
+
+        header_template fixed_headers;
+};
+
+class file_response_resource : public http_resource
+{
+    public:
+        void render_GET(const http_request& req, http_response** res)
+        {
+            *res = new http_response(http_response_builder("test_content", 200, "text/plain").file_response());
+        }
+};
+
+class async_test_resource : public http_resource
+{
+    public:
+        async_test_resource()
+        {
+            set_async(true);
+        }
+
+        void render_GET(const http_request& req, http_response** res)
+        {
+            *res = new http_response(http_response_builder("OK", 200, "text/plain").string_response());
+        }
+};
+
+void* complete_later(void* completion)
+{
+    usleep(100000);
+    static_cast<async_completion*>(completion)->complete(
+        new http_response(http_response_builder("LATER", 200, "text/plain").string_response())
+    );
+    return 0x0;
+}
+
+class deferred_completion_resource : public http_resource
+{
+    public:
+        deferred_completion_resource()
+        {
+            set_async(true);
+        }
+
+        void render_async(const http_request& req, async_completion& completion)
+        {
+            pthread_t t;
+            pthread_create(&t, 0x0, &complete_later, &completion);
+            pthread_detach(t);
+        }
+};
+
+//never completes: only a suspended connection could wait for it
+class uncompleted_resource : public http_resource
+{
+    public:
+        uncompleted_resource()
+        {
+            set_async(true);
+        }
+
+        void render_async(const http_request& req, async_completion& completion)
+        {
+        }
+};
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+class sleeping_coroutine_resource : public coroutine_resource
+{
+    public:
+        explicit sleeping_coroutine_resource(unsigned int delay_ms):
+            delay_ms(delay_ms),
+            started(false),
+            resumed(false)
+        {
+        }
+
+        task<http_response*> render_async(const http_request& req)
+        {
+            started = true;
+            co_await async_sleep(delay_ms);
+            //the request is still valid, even after a stop
+            path = req.get_path();
+            resumed = true;
+            co_return new http_response(http_response_builder("SLEPT", 200, "text/plain").string_response());
+        }
+
+        unsigned int delay_ms;
+        volatile bool started;
+        volatile bool resumed;
+        std::string path;
+};
+
+task<pthread_t> thread_after_resume_on(executor& pool)
+{
+    co_await resume_on(pool);
+    co_return pthread_self();
+}
+
+class moving_coroutine_resource : public coroutine_resource
+{
+    public:
+        explicit moving_coroutine_resource(executor* pool):
+            pool(pool)
+        {
+        }
+
+        task<http_response*> render_async(const http_request& req)
+        {
+            pthread_t before = pthread_self();
+            pthread_t after = co_await thread_after_resume_on(*pool);
+            co_return new http_response(http_response_builder(
+                        pthread_equal(before, after) ? "SAME" : "MOVED",
+                        200, "text/plain").string_response());
+        }
+
+        executor* pool;
+};
+
+class throwing_coroutine_resource : public coroutine_resource
+{
+    public:
+        task<http_response*> render_async(const http_request& req)
+        {
+            co_await async_sleep(1);
+            throw std::runtime_error("render failed");
+        }
+};
+#endif
+
+//keeps the completion, to complete it once the server is stopped
+class held_completion_resource : public http_resource
+{
+    public:
+        held_completion_resource():
+            held(0x0)
+        {
+            set_async(true);
+        }
+
+        void render_async(const http_request& req, async_completion& completion)
+        {
+            held = &completion;
+        }
+
+        async_completion* volatile held;
+};
+
+//calls the server back while it is rendering, so that the inner request
+//finds every slot taken.
+class nested_request_resource : public http_resource
+{
+    public:
+        nested_request_resource():
+            inner_status(0)
+        {
+        }
+
+        void render_GET(const http_request& req, http_response** res)
+        {
+            std::string s;
+            CURL *curl = curl_easy_init();
+            curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/inner");
+            curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+            curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+            curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &inner_headers);
+            if(curl_easy_perform(curl) == CURLE_OK)
+                curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &inner_status);
+            curl_easy_cleanup(curl);
+            *res = new http_response(http_response_builder("OK", 200, "text/plain").string_response());
+        }
+
+        long inner_status;
+        map<string, string> inner_headers;
+};
+
+class slow_resource : public http_resource
+{
+    public:
+        void render_GET(const http_request& req, http_response** res)
+        {
+            usleep(300000);
+            *res = new http_response(http_response_builder("SLOW", 200, "text/plain").string_response());
+        }
+};
+
+struct slow_request
+{
+    std::string body;
+    map<string, string> headers;
+    CURLcode res;
+};
+
+void* perform_slow_request(void* arg)
+{
+    slow_request* r = static_cast<slow_request*>(arg);
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/slow");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &r->body);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &r->headers);
+    r->res = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    return 0x0;
+}
+
+struct loop_request
+{
+    std::string body;
+    CURLcode res;
+    volatile bool done;
+};
+
+void* perform_loop_request(void* arg)
+{
+    loop_request* r = static_cast<loop_request*>(arg);
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &r->body);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+    r->res = curl_easy_perform(curl);
+    curl_easy_cleanup(curl);
+    r->done = true;
+    return 0x0;
+}
+
+class new_version_resource : public http_resource
+{
+    public:
+        void render_GET(const http_request& req, http_response** res)
+        {
+            *res = new http_response(http_response_builder("NEW", 200, "text/plain").string_response());
+        }
+};
+
+struct hand_off_call
+{
+    webserver* ws;
+    bool handed_off;
+};
+
+void* call_hand_off(void* arg)
+{
+    hand_off_call* call = static_cast<hand_off_call*>(arg);
+    call->handed_off = call->ws->hand_off("handoff_test.sock", 5000);
+    return 0x0;
+}
+
 class complete_test_resource : public http_resource
 {
     public:
@@ -229,6 +521,23 @@ LT_BEGIN_AUTO_TEST(basic_suite, read_long_body)
     curl_easy_cleanup(curl);
 LT_END_AUTO_TEST(read_long_body)
 
+LT_BEGIN_AUTO_TEST(basic_suite, read_shared_body)
+    shared_content_resource* resource = new shared_content_resource();
+    ws->register_resource("base", resource);
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, lorem_ipsum);
+    curl_easy_cleanup(curl);
+LT_END_AUTO_TEST(read_shared_body)
+
 LT_BEGIN_AUTO_TEST(basic_suite, read_header)
     header_test_resource* resource = new header_test_resource();
     ws->register_resource("base", resource);
@@ -250,6 +559,29 @@ LT_BEGIN_AUTO_TEST(basic_suite, read_header)
     curl_easy_cleanup(curl);
 LT_END_AUTO_TEST(read_header)
 
+LT_BEGIN_AUTO_TEST(basic_suite, read_header_template)
+    header_template_resource* resource = new header_template_resource();
+    ws->register_resource("base", resource);
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    map<string, string> ss;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8080/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &ss);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "OK");
+    LT_CHECK_EQ(ss["KEY"], "VALUE");
+    LT_CHECK_EQ(ss["Set-Cookie"], "name=cookie");
+    LT_CHECK_EQ(ss["Content-Type"], "text/plain");
+    curl_easy_cleanup(curl);
+LT_END_AUTO_TEST(read_header_template)
+
 LT_BEGIN_AUTO_TEST(basic_suite, complete)
     complete_test_resource* resource = new complete_test_resource();
     ws->register_resource("base", resource);
@@ -424,6 +756,721 @@ LT_BEGIN_AUTO_TEST(basic_suite, no_response)
     curl_easy_cleanup(curl);
 LT_END_AUTO_TEST(no_response)
 
+LT_BEGIN_AUTO_TEST(basic_suite, mmap_file_response)
+    FILE* f = fopen("test_content", "w");
+    fputs("test content of file", f);
+    fclose(f);
+
+    webserver mmap_ws = create_webserver(8081).mmap_file_responses();
+    file_response_resource* resource = new file_response_resource();
+    mmap_ws.register_resource("base", resource);
+    mmap_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "test content of file");
+    curl_easy_cleanup(curl);
+
+    mmap_ws.stop();
+    remove("test_content");
+LT_END_AUTO_TEST(mmap_file_response)
+
+LT_BEGIN_AUTO_TEST(basic_suite, multiple_daemons)
+    webserver multi_ws = create_webserver(8081).daemon_count(4);
+    ok_resource* resource = new ok_resource();
+    multi_ws.register_resource("base", resource);
+    multi_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    for(int i = 0; i < 16; i++)
+    {
+        std::string s;
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        LT_ASSERT_EQ(res, 0);
+        LT_CHECK_EQ(s, "OK");
+        curl_easy_cleanup(curl);
+    }
+
+    multi_ws.stop();
+LT_END_AUTO_TEST(multiple_daemons)
+
+LT_BEGIN_AUTO_TEST(basic_suite, pinned_workers)
+    webserver pinned_ws = create_webserver(8081).max_threads(2).cpu_affinity(0, 0);
+    ok_resource* resource = new ok_resource();
+    pinned_ws.register_resource("base", resource);
+    pinned_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "OK");
+    curl_easy_cleanup(curl);
+
+    pinned_ws.stop();
+LT_END_AUTO_TEST(pinned_workers)
+
+LT_BEGIN_AUTO_TEST(basic_suite, async_render)
+    webserver async_ws = create_webserver(8081).async_threads(2);
+    async_test_resource* resource = new async_test_resource();
+    async_ws.register_resource("base", resource);
+    deferred_completion_resource* deferred = new deferred_completion_resource();
+    async_ws.register_resource("deferred", deferred);
+    async_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    {
+        std::string s;
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        LT_ASSERT_EQ(res, 0);
+        LT_CHECK_EQ(s, "OK");
+        curl_easy_cleanup(curl);
+    }
+    {
+        std::string s;
+        CURL *curl = curl_easy_init();
+        CURLcode res;
+        curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/deferred");
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        res = curl_easy_perform(curl);
+        LT_ASSERT_EQ(res, 0);
+        LT_CHECK_EQ(s, "LATER");
+        curl_easy_cleanup(curl);
+    }
+
+    async_ws.stop();
+LT_END_AUTO_TEST(async_render)
+
+LT_BEGIN_AUTO_TEST(basic_suite, async_render_without_suspend)
+    webserver inline_ws = create_webserver(8081).no_suspend_resume();
+    uncompleted_resource* resource = new uncompleted_resource();
+    inline_ws.register_resource("base", resource);
+    inline_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT, 5L);
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    LT_CHECK_EQ(http_code, 500);
+    curl_easy_cleanup(curl);
+
+    inline_ws.stop();
+LT_END_AUTO_TEST(async_render_without_suspend)
+
+LT_BEGIN_AUTO_TEST(basic_suite, stop_with_pending_async_render)
+    webserver async_ws = create_webserver(8081).async_threads(1);
+    held_completion_resource* resource = new held_completion_resource();
+    async_ws.register_resource("base", resource);
+    async_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    loop_request r;
+    r.done = false;
+    pthread_t client;
+    pthread_create(&client, 0x0, &perform_loop_request, &r);
+    for(int i = 0; i < 500 && resource->held == 0x0; i++)
+        usleep(10000);
+    LT_ASSERT_EQ(resource->held != 0x0, true);
+
+    //the suspended connection is answered instead of aborting the daemon
+    async_ws.stop();
+    pthread_join(client, 0x0);
+    LT_ASSERT_EQ(r.res, 0);
+    LT_CHECK_EQ(r.body, "Service Unavailable");
+
+    //a completion coming after the stop is dropped
+    resource->held->complete(
+        new http_response(http_response_builder("LATE", 200, "text/plain").string_response())
+    );
+LT_END_AUTO_TEST(stop_with_pending_async_render)
+
+LT_BEGIN_AUTO_TEST(basic_suite, concurrency_limit)
+    webserver limited_ws = create_webserver(8081)
+        .start_method(http::http_utils::THREAD_PER_CONNECTION)
+        .max_in_flight(1)
+        .retry_after(5);
+    nested_request_resource* outer = new nested_request_resource();
+    limited_ws.register_resource("outer", outer);
+    simple_resource* inner = new simple_resource();
+    limited_ws.register_resource("inner", inner);
+    limited_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/outer");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "OK");
+    LT_CHECK_EQ(outer->inner_status, 503);
+    LT_CHECK_EQ(outer->inner_headers["Retry-After"], "5");
+
+    //the slot is given back once the response is ready
+    s = "";
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/inner");
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "OK");
+    curl_easy_cleanup(curl);
+
+    limited_ws.stop();
+LT_END_AUTO_TEST(concurrency_limit)
+
+LT_BEGIN_AUTO_TEST(basic_suite, drain)
+    webserver draining_ws = create_webserver(8081).max_threads(2);
+    slow_resource* resource = new slow_resource();
+    draining_ws.register_resource("slow", resource);
+    draining_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    slow_request r;
+    pthread_t client;
+    pthread_create(&client, 0x0, &perform_slow_request, &r);
+    usleep(100000);
+
+    drain_report report = draining_ws.drain(5000);
+    pthread_join(client, 0x0);
+
+    LT_CHECK_EQ(draining_ws.is_running(), false);
+    LT_ASSERT_EQ(r.res, 0);
+    LT_CHECK_EQ(r.body, "SLOW");
+    LT_CHECK_EQ(r.headers["Connection"], "close");
+    LT_CHECK_EQ(report.in_flight, 1);
+    LT_CHECK_EQ(report.completed, 1);
+    LT_CHECK_EQ(report.aborted, 0);
+    LT_CHECK_EQ(report.timed_out, false);
+LT_END_AUTO_TEST(drain)
+
+LT_BEGIN_AUTO_TEST(basic_suite, socket_hand_off)
+    webserver old_ws = create_webserver(8081);
+    simple_resource* old_resource = new simple_resource();
+    old_ws.register_resource("base", old_resource);
+    old_ws.start(false);
+
+    hand_off_call call;
+    call.ws = &old_ws;
+    call.handed_off = false;
+    pthread_t t;
+    pthread_create(&t, 0x0, &call_hand_off, &call);
+
+    //binding 8081 would fail: the successor must inherit the socket
+    webserver new_ws = create_webserver(8081)
+        .inherit_sockets("handoff_test.sock");
+    new_version_resource* new_resource = new new_version_resource();
+    new_ws.register_resource("base", new_resource);
+    new_ws.start(false);
+    pthread_join(t, 0x0);
+
+    LT_CHECK_EQ(call.handed_off, true);
+    LT_CHECK_EQ(old_ws.is_running(), false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    CURLcode res;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    res = curl_easy_perform(curl);
+    LT_ASSERT_EQ(res, 0);
+    LT_CHECK_EQ(s, "NEW");
+    curl_easy_cleanup(curl);
+
+    new_ws.stop();
+LT_END_AUTO_TEST(socket_hand_off)
+
+LT_BEGIN_AUTO_TEST(basic_suite, external_event_loop)
+    webserver loop_ws = create_webserver(8081)
+        .start_method(http::http_utils::EXTERNAL_EPOLL);
+    LT_CHECK_EQ(loop_ws.get_epoll_fd(), -1);
+    simple_resource* resource = new simple_resource();
+    loop_ws.register_resource("base", resource);
+    loop_ws.start(false);
+    LT_CHECK_NEQ(loop_ws.get_epoll_fd(), -1);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    loop_request r;
+    r.done = false;
+    pthread_t client;
+    pthread_create(&client, 0x0, &perform_loop_request, &r);
+
+    //the request is only served by this thread
+    int iterations = 0;
+    while(!r.done && iterations++ < 500)
+        LT_ASSERT_EQ(loop_ws.run_once(10), true);
+    pthread_join(client, 0x0);
+
+    LT_ASSERT_EQ(r.res, 0);
+    LT_CHECK_EQ(r.body, "OK");
+    loop_ws.stop();
+    LT_CHECK_EQ(loop_ws.run_once(0), false);
+LT_END_AUTO_TEST(external_event_loop)
+
+LT_BEGIN_AUTO_TEST(basic_suite, rate_limit)
+    webserver limited_ws = create_webserver(8081).rate_limit(0.5, 2);
+    simple_resource* resource = new simple_resource();
+    limited_ws.register_resource("base", resource);
+    limited_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    //the same keep-alive connection for every request
+    CURL *curl = curl_easy_init();
+    map<string, string> headers;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &headers);
+    long http_code[3];
+    for(int i = 0; i < 3; i++)
+    {
+        std::string s;
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+        LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code[i]);
+    }
+    curl_easy_cleanup(curl);
+    LT_CHECK_EQ(http_code[0], 200);
+    LT_CHECK_EQ(http_code[1], 200);
+    LT_CHECK_EQ(http_code[2], 429);
+    LT_CHECK_EQ(headers["Retry-After"], "2");
+
+    //no token left: new connections are refused
+    std::string s;
+    curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    LT_CHECK_NEQ(curl_easy_perform(curl), 0);
+    curl_easy_cleanup(curl);
+
+    limited_ws.stop();
+LT_END_AUTO_TEST(rate_limit)
+
+LT_BEGIN_AUTO_TEST(basic_suite, auto_ban)
+    webserver guarded_ws = create_webserver(8081).auto_ban(3, 60, 300);
+    simple_resource* resource = new simple_resource();
+    guarded_ws.register_resource("base", resource);
+    guarded_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    CURL *curl = curl_easy_init();
+    map<string, string> headers;
+    std::string s;
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/missing");
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, headerfunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEHEADER, &headers);
+    for(int i = 0; i < 3; i++)
+    {
+        long http_code = 0;
+        LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        LT_CHECK_EQ(http_code, 404);
+    }
+    //the banning answer closes the connection
+    LT_CHECK_EQ(headers["Connection"], "close");
+
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    LT_CHECK_NEQ(curl_easy_perform(curl), 0);
+    curl_easy_cleanup(curl);
+
+    guarded_ws.stop();
+LT_END_AUTO_TEST(auto_ban)
+
+LT_BEGIN_AUTO_TEST(basic_suite, metrics_endpoint)
+    webserver measured_ws = create_webserver(8081).metrics_path("/metrics");
+    simple_resource* resource = new simple_resource();
+    measured_ws.register_resource("base", resource);
+    measured_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    CURL *curl = curl_easy_init();
+    std::string s;
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    for(int i = 0; i < 3; i++)
+        LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/missing");
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+
+    s = "";
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/metrics");
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    curl_easy_cleanup(curl);
+    LT_CHECK_NEQ(s.find("httpserver_requests_total{route=\"/base\","
+                "method=\"GET\",code=\"2xx\"} 3\n"), string::npos);
+    LT_CHECK_NEQ(s.find("httpserver_requests_total{route=\"unmatched\","
+                "method=\"GET\",code=\"4xx\"} 1\n"), string::npos);
+    LT_CHECK_NEQ(s.find("httpserver_request_duration_seconds_count{"
+                "route=\"/base\"} 3\n"), string::npos);
+    LT_CHECK_NEQ(s.find("httpserver_connections 1\n"), string::npos);
+    LT_CHECK_NEQ(s.find("httpserver_requests_in_flight 1\n"), string::npos);
+
+    string text;
+    LT_CHECK_EQ(measured_ws.get_metrics(text), true);
+    LT_CHECK_EQ(ws->get_metrics(text), false);
+
+    measured_ws.stop();
+LT_END_AUTO_TEST(metrics_endpoint)
+
+LT_BEGIN_AUTO_TEST(basic_suite, metrics_file_response_bytes)
+    FILE* f = fopen("test_content", "w");
+    fputs("test content of file", f);
+    fclose(f);
+
+    webserver measured_ws = create_webserver(8081).metrics_path("/metrics");
+    file_response_resource* resource = new file_response_resource();
+    measured_ws.register_resource("base", resource);
+    measured_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    CURL *curl = curl_easy_init();
+    std::string s;
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    LT_CHECK_EQ(s, "test content of file");
+
+    s = "";
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/metrics");
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    curl_easy_cleanup(curl);
+    //the size of the file, not the length of its name
+    LT_CHECK_NEQ(s.find("httpserver_sent_bytes_total 20\n"), string::npos);
+
+    measured_ws.stop();
+    remove("test_content");
+LT_END_AUTO_TEST(metrics_file_response_bytes)
+
+std::vector<std::string> access_lines;
+std::string access_batches;
+
+void collect_access_line(const std::string& line)
+{
+    access_lines.push_back(line);
+}
+
+void collect_access_batch(const std::string& lines)
+{
+    access_batches += lines;
+}
+
+LT_BEGIN_AUTO_TEST(basic_suite, access_log)
+    webserver logged_ws = create_webserver(8081)
+        .log_access(collect_access_line)
+        .log_access_batch(collect_access_batch);
+    simple_resource* resource = new simple_resource();
+    logged_ws.register_resource("base", resource);
+    logged_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    CURL *curl = curl_easy_init();
+    std::string s;
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base?x=1");
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/missing");
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    curl_easy_cleanup(curl);
+
+    //stop returns once the served requests are logged
+    logged_ws.stop();
+    LT_ASSERT_EQ(access_lines.size(), 2);
+    LT_CHECK_EQ(access_lines[0].substr(0, 5), "time=");
+    LT_CHECK_NEQ(access_lines[0].find(" client=127.0.0.1 method=GET "
+                "path=\"/base?x=1\" status=200 bytes=2 latency_us="),
+            string::npos);
+    LT_CHECK_NEQ(access_lines[1].find(" path=\"/missing\" status=404 "),
+            string::npos);
+    LT_CHECK_EQ(access_batches, access_lines[0] + "\n" + access_lines[1] + "\n");
+    LT_CHECK_EQ(logged_ws.get_dropped_logs(), 0);
+LT_END_AUTO_TEST(access_log)
+
+class traced_resource : public http_resource
+{
+    public:
+        void render_GET(const http_request& req, http_response** res)
+        {
+            //what a call made from here would carry downstream
+            *res = new http_response(http_response_builder(
+                        req.get_trace()->get_traceparent(), 200, "text/plain"
+            ).string_response());
+        }
+};
+
+struct exported_trace
+{
+    std::string trace_id;
+    std::string parent_id;
+    std::string span_id;
+    int status;
+    std::vector<uint64_t> phases;
+};
+
+std::vector<exported_trace> exported_traces;
+
+void export_trace(const request_trace& trace)
+{
+    exported_trace e;
+    e.trace_id = trace.get_trace_id();
+    e.parent_id = trace.get_parent_id();
+    e.span_id = trace.get_span_id();
+    e.status = trace.get_status();
+    for(int i = 0; i < request_trace::PHASES; i++)
+        e.phases.push_back(trace.get_phase_time((request_trace::phase_T) i));
+    exported_traces.push_back(e);
+}
+
+LT_BEGIN_AUTO_TEST(basic_suite, request_tracing)
+    webserver traced_ws = create_webserver(8081).trace_export(export_trace);
+    traced_resource* resource = new traced_resource();
+    traced_ws.register_resource("base", resource);
+    traced_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    CURL *curl = curl_easy_init();
+    std::string s;
+    struct curl_slist* list = 0x0;
+    list = curl_slist_append(list, "traceparent: "
+            "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01");
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, list);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    curl_slist_free_all(list);
+    curl_easy_cleanup(curl);
+    traced_ws.stop();
+
+    LT_ASSERT_EQ(exported_traces.size(), 1);
+    const exported_trace& e = exported_traces[0];
+    LT_CHECK_EQ(e.trace_id, "4bf92f3577b34da6a3ce929d0e0e4736");
+    LT_CHECK_EQ(e.parent_id, "00f067aa0ba902b7");
+    LT_CHECK_EQ(e.span_id.size(), 16);
+    LT_CHECK_EQ(e.status, 200);
+    //the calls of the resource are children of the request span
+    LT_CHECK_EQ(s, "00-4bf92f3577b34da6a3ce929d0e0e4736-" + e.span_id + "-01");
+    for(int i = 0; i < request_trace::PHASES; i++)
+    {
+        LT_CHECK_GT(e.phases[i], 0);
+        if(i > 0)
+            LT_CHECK_GTE(e.phases[i], e.phases[i - 1]);
+    }
+LT_END_AUTO_TEST(request_tracing)
+
+class sleepy_resource : public http_resource
+{
+    public:
+        void render_GET(const http_request& req, http_response** res)
+        {
+            usleep(50000);
+            *res = new http_response(http_response_builder("zzz", 200,
+                        "text/plain").string_response()
+            );
+        }
+};
+
+LT_BEGIN_AUTO_TEST(basic_suite, slow_requests)
+    webserver recording_ws = create_webserver(8081)
+        .slow_requests(10)
+        .slow_requests_path("/slow");
+    simple_resource* fast = new simple_resource();
+    sleepy_resource* sleepy = new sleepy_resource();
+    recording_ws.register_resource("base", fast);
+    recording_ws.register_resource("sleepy", sleepy);
+    recording_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    CURL *curl = curl_easy_init();
+    std::string s;
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/sleepy");
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+
+    s = "";
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/slow");
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    curl_easy_cleanup(curl);
+    LT_CHECK_NEQ(s.find("method=GET url=\"/sleepy\" route=\"/sleepy\" "
+                "status=200 duration_us="), string::npos);
+    LT_CHECK_EQ(s.find("/base"), string::npos);
+    LT_CHECK_EQ(s.find('\n'), s.size() - 1);
+
+    string text;
+    LT_CHECK_EQ(recording_ws.get_slow_requests(text), true);
+    LT_CHECK_EQ(ws->get_slow_requests(text), false);
+
+    recording_ws.stop();
+LT_END_AUTO_TEST(slow_requests)
+
+int first_dumps = 0;
+int second_dumps = 0;
+
+void count_first_dumps(const std::string& line)
+{
+    if(line.find("slow requests recorded") != std::string::npos)
+        first_dumps++;
+}
+
+void count_second_dumps(const std::string& line)
+{
+    if(line.find("slow requests recorded") != std::string::npos)
+        second_dumps++;
+}
+
+LT_BEGIN_AUTO_TEST(basic_suite, slow_requests_signal)
+    webserver first = create_webserver(8081).slow_requests(10)
+        .slow_requests_signal(SIGUSR2).log_error(count_first_dumps);
+    webserver second = create_webserver(8082).slow_requests(10)
+        .slow_requests_signal(SIGUSR2).log_error(count_second_dumps);
+    first.start(false);
+    second.start(false);
+
+    //both servers dump on the shared signal
+    raise(SIGUSR2);
+    usleep(200000);
+    first.stop();
+    LT_CHECK_EQ(first_dumps, 1);
+
+    //stopping one server leaves the other one listening
+    raise(SIGUSR2);
+    usleep(200000);
+    second.stop();
+    LT_CHECK_EQ(second_dumps, 2);
+    LT_CHECK_EQ(first_dumps, 1);
+LT_END_AUTO_TEST(slow_requests_signal)
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+LT_BEGIN_AUTO_TEST(basic_suite, coroutine_sleep)
+    webserver coroutine_ws = create_webserver(8081).suspend_resume();
+    sleeping_coroutine_resource* resource = new sleeping_coroutine_resource(50);
+    coroutine_ws.register_resource("base", resource);
+    throwing_coroutine_resource* throwing = new throwing_coroutine_resource();
+    coroutine_ws.register_resource("throwing", throwing);
+    coroutine_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    LT_CHECK_EQ(s, "SLEPT");
+    LT_CHECK_EQ(resource->path, "/base");
+
+    //an exception of the coroutine sends the internal error page
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/throwing");
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    LT_CHECK_EQ(http_code, 500);
+    curl_easy_cleanup(curl);
+
+    coroutine_ws.stop();
+LT_END_AUTO_TEST(coroutine_sleep)
+
+LT_BEGIN_AUTO_TEST(basic_suite, coroutine_resume_on)
+    thread_pool_executor pool(1);
+    pool.start();
+    webserver coroutine_ws = create_webserver(8081).suspend_resume();
+    moving_coroutine_resource* resource = new moving_coroutine_resource(&pool);
+    coroutine_ws.register_resource("base", resource);
+    coroutine_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    std::string s;
+    CURL *curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, "localhost:8081/base");
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writefunc);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &s);
+    LT_ASSERT_EQ(curl_easy_perform(curl), 0);
+    LT_CHECK_EQ(s, "MOVED");
+    curl_easy_cleanup(curl);
+
+    coroutine_ws.stop();
+    pool.stop();
+LT_END_AUTO_TEST(coroutine_resume_on)
+
+LT_BEGIN_AUTO_TEST(basic_suite, stop_with_sleeping_coroutine)
+    webserver coroutine_ws = create_webserver(8081).suspend_resume();
+    sleeping_coroutine_resource* resource = new sleeping_coroutine_resource(300);
+    coroutine_ws.register_resource("base", resource);
+    coroutine_ws.start(false);
+
+    curl_global_init(CURL_GLOBAL_ALL);
+    loop_request r;
+    r.done = false;
+    pthread_t client;
+    pthread_create(&client, 0x0, &perform_loop_request, &r);
+    for(int i = 0; i < 500 && !resource->started; i++)
+        usleep(10000);
+    LT_ASSERT_EQ(resource->started, true);
+
+    coroutine_ws.stop();
+    pthread_join(client, 0x0);
+    LT_ASSERT_EQ(r.res, 0);
+    LT_CHECK_EQ(r.body, "Service Unavailable");
+    LT_CHECK_EQ(resource->resumed, false);
+
+    //the coroutine wakes up after the stop, with its request still valid
+    for(int i = 0; i < 500 && !resource->resumed; i++)
+        usleep(10000);
+    LT_CHECK_EQ(resource->resumed, true);
+    LT_CHECK_EQ(resource->path, "/base");
+LT_END_AUTO_TEST(stop_with_sleeping_coroutine)
+#endif
+
 LT_BEGIN_AUTO_TEST_ENV()
     AUTORUN_TESTS()
 LT_END_AUTO_TEST_ENV()
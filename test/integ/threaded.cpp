@@ -22,6 +22,10 @@
 #include <curl/curl.h>
 #include <string>
 #include <map>
+#include <fstream>
+#include <sstream>
+#include <pthread.h>
+#include <unistd.h>
 #include "httpserver.hpp"
 
 using namespace httpserver;
@@ -36,6 +40,47 @@ class ok_resource : public http_resource
         }
 };
 
+struct list_updater
+{
+    webserver* ws;
+    volatile bool stop;
+    int updates;
+};
+
+//bans and unbans addresses, and reloads a list, as a blocklist feed does
+void* update_lists(void* arg)
+{
+    list_updater* u = static_cast<list_updater*>(arg);
+    while(!u->stop)
+    {
+        std::stringstream ip;
+        ip << "10." << (u->updates % 256) << ".0.1";
+        u->ws->ban_ip(ip.str());
+        u->ws->allow_ip("192.168.0.0/16");
+        if(u->updates % 10 == 0)
+            u->ws->load_ip_list("ip_list_test.txt", http::http_utils::REJECT);
+        u->ws->unban_ip(ip.str());
+        u->ws->disallow_ip("192.168.0.0/16");
+        u->updates++;
+    }
+    return 0x0;
+}
+
+static long get_base(int port)
+{
+    std::stringstream url;
+    url << "localhost:" << port << "/base";
+    CURL* curl = curl_easy_init();
+    curl_easy_setopt(curl, CURLOPT_URL, url.str().c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+    CURLcode res = curl_easy_perform(curl);
+    long http_code = 0;
+    if(res == 0)
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+    curl_easy_cleanup(curl);
+    return http_code;
+}
+
 LT_BEGIN_SUITE(threaded_suite)
 
     webserver* ws;
@@ -69,6 +114,54 @@ LT_BEGIN_AUTO_TEST(threaded_suite, base)
     curl_easy_cleanup(curl);
 LT_END_AUTO_TEST(base)
 
+LT_BEGIN_AUTO_TEST(threaded_suite, ip_lists_updated_under_traffic)
+    ok_resource* resource = new ok_resource();
+    ws->register_resource("base", resource);
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    {
+        std::ofstream list("ip_list_test.txt");
+        list << "# blocklist" << std::endl;
+        list << "10.0.0.0/8" << std::endl;
+        list << "  172.16.*.*  # private" << std::endl;
+        list << std::endl;
+        list << "2001:db8::/32" << std::endl;
+    }
+    LT_CHECK_EQ(ws->load_ip_list("ip_list_test.txt", http::http_utils::REJECT), 3);
+
+    list_updater u;
+    u.ws = ws;
+    u.stop = false;
+    u.updates = 0;
+    pthread_t updater;
+    pthread_create(&updater, 0x0, &update_lists, &u);
+
+    int failures = 0;
+    for(int i = 0; i < 200; i++)
+    {
+        if(get_base(8080) != 200)
+            failures++;
+    }
+    u.stop = true;
+    pthread_join(updater, 0x0);
+    LT_CHECK_EQ(failures, 0);
+    LT_CHECK_GT(u.updates, 0);
+
+    ws->ban_ip("127.0.0.1");
+    LT_CHECK_EQ(get_base(8080), 0);
+    ws->unban_ip("127.0.0.1");
+    LT_CHECK_EQ(get_base(8080), 200);
+
+    {
+        std::ofstream list("ip_list_test.txt");
+        list << "127.0.0.0/8" << std::endl;
+        list << "not an address" << std::endl;
+    }
+    LT_CHECK_THROW(ws->load_ip_list("ip_list_test.txt", http::http_utils::REJECT));
+    LT_CHECK_EQ(get_base(8080), 200);
+    unlink("ip_list_test.txt");
+LT_END_AUTO_TEST(ip_lists_updated_under_traffic)
+
 LT_BEGIN_AUTO_TEST_ENV()
     AUTORUN_TESTS()
 LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,96 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "details/abuse_detector.hpp"
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+using namespace httpserver;
+using namespace std;
+
+static struct sockaddr_in ipv4(const char* ip)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+}
+
+LT_BEGIN_SUITE(abuse_detector_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(abuse_detector_suite)
+
+LT_BEGIN_AUTO_TEST(abuse_detector_suite, bans_over_the_threshold)
+    details::abuse_detector detector(3, 60, 300, 1024);
+    struct sockaddr_in a = ipv4("10.0.0.1");
+    struct sockaddr_in b = ipv4("10.0.0.2");
+    LT_CHECK_EQ(detector.record((struct sockaddr*) &a), false);
+    LT_CHECK_EQ(detector.record((struct sockaddr*) &b), false);
+    LT_CHECK_EQ(detector.record((struct sockaddr*) &a), false);
+    LT_CHECK_EQ(detector.banned((struct sockaddr*) &a), false);
+    LT_CHECK_EQ(detector.record((struct sockaddr*) &a), true);
+    LT_CHECK_EQ(detector.banned((struct sockaddr*) &a), true);
+    LT_CHECK_EQ(detector.banned((struct sockaddr*) &b), false);
+    LT_CHECK_EQ(detector.get_bans(), 1);
+
+    //already banned: no new ban
+    for(int i = 0; i < 3; i++)
+        LT_CHECK_EQ(detector.record((struct sockaddr*) &a), false);
+    LT_CHECK_EQ(detector.get_bans(), 1);
+LT_END_AUTO_TEST(bans_over_the_threshold)
+
+LT_BEGIN_AUTO_TEST(abuse_detector_suite, bans_expire)
+    details::abuse_detector detector(2, 60, 1, 1024);
+    struct sockaddr_in a = ipv4("10.0.0.1");
+    detector.record((struct sockaddr*) &a);
+    LT_CHECK_EQ(detector.record((struct sockaddr*) &a), true);
+    LT_CHECK_EQ(detector.banned((struct sockaddr*) &a), true);
+    usleep(1100000);
+    LT_CHECK_EQ(detector.banned((struct sockaddr*) &a), false);
+    //the counters restart from zero after a ban
+    LT_CHECK_EQ(detector.record((struct sockaddr*) &a), false);
+LT_END_AUTO_TEST(bans_expire)
+
+LT_BEGIN_AUTO_TEST(abuse_detector_suite, signals_age_out)
+    details::abuse_detector detector(3, 1, 300, 1024);
+    struct sockaddr_in a = ipv4("10.0.0.1");
+    detector.record((struct sockaddr*) &a);
+    detector.record((struct sockaddr*) &a);
+    //two windows later nothing of the previous signals is left
+    usleep(2100000);
+    LT_CHECK_EQ(detector.record((struct sockaddr*) &a), false);
+    LT_CHECK_EQ(detector.banned((struct sockaddr*) &a), false);
+LT_END_AUTO_TEST(signals_age_out)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,147 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "http_utils.hpp"
+#include "details/admission_gate.hpp"
+
+#include <time.h>
+
+using namespace httpserver;
+using namespace std;
+
+//gives back the slot of the ticket as if the request lasted latency_ms
+static void release_after(details::admission_ticket& ticket, int latency_ms)
+{
+    ticket.since.tv_sec -= latency_ms / 1000;
+    ticket.since.tv_nsec -= (latency_ms % 1000) * 1000000L;
+    if(ticket.since.tv_nsec < 0)
+    {
+        ticket.since.tv_sec--;
+        ticket.since.tv_nsec += 1000000000L;
+    }
+    details::release_ticket(ticket);
+}
+
+static void serve(details::admission_gate& gate, int latency_ms)
+{
+    details::admission_ticket ticket;
+    gate.acquire(ticket, 0x0, false);
+    release_after(ticket, latency_ms);
+}
+
+//takes every slot, gets a request rejected and serves the others
+static void saturate(details::admission_gate& gate, int latency_ms)
+{
+    details::admission_ticket tickets[64];
+    int limit = gate.get_limit();
+    for(int i = 0; i < limit; i++)
+        gate.acquire(tickets[i], 0x0, false);
+    details::admission_ticket over;
+    gate.acquire(over, 0x0, false);
+    for(int i = 0; i < limit; i++)
+        release_after(tickets[i], latency_ms);
+}
+
+LT_BEGIN_SUITE(admission_gate_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(admission_gate_suite)
+
+LT_BEGIN_AUTO_TEST(admission_gate_suite, rejects_over_the_limit)
+    details::admission_gate gate(2, 0, false);
+    details::admission_ticket a, b, c;
+    LT_CHECK_EQ(gate.acquire(a, 0x0, false), details::admission_gate::ADMITTED);
+    LT_CHECK_EQ(gate.acquire(b, 0x0, false), details::admission_gate::ADMITTED);
+    LT_CHECK_EQ(gate.acquire(c, 0x0, true), details::admission_gate::REJECTED);
+    LT_CHECK_EQ(gate.get_in_flight(), 2);
+    LT_CHECK_EQ(gate.get_rejected(), 1);
+
+    details::release_ticket(a);
+    LT_CHECK_EQ(a.gate == 0x0, true);
+    LT_CHECK_EQ(gate.get_in_flight(), 1);
+    LT_CHECK_EQ(gate.acquire(c, 0x0, false), details::admission_gate::ADMITTED);
+
+    details::release_ticket(b);
+    details::release_ticket(c);
+    //a ticket without a slot is ignored
+    details::release_ticket(c);
+    LT_CHECK_EQ(gate.get_in_flight(), 0);
+LT_END_AUTO_TEST(rejects_over_the_limit)
+
+LT_BEGIN_AUTO_TEST(admission_gate_suite, rejected_waiters_close_the_queue)
+    details::admission_gate gate(1, 4, false);
+    details::admission_ticket a, b;
+    LT_CHECK_EQ(gate.acquire(a, 0x0, false), details::admission_gate::ADMITTED);
+    gate.reject_waiters();
+    //a stopping server cannot suspend the connection anymore
+    LT_CHECK_EQ(gate.acquire(b, 0x0, true), details::admission_gate::REJECTED);
+    LT_CHECK_EQ(gate.get_queued(), 0);
+    gate.reopen();
+    details::release_ticket(a);
+    LT_CHECK_EQ(gate.acquire(b, 0x0, true), details::admission_gate::ADMITTED);
+    details::release_ticket(b);
+LT_END_AUTO_TEST(rejected_waiters_close_the_queue)
+
+LT_BEGIN_AUTO_TEST(admission_gate_suite, fixed_limit_ignores_latency)
+    details::admission_gate gate(10, 0, false);
+    for(int i = 0; i < 64; i++)
+        serve(gate, 500);
+    LT_CHECK_EQ(gate.get_limit(), 10);
+LT_END_AUTO_TEST(fixed_limit_ignores_latency)
+
+LT_BEGIN_AUTO_TEST(admission_gate_suite, adaptive_limit)
+    details::admission_gate gate(20, 0, true);
+    for(int i = 0; i < 32; i++)
+        serve(gate, 10);
+    LT_CHECK_EQ(gate.get_limit(), 20);
+
+    //latency over twice the lowest observed: multiplicative decrease
+    for(int i = 0; i < 32; i++)
+        serve(gate, 50);
+    LT_CHECK_EQ(gate.get_limit(), 18);
+    for(int i = 0; i < 32; i++)
+        serve(gate, 50);
+    LT_CHECK_EQ(gate.get_limit(), 17);
+
+    //latency back to normal while saturated: additive increase
+    saturate(gate, 10);
+    for(int i = 0; i < 32 - 17; i++)
+        serve(gate, 10);
+    LT_CHECK_EQ(gate.get_limit(), 18);
+
+    //never over the configured maximum
+    for(int i = 0; i < 10; i++)
+    {
+        saturate(gate, 10);
+        for(int j = gate.get_limit(); j < 32; j++)
+            serve(gate, 10);
+    }
+    LT_CHECK_EQ(gate.get_limit(), 20);
+LT_END_AUTO_TEST(adaptive_limit)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,356 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "executor.hpp"
+#include "details/atomics.hpp"
+#include "details/work_stealing_deque.hpp"
+#include "details/priority_fifo.hpp"
+
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace httpserver;
+using namespace std;
+
+class counting_task: public executor_task
+{
+    public:
+        explicit counting_task(int* counter):
+            counter(counter)
+        {
+        }
+
+        void run()
+        {
+            atomic_increment(counter);
+        }
+
+    private:
+        int* counter;
+};
+
+class spawning_task: public executor_task
+{
+    public:
+        spawning_task(executor* pool, int* counter, int depth):
+            pool(pool),
+            counter(counter),
+            depth(depth)
+        {
+        }
+
+        void run()
+        {
+            atomic_increment(counter);
+            if(depth > 0)
+            {
+                pool->submit(new spawning_task(pool, counter, depth - 1));
+                pool->submit(new spawning_task(pool, counter, depth - 1));
+            }
+        }
+
+    private:
+        executor* pool;
+        int* counter;
+        int depth;
+};
+
+class ordering_task: public executor_task
+{
+    public:
+        ordering_task(vector<int>* order, int id):
+            order(order),
+            id(id)
+        {
+        }
+
+        void run()
+        {
+            order->push_back(id);
+        }
+
+    private:
+        vector<int>* order;
+        int id;
+};
+
+#define DEQUE_ITEMS 100000
+#define THIEVES 3
+#define STRESS_THIEVES 8
+#define STRESS_ROUNDS 20
+
+struct deque_test
+{
+    details::work_stealing_deque<int> deque;
+    int items[DEQUE_ITEMS];
+    int seen[DEQUE_ITEMS];
+    volatile bool done;
+
+    deque_test(long capacity = 4):
+        deque(capacity),
+        done(false)
+    {
+        for(int i = 0; i < DEQUE_ITEMS; i++)
+        {
+            items[i] = i;
+            seen[i] = 0;
+        }
+    }
+
+    void consume(int* item)
+    {
+        atomic_increment(&seen[*item]);
+    }
+};
+
+void* thief(void* arg)
+{
+    deque_test* test = static_cast<deque_test*>(arg);
+    while(!test->done || !test->deque.empty())
+    {
+        int* item = test->deque.steal();
+        if(item != 0x0)
+            test->consume(item);
+    }
+    return 0x0;
+}
+
+LT_BEGIN_SUITE(executor_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(executor_suite)
+
+LT_BEGIN_AUTO_TEST(executor_suite, runs_all_tasks)
+    int counter = 0;
+    thread_pool_executor pool(4);
+    pool.start();
+    for(int i = 0; i < 1000; i++)
+        pool.submit(new counting_task(&counter));
+    pool.stop();
+    LT_CHECK_EQ(counter, 1000);
+LT_END_AUTO_TEST(runs_all_tasks)
+
+LT_BEGIN_AUTO_TEST(executor_suite, stop_runs_tasks_submitted_before_start)
+    int counter = 0;
+    thread_pool_executor pool(2);
+    pool.submit(new counting_task(&counter));
+    pool.stop();
+    LT_CHECK_EQ(counter, 1);
+LT_END_AUTO_TEST(stop_runs_tasks_submitted_before_start)
+
+LT_BEGIN_AUTO_TEST(executor_suite, restart)
+    int counter = 0;
+    thread_pool_executor pool(2);
+    pool.start();
+    pool.submit(new counting_task(&counter));
+    pool.stop();
+    pool.start();
+    pool.submit(new counting_task(&counter));
+    pool.stop();
+    LT_CHECK_EQ(counter, 2);
+LT_END_AUTO_TEST(restart)
+
+LT_BEGIN_AUTO_TEST(executor_suite, deque_items_are_taken_once)
+    deque_test* test = new deque_test();
+    pthread_t thieves[THIEVES];
+    for(int i = 0; i < THIEVES; i++)
+        pthread_create(&thieves[i], 0x0, &thief, test);
+    for(int i = 0; i < DEQUE_ITEMS; i++)
+    {
+        test->deque.push(&test->items[i]);
+        if(i % 3 == 0)
+        {
+            int* item = test->deque.take();
+            if(item != 0x0)
+                test->consume(item);
+        }
+    }
+    int* item;
+    while((item = test->deque.take()) != 0x0)
+        test->consume(item);
+    test->done = true;
+    for(int i = 0; i < THIEVES; i++)
+        pthread_join(thieves[i], 0x0);
+
+    int wrong = 0;
+    for(int i = 0; i < DEQUE_ITEMS; i++)
+        if(test->seen[i] != 1)
+            wrong++;
+    LT_CHECK_EQ(wrong, 0);
+    delete test;
+LT_END_AUTO_TEST(deque_items_are_taken_once)
+
+LT_BEGIN_AUTO_TEST(executor_suite, deque_grows_while_stolen)
+    int wrong = 0;
+    for(int round = 0; round < STRESS_ROUNDS; round++)
+    {
+        //growing from two slots, the array is replaced while many thieves
+        //read it
+        deque_test* test = new deque_test(2);
+        pthread_t thieves[STRESS_THIEVES];
+        for(int i = 0; i < STRESS_THIEVES; i++)
+            pthread_create(&thieves[i], 0x0, &thief, test);
+        for(int i = 0; i < DEQUE_ITEMS; i++)
+        {
+            test->deque.push(&test->items[i]);
+            if(i % 64 == 0)
+            {
+                int* item = test->deque.take();
+                if(item != 0x0)
+                    test->consume(item);
+            }
+        }
+        test->done = true;
+        for(int i = 0; i < STRESS_THIEVES; i++)
+            pthread_join(thieves[i], 0x0);
+        int* item;
+        while((item = test->deque.take()) != 0x0)
+            test->consume(item);
+
+        for(int i = 0; i < DEQUE_ITEMS; i++)
+            if(test->seen[i] != 1)
+                wrong++;
+        delete test;
+    }
+    LT_CHECK_EQ(wrong, 0);
+LT_END_AUTO_TEST(deque_grows_while_stolen)
+
+LT_BEGIN_AUTO_TEST(executor_suite, work_stealing_runs_all_tasks)
+    int counter = 0;
+    work_stealing_executor pool(8);
+    pool.start();
+    for(int i = 0; i < 10000; i++)
+        pool.submit(new counting_task(&counter));
+    pool.stop();
+    LT_CHECK_EQ(counter, 10000);
+LT_END_AUTO_TEST(work_stealing_runs_all_tasks)
+
+LT_BEGIN_AUTO_TEST(executor_suite, work_stealing_runs_spawned_tasks)
+    int counter = 0;
+    work_stealing_executor pool(4);
+    pool.start();
+    pool.submit(new spawning_task(&pool, &counter, 12));
+    while(__sync_fetch_and_add(&counter, 0) < (1 << 13) - 1)
+        usleep(1000);
+    pool.stop();
+    LT_CHECK_EQ(counter, (1 << 13) - 1);
+LT_END_AUTO_TEST(work_stealing_runs_spawned_tasks)
+
+LT_BEGIN_AUTO_TEST(executor_suite, work_stealing_restart)
+    int counter = 0;
+    work_stealing_executor pool(2);
+    pool.submit(new counting_task(&counter));
+    pool.stop();
+    pool.start();
+    pool.submit(new counting_task(&counter));
+    pool.stop();
+    LT_CHECK_EQ(counter, 2);
+LT_END_AUTO_TEST(work_stealing_restart)
+
+LT_BEGIN_AUTO_TEST(executor_suite, priority_fifo_order)
+    details::priority_fifo<int> fifo;
+    fifo.push(1, LOW_PRIORITY);
+    fifo.push(2, NORMAL_PRIORITY);
+    fifo.push(3, HIGH_PRIORITY);
+    fifo.push(4, NORMAL_PRIORITY);
+    fifo.push(5, HIGH_PRIORITY);
+    int expected[5] = {3, 5, 2, 4, 1};
+    for(int i = 0; i < 5; i++)
+    {
+        int item;
+        LT_CHECK_EQ(fifo.pop(item), true);
+        LT_CHECK_EQ(item, expected[i]);
+    }
+    LT_CHECK_EQ(fifo.empty(), true);
+LT_END_AUTO_TEST(priority_fifo_order)
+
+LT_BEGIN_AUTO_TEST(executor_suite, priority_fifo_no_starvation)
+    details::priority_fifo<int> fifo;
+    fifo.push(-1, LOW_PRIORITY);
+    for(int i = 0; i < 2 * PRIORITY_STARVATION_LIMIT; i++)
+        fifo.push(i, HIGH_PRIORITY);
+    int position = -1;
+    for(int i = 0; i <= 2 * PRIORITY_STARVATION_LIMIT; i++)
+    {
+        int item;
+        fifo.pop(item);
+        if(item == -1)
+            position = i;
+    }
+    LT_CHECK_EQ(position, PRIORITY_STARVATION_LIMIT);
+LT_END_AUTO_TEST(priority_fifo_no_starvation)
+
+LT_BEGIN_AUTO_TEST(executor_suite, priority_fifo_evict)
+    details::priority_fifo<int> fifo;
+    int item;
+    fifo.push(1, NORMAL_PRIORITY);
+    LT_CHECK_EQ(fifo.evict_below(NORMAL_PRIORITY, item), false);
+    fifo.push(2, LOW_PRIORITY);
+    fifo.push(3, LOW_PRIORITY);
+    LT_CHECK_EQ(fifo.evict_below(HIGH_PRIORITY, item), true);
+    LT_CHECK_EQ(item, 3);
+    LT_CHECK_EQ(fifo.remove(2), true);
+    LT_CHECK_EQ(fifo.size(), 1);
+LT_END_AUTO_TEST(priority_fifo_evict)
+
+LT_BEGIN_AUTO_TEST(executor_suite, thread_pool_priorities)
+    vector<int> order;
+    thread_pool_executor pool(1);
+    pool.submit(new ordering_task(&order, 3), LOW_PRIORITY);
+    pool.submit(new ordering_task(&order, 2));
+    pool.submit(new ordering_task(&order, 1), HIGH_PRIORITY);
+    pool.stop();
+    LT_ASSERT_EQ(order.size(), 3);
+    LT_CHECK_EQ(order[0], 1);
+    LT_CHECK_EQ(order[1], 2);
+    LT_CHECK_EQ(order[2], 3);
+LT_END_AUTO_TEST(thread_pool_priorities)
+
+LT_BEGIN_AUTO_TEST(executor_suite, work_stealing_priorities)
+    vector<int> order;
+    work_stealing_executor pool(1);
+    pool.submit(new ordering_task(&order, 3), LOW_PRIORITY);
+    pool.submit(new ordering_task(&order, 2));
+    pool.submit(new ordering_task(&order, 1), HIGH_PRIORITY);
+    pool.stop();
+    LT_ASSERT_EQ(order.size(), 3);
+    LT_CHECK_EQ(order[0], 1);
+    LT_CHECK_EQ(order[1], 2);
+    LT_CHECK_EQ(order[2], 3);
+
+    //with a running worker
+    int counter = 0;
+    pool.start();
+    for(int i = 0; i < 3000; i++)
+        pool.submit(new counting_task(&counter), (priority_T) (i % 3));
+    pool.stop();
+    LT_CHECK_EQ(counter, 3000);
+LT_END_AUTO_TEST(work_stealing_priorities)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,144 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "details/flight_recorder.hpp"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+using namespace httpserver;
+using namespace std;
+
+static void record(details::flight_recorder* recorder, uint64_t start,
+        uint64_t duration
+)
+{
+    details::slow_request* r = recorder->reserve();
+    memset(r, 0, sizeof(details::slow_request));
+    r->start_time = start;
+    for(int i = 0; i < request_trace::PHASES; i++)
+        r->phases[i] = duration * i / (request_trace::PHASES - 1);
+    snprintf(r->url, sizeof(r->url), "/%llu", (unsigned long long) start);
+    r->thread = (unsigned long) pthread_self();
+    recorder->commit();
+}
+
+struct thread_args
+{
+    details::flight_recorder* recorder;
+    uint64_t first;
+};
+
+static void* record_from_thread(void* arg)
+{
+    thread_args* args = static_cast<thread_args*>(arg);
+    //the threads complete their requests one after the other
+    for(uint64_t i = 0; i < 5; i++)
+        record(args->recorder, args->first + i * 10, 1000);
+    return 0x0;
+}
+
+LT_BEGIN_SUITE(flight_recorder_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(flight_recorder_suite)
+
+LT_BEGIN_AUTO_TEST(flight_recorder_suite, threshold)
+    details::flight_recorder recorder(5000, 4);
+    LT_CHECK_EQ(recorder.is_slow(4999), false);
+    LT_CHECK_EQ(recorder.is_slow(5000), true);
+    vector<details::slow_request> requests;
+    recorder.get_requests(requests);
+    LT_CHECK_EQ(requests.size(), 0);
+LT_END_AUTO_TEST(threshold)
+
+LT_BEGIN_AUTO_TEST(flight_recorder_suite, keeps_the_last)
+    details::flight_recorder recorder(1000, 4);
+    for(uint64_t i = 1; i <= 10; i++)
+        record(&recorder, i * 10000, 5000);
+    vector<details::slow_request> requests;
+    recorder.get_requests(requests);
+    LT_ASSERT_EQ(requests.size(), 4);
+    for(int i = 0; i < 4; i++)
+        LT_CHECK_EQ(requests[i].start_time, (uint64_t) (7 + i) * 10000);
+LT_END_AUTO_TEST(keeps_the_last)
+
+LT_BEGIN_AUTO_TEST(flight_recorder_suite, merges_threads)
+    details::flight_recorder recorder(1000, 4);
+    pthread_t threads[3];
+    thread_args args[3];
+    for(int i = 0; i < 3; i++)
+    {
+        args[i].recorder = &recorder;
+        args[i].first = 1000000 + i;
+        pthread_create(&threads[i], NULL, &record_from_thread, &args[i]);
+    }
+    for(int i = 0; i < 3; i++)
+        pthread_join(threads[i], NULL);
+
+    vector<details::slow_request> requests;
+    recorder.get_requests(requests);
+    LT_ASSERT_EQ(requests.size(), 4);
+    //the last request of each thread and the one before of the third
+    LT_CHECK_EQ(requests[0].start_time, 1000032);
+    LT_CHECK_EQ(requests[1].start_time, 1000040);
+    LT_CHECK_EQ(requests[2].start_time, 1000041);
+    LT_CHECK_EQ(requests[3].start_time, 1000042);
+LT_END_AUTO_TEST(merges_threads)
+
+LT_BEGIN_AUTO_TEST(flight_recorder_suite, render_request)
+    details::slow_request r;
+    memset(&r, 0, sizeof(r));
+    r.start_time = 1500000;
+    for(int i = 0; i < request_trace::PHASES; i++)
+        r.phases[i] = i * 100;
+    r.phases[request_trace::ROUTED] = SLOW_REQUEST_NOT_REACHED;
+    r.thread = 0x2a;
+    r.status = 503;
+    strcpy(r.method, "GET");
+    strcpy(r.url, "/a\"b");
+    strcpy(r.trace_id, "4bf92f3577b34da6a3ce929d0e0e4736");
+    r.request_headers = 3;
+    r.request_header_bytes = 80;
+    r.response_headers = 1;
+    r.response_header_bytes = 20;
+
+    string line;
+    details::flight_recorder::render_request(line, r);
+    LT_CHECK_EQ(line, "time=1970-01-01T00:00:01.500000Z thread=0x2a "
+            "trace_id=4bf92f3577b34da6a3ce929d0e0e4736 method=GET "
+            "url=\"/a\\\"b\" route=- status=503 duration_us=600 "
+            "parsed_us=100 routed_us=- rendered_us=300 response_built_us=400 "
+            "enqueued_us=500 request_headers=3 request_header_bytes=80 "
+            "response_headers=1 response_header_bytes=20\n");
+LT_END_AUTO_TEST(render_request)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
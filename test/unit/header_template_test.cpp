@@ -0,0 +1,71 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "http_utils.hpp"
+#include "header_template.hpp"
+
+using namespace httpserver;
+using namespace std;
+
+LT_BEGIN_SUITE(header_template_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(header_template_suite)
+
+LT_BEGIN_AUTO_TEST(header_template_suite, valid_entries)
+    header_template t;
+    t.with_header("Cache-Control", "no-cache")
+        .with_header("X-Frame-Options", "DENY")
+        .with_footer("X-Checksum", "abc")
+        .with_cookie("session", "1234");
+    LT_CHECK_EQ(t.size(), 4);
+LT_END_AUTO_TEST(valid_entries)
+
+LT_BEGIN_AUTO_TEST(header_template_suite, invalid_header_name)
+    header_template t;
+    LT_CHECK_THROW(t.with_header("", "value"));
+    LT_CHECK_THROW(t.with_header("Bad Name", "value"));
+    LT_CHECK_THROW(t.with_header("Bad:Name", "value"));
+    LT_CHECK_EQ(t.size(), 0);
+LT_END_AUTO_TEST(invalid_header_name)
+
+LT_BEGIN_AUTO_TEST(header_template_suite, invalid_header_value)
+    header_template t;
+    LT_CHECK_THROW(t.with_header("Key", "value\r\nInjected: yes"));
+    LT_CHECK_THROW(t.with_footer("Key", "value\n"));
+    LT_CHECK_EQ(t.size(), 0);
+LT_END_AUTO_TEST(invalid_header_value)
+
+LT_BEGIN_AUTO_TEST(header_template_suite, invalid_cookie)
+    header_template t;
+    LT_CHECK_THROW(t.with_cookie("name", "a;b"));
+    LT_CHECK_THROW(t.with_cookie("na=me", "value"));
+    LT_CHECK_EQ(t.size(), 0);
+LT_END_AUTO_TEST(invalid_cookie)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
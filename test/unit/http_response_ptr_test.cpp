@@ -0,0 +1,105 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "httpserver.hpp"
+#include "details/http_response_ptr.hpp"
+
+#include <cstdlib>
+#include <new>
+
+using namespace httpserver;
+using namespace std;
+
+#if __cplusplus >= 201103L
+#define THROWS_BAD_ALLOC
+#define THROWS_NOTHING noexcept
+#else
+#define THROWS_BAD_ALLOC throw(std::bad_alloc)
+#define THROWS_NOTHING throw()
+#endif
+
+static int allocations = 0;
+
+void* operator new(size_t size) THROWS_BAD_ALLOC
+{
+    allocations++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if(p == 0x0)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) THROWS_NOTHING
+{
+    free(p);
+}
+
+LT_BEGIN_SUITE(http_response_ptr_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(http_response_ptr_suite)
+
+LT_BEGIN_AUTO_TEST(http_response_ptr_suite, empty_does_not_allocate)
+    int before = allocations;
+    {
+        details::http_response_ptr empty(0x0);
+        details::http_response_ptr copy(empty);
+        details::http_response_ptr assigned;
+        assigned = copy;
+    }
+    LT_CHECK_EQ(allocations - before, 0);
+LT_END_AUTO_TEST(empty_does_not_allocate)
+
+LT_BEGIN_AUTO_TEST(http_response_ptr_suite, copies_do_not_allocate)
+    http_response* res = new http_response(
+            http_response_builder("content", 200).string_response()
+    );
+    int before = allocations;
+    {
+        details::http_response_ptr owner(res);
+        details::http_response_ptr copy(owner);
+        details::http_response_ptr assigned;
+        assigned = copy;
+        LT_CHECK_EQ(owner.ptr() == res, true);
+        LT_CHECK_EQ(assigned.ptr() == res, true);
+        LT_CHECK_EQ(allocations - before, 0);
+    }
+LT_END_AUTO_TEST(copies_do_not_allocate)
+
+LT_BEGIN_AUTO_TEST(http_response_ptr_suite, last_reference_releases)
+    details::http_response_ptr outer;
+    {
+        details::http_response_ptr inner(new http_response(
+                http_response_builder("content", 200).string_response()
+        ));
+        outer = inner;
+    }
+    LT_CHECK_EQ(outer->get_response_code(), 200);
+LT_END_AUTO_TEST(last_reference_releases)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,204 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "http_utils.hpp"
+#include "details/ip_filter.hpp"
+
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <set>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+using namespace httpserver;
+using namespace std;
+
+static string ipv4(unsigned int a)
+{
+    char s[16];
+    sprintf(s, "%u.%u.%u.%u", a >> 24, (a >> 16) & 0xFF, (a >> 8) & 0xFF,
+            a & 0xFF);
+    return s;
+}
+
+LT_BEGIN_SUITE(ip_filter_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(ip_filter_suite)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, single_addresses)
+    details::ip_filter f;
+    LT_CHECK_EQ(f.empty(), true);
+    LT_CHECK_EQ(f.contains("127.0.0.1"), false);
+    f.insert("127.0.0.1");
+    f.insert("10.0.0.2");
+    f.insert("2001:db8::1");
+    LT_CHECK_EQ(f.size(), 3);
+    LT_CHECK_EQ(f.contains("127.0.0.1"), true);
+    LT_CHECK_EQ(f.contains("127.0.0.2"), false);
+    LT_CHECK_EQ(f.contains("10.0.0.2"), true);
+    LT_CHECK_EQ(f.contains("2001:db8::1"), true);
+    LT_CHECK_EQ(f.contains("2001:0db8:0:0:0:0:0:1"), true);
+    LT_CHECK_EQ(f.contains("2001:db8::2"), false);
+    f.insert("127.0.0.1");
+    LT_CHECK_EQ(f.size(), 3);
+LT_END_AUTO_TEST(single_addresses)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, cidr)
+    details::ip_filter f;
+    f.insert("10.0.0.0/8");
+    f.insert("192.168.1.128/25");
+    f.insert("2001:db8::/32");
+    LT_CHECK_EQ(f.contains("10.255.3.4"), true);
+    LT_CHECK_EQ(f.contains("11.0.0.0"), false);
+    LT_CHECK_EQ(f.contains("192.168.1.128"), true);
+    LT_CHECK_EQ(f.contains("192.168.1.255"), true);
+    LT_CHECK_EQ(f.contains("192.168.1.127"), false);
+    LT_CHECK_EQ(f.contains("2001:db8:ffff::1"), true);
+    LT_CHECK_EQ(f.contains("2001:db9::1"), false);
+    //host bits are ignored
+    f.insert("172.16.5.5/12");
+    LT_CHECK_EQ(f.contains("172.31.0.1"), true);
+    LT_CHECK_EQ(f.contains("172.32.0.1"), false);
+LT_END_AUTO_TEST(cidr)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, wildcards)
+    details::ip_filter f;
+    f.insert("192.168.*.*");
+    LT_CHECK_EQ(f.size(), 1);
+    LT_CHECK_EQ(f.contains("192.168.7.9"), true);
+    LT_CHECK_EQ(f.contains("192.169.7.9"), false);
+    f.insert("8.*.8.8");
+    LT_CHECK_EQ(f.size(), 257);
+    LT_CHECK_EQ(f.contains("8.123.8.8"), true);
+    LT_CHECK_EQ(f.contains("8.123.8.9"), false);
+    f.insert("2001:db8:*:*:*:*:*:*");
+    LT_CHECK_EQ(f.contains("2001:db8:1::1"), true);
+    f.insert("*.*.*.*");
+    LT_CHECK_EQ(f.contains("1.2.3.4"), true);
+    LT_CHECK_EQ(f.contains("2001:db9::1"), false);
+    LT_CHECK_THROW(f.insert("*.*.*.1"));
+LT_END_AUTO_TEST(wildcards)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, mapped_addresses)
+    details::ip_filter f;
+    f.insert("10.0.0.0/8");
+    f.insert("::ffff:192.168.0.1");
+
+    struct sockaddr_in v4;
+    memset(&v4, 0, sizeof(v4));
+    v4.sin_family = AF_INET;
+    inet_pton(AF_INET, "192.168.0.1", &v4.sin_addr);
+    LT_CHECK_EQ(f.contains((struct sockaddr*) &v4), true);
+
+    struct sockaddr_in6 v6;
+    memset(&v6, 0, sizeof(v6));
+    v6.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, "::ffff:10.1.2.3", &v6.sin6_addr);
+    LT_CHECK_EQ(f.contains((struct sockaddr*) &v6), true);
+    inet_pton(AF_INET6, "::10.1.2.3", &v6.sin6_addr);
+    LT_CHECK_EQ(f.contains((struct sockaddr*) &v6), false);
+LT_END_AUTO_TEST(mapped_addresses)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, removal)
+    details::ip_filter f;
+    f.insert("10.0.0.0/8");
+    f.insert("10.1.0.0/16");
+    f.insert("10.1.2.3");
+    f.remove("10.0.0.0/8");
+    LT_CHECK_EQ(f.size(), 2);
+    LT_CHECK_EQ(f.contains("10.2.0.1"), false);
+    LT_CHECK_EQ(f.contains("10.1.9.9"), true);
+    f.remove("10.1.*.*");
+    LT_CHECK_EQ(f.contains("10.1.9.9"), false);
+    LT_CHECK_EQ(f.contains("10.1.2.3"), true);
+    f.remove("10.1.2.4");
+    LT_CHECK_EQ(f.size(), 1);
+    f.remove("10.1.2.3");
+    LT_CHECK_EQ(f.empty(), true);
+    LT_CHECK_EQ(f.contains("10.1.2.3"), false);
+LT_END_AUTO_TEST(removal)
+
+LT_BEGIN_AUTO_TEST(ip_filter_suite, bad_format)
+    details::ip_filter f;
+    LT_CHECK_THROW(f.insert("10.0.0"));
+    LT_CHECK_THROW(f.insert("10.0.0.256"));
+    LT_CHECK_THROW(f.insert("10.0.0.1/33"));
+    LT_CHECK_THROW(f.insert("10.0.0.1/"));
+    LT_CHECK_THROW(f.insert("2001:db8::1::2"));
+    LT_CHECK_THROW(f.insert("2001:db8:1:2:3:4:5:6:7"));
+    LT_CHECK_THROW(f.insert("2001:db8g::1"));
+    LT_CHECK_THROW(f.insert("1.2.3.4::"));
+    LT_CHECK_EQ(f.empty(), true);
+LT_END_AUTO_TEST(bad_format)
+
+//random prefixes, inserted and removed, checked against a linear scan
+LT_BEGIN_AUTO_TEST(ip_filter_suite, matches_linear_scan)
+    details::ip_filter f;
+    vector<pair<unsigned int, int> > inserted;
+    set<pair<unsigned int, int> > rules;
+    srand(42);
+    for(int i = 0; i < 2000; i++)
+    {
+        int length = 12 + rand() % 21;
+        unsigned int prefix = (((unsigned int) rand() << 1) & 0x00FFFFFFu) |
+            0x0A000000u;
+        prefix &= 0xFFFFFFFFu << (32 - length);
+        char rule[32];
+        sprintf(rule, "/%d", length);
+        f.insert(ipv4(prefix) + rule);
+        inserted.push_back(make_pair(prefix, length));
+        rules.insert(make_pair(prefix, length));
+    }
+    for(int i = 0; i < 1000; i++)
+    {
+        char rule[32];
+        sprintf(rule, "/%d", inserted[i].second);
+        f.remove(ipv4(inserted[i].first) + rule);
+        rules.erase(inserted[i]);
+    }
+    LT_CHECK_EQ(f.size(), rules.size());
+
+    int mismatches = 0;
+    for(int i = 0; i < 20000; i++)
+    {
+        unsigned int addr = (((unsigned int) rand() << 1) & 0x00FFFFFFu) |
+            0x0A000000u;
+        bool expected = false;
+        for(set<pair<unsigned int, int> >::iterator it = rules.begin();
+                it != rules.end() && !expected; ++it)
+            expected = (addr & (0xFFFFFFFFu << (32 - it->second))) == it->first;
+        if(f.contains(ipv4(addr)) != expected)
+            mismatches++;
+    }
+    LT_CHECK_EQ(mismatches, 0);
+LT_END_AUTO_TEST(matches_linear_scan)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,174 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "details/log_sink.hpp"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <set>
+
+using namespace httpserver;
+using namespace std;
+
+struct collected
+{
+    pthread_mutex_t guard;
+    set<string> texts;
+    size_t batches;
+    volatile bool hold;
+};
+
+static void collect(void* cls, const details::log_record* records,
+        size_t count
+)
+{
+    collected* c = static_cast<collected*>(cls);
+    while(c->hold)
+        usleep(1000);
+    pthread_mutex_lock(&c->guard);
+    for(size_t i = 0; i < count; i++)
+        c->texts.insert(records[i].text);
+    c->batches++;
+    pthread_mutex_unlock(&c->guard);
+}
+
+static bool log_text(details::log_sink* sink, const char* prefix, int i)
+{
+    details::log_record* record = sink->reserve();
+    if(record == 0x0)
+        return false;
+    record->kind = details::log_record::ACCESS_LOG;
+    snprintf(record->text, sizeof(record->text), "%s%d", prefix, i);
+    sink->commit();
+    return true;
+}
+
+static void* log_from_thread(void* sink)
+{
+    char prefix[32];
+    snprintf(prefix, sizeof(prefix), "%lu-", (unsigned long) pthread_self());
+    int logged = 0;
+    while(logged < 2000)
+    {
+        if(log_text(static_cast<details::log_sink*>(sink), prefix, logged))
+            logged++;
+        else
+            usleep(100);
+    }
+    return 0x0;
+}
+
+LT_BEGIN_SUITE(log_sink_suite)
+    collected c;
+
+    void set_up()
+    {
+        pthread_mutex_init(&c.guard, NULL);
+        c.texts.clear();
+        c.batches = 0;
+        c.hold = false;
+    }
+
+    void tear_down()
+    {
+        pthread_mutex_destroy(&c.guard);
+    }
+LT_END_SUITE(log_sink_suite)
+
+LT_BEGIN_AUTO_TEST(log_sink_suite, delivers_every_thread)
+    details::log_sink sink(64, &collect, &c);
+    pthread_t threads[4];
+    for(int i = 0; i < 4; i++)
+        pthread_create(&threads[i], 0x0, &log_from_thread, &sink);
+    for(int i = 0; i < 4; i++)
+        pthread_join(threads[i], 0x0);
+    sink.flush();
+    LT_CHECK_EQ(c.texts.size(), 8000);
+    //full rings made the threads retry; records come in batches
+    LT_CHECK_LT(c.batches, 8000);
+LT_END_AUTO_TEST(delivers_every_thread)
+
+LT_BEGIN_AUTO_TEST(log_sink_suite, full_ring_drops)
+    details::log_sink sink(8, &collect, &c);
+    c.hold = true;
+    int logged = 0;
+    for(int i = 0; i < 100; i++)
+        logged += log_text(&sink, "", i) ? 1 : 0;
+    //the drain thread may have taken a batch before holding
+    LT_CHECK_LTE(logged, 16);
+    LT_CHECK_EQ(sink.get_dropped(), (unsigned long) (100 - logged));
+    c.hold = false;
+    sink.flush();
+    LT_CHECK_EQ(c.texts.size(), (size_t) logged);
+LT_END_AUTO_TEST(full_ring_drops)
+
+LT_BEGIN_AUTO_TEST(log_sink_suite, destruction_delivers_pending)
+    {
+        details::log_sink sink(16, &collect, &c);
+        for(int i = 0; i < 10; i++)
+            log_text(&sink, "", i);
+    }
+    LT_CHECK_EQ(c.texts.size(), 10);
+LT_END_AUTO_TEST(destruction_delivers_pending)
+
+LT_BEGIN_AUTO_TEST(log_sink_suite, throttle_per_template)
+    details::log_throttle throttle(3);
+    const char* storm = "connection reset: %s";
+    const char* other = "out of memory";
+    unsigned long suppressed = 1;
+    int admitted = 0;
+    for(int i = 0; i < 10; i++)
+        admitted += throttle.admit(storm, suppressed) ? 1 : 0;
+    //a second boundary may fall in the loop
+    LT_CHECK_GTE(admitted, 3);
+    LT_CHECK_LTE(admitted, 6);
+    LT_CHECK_EQ(throttle.admit(other, suppressed), true);
+    LT_CHECK_EQ(suppressed, 0);
+
+    usleep(1100000);
+    LT_CHECK_EQ(throttle.admit(storm, suppressed), true);
+    LT_CHECK_EQ(suppressed, (unsigned long) (10 - admitted));
+LT_END_AUTO_TEST(throttle_per_template)
+
+LT_BEGIN_AUTO_TEST(log_sink_suite, unthrottled)
+    details::log_throttle throttle(0);
+    unsigned long suppressed;
+    for(int i = 0; i < 1000; i++)
+        LT_CHECK_EQ(throttle.admit("same", suppressed), true);
+LT_END_AUTO_TEST(unthrottled)
+
+LT_BEGIN_AUTO_TEST(log_sink_suite, crowded_throttle)
+    details::log_throttle throttle(1);
+    static char templates[LOG_THROTTLE_TEMPLATES * 4];
+    unsigned long suppressed;
+    int admitted = 0;
+    for(int i = 0; i < LOG_THROTTLE_TEMPLATES * 4; i++)
+        admitted += throttle.admit(&templates[i], suppressed) ? 1 : 0;
+    //templates sharing a slot share the limit too
+    LT_CHECK_GTE(admitted, LOG_THROTTLE_TEMPLATES / 2);
+    LT_CHECK_LTE(admitted, LOG_THROTTLE_TEMPLATES * 2);
+LT_END_AUTO_TEST(crowded_throttle)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,131 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "details/metrics.hpp"
+
+#include <pthread.h>
+#include <string>
+
+using namespace httpserver;
+using namespace std;
+
+static bool contains(const string& text, const string& piece)
+{
+    return text.find(piece) != string::npos;
+}
+
+static void* record_requests(void* m)
+{
+    details::metrics* target = static_cast<details::metrics*>(m);
+    for(int i = 0; i < 1000; i++)
+        target->record_request(1, details::metrics::method_id("GET"), 200, 10);
+    target->add_sent(1000);
+    return 0x0;
+}
+
+LT_BEGIN_SUITE(metrics_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(metrics_suite)
+
+LT_BEGIN_AUTO_TEST(metrics_suite, latency_buckets)
+    for(uint64_t v = 0; v < 4; v++)
+        LT_CHECK_EQ(details::metrics::latency_bucket(v), (int) v);
+    //each bucket holds the values below its bound and not below the
+    //bound of the previous one
+    for(int b = 1; b < METRICS_LATENCY_BUCKETS - 1; b++)
+    {
+        uint64_t lower = details::metrics::latency_bound(b - 1);
+        uint64_t upper = details::metrics::latency_bound(b);
+        LT_CHECK_LT(lower, upper);
+        LT_CHECK_EQ(details::metrics::latency_bucket(lower), b);
+        LT_CHECK_EQ(details::metrics::latency_bucket(upper - 1), b);
+        //log-linear: no bucket is wider than a quarter of its values
+        if(b >= 4)
+            LT_CHECK_LTE((upper - lower) * 4, upper);
+    }
+    LT_CHECK_EQ(details::metrics::latency_bucket(1ULL << 40),
+            METRICS_LATENCY_BUCKETS - 1);
+LT_END_AUTO_TEST(latency_buckets)
+
+LT_BEGIN_AUTO_TEST(metrics_suite, routes)
+    details::metrics m;
+    LT_CHECK_EQ(m.route_id("/a"), 1);
+    LT_CHECK_EQ(m.route_id("/b"), 2);
+    LT_CHECK_EQ(m.route_id("/a"), 1);
+    for(int i = 3; i < METRICS_MAX_ROUTES + 10; i++)
+        m.route_id("/r" + string(1, 'a' + i % 26) + string(i / 26, 'x'));
+    LT_CHECK_EQ(m.route_id("/one/too/many"), 0);
+    LT_CHECK_EQ(details::metrics::method_id("DELETE"), 4);
+    LT_CHECK_EQ(details::metrics::method_id("PROPFIND"), METRICS_METHODS - 1);
+LT_END_AUTO_TEST(routes)
+
+LT_BEGIN_AUTO_TEST(metrics_suite, aggregated_on_scrape)
+    details::metrics m;
+    m.route_id("/hello");
+    pthread_t threads[4];
+    for(int i = 0; i < 4; i++)
+        pthread_create(&threads[i], 0x0, &record_requests, &m);
+    for(int i = 0; i < 4; i++)
+        pthread_join(threads[i], 0x0);
+    m.record_request(0, details::metrics::method_id("POST"), 404, 3000000);
+    m.cache_hit();
+    m.cache_miss();
+    m.cache_miss();
+
+    string out;
+    m.render(out);
+    LT_CHECK_EQ(contains(out, "httpserver_requests_total{route=\"/hello\","
+                "method=\"GET\",code=\"2xx\"} 4000\n"), true);
+    LT_CHECK_EQ(contains(out, "httpserver_requests_total{route=\"unmatched\","
+                "method=\"POST\",code=\"4xx\"} 1\n"), true);
+    LT_CHECK_EQ(contains(out, "httpserver_request_duration_seconds_bucket{"
+                "route=\"/hello\",le=\"1.2e-05\"} 4000\n"), true);
+    LT_CHECK_EQ(contains(out, "httpserver_request_duration_seconds_bucket{"
+                "route=\"/hello\",le=\"8e-06\"} 0\n"), true);
+    LT_CHECK_EQ(contains(out, "httpserver_request_duration_seconds_count{"
+                "route=\"/hello\"} 4000\n"), true);
+    LT_CHECK_EQ(contains(out, "httpserver_request_duration_seconds_sum{"
+                "route=\"unmatched\"} 3.000000\n"), true);
+    LT_CHECK_EQ(contains(out, "httpserver_sent_bytes_total 4000\n"), true);
+    LT_CHECK_EQ(contains(out, "httpserver_cache_hits_total 1\n"), true);
+    LT_CHECK_EQ(contains(out, "httpserver_cache_misses_total 2\n"), true);
+    LT_CHECK_EQ(contains(out, "# TYPE httpserver_request_duration_seconds "
+                "histogram\n"), true);
+LT_END_AUTO_TEST(aggregated_on_scrape)
+
+LT_BEGIN_AUTO_TEST(metrics_suite, label_escaping)
+    details::metrics m;
+    int route = m.route_id("/a\"b\\c");
+    m.record_request(route, 0, 500, 1);
+    string out;
+    m.render(out);
+    LT_CHECK_EQ(contains(out, "route=\"/a\\\"b\\\\c\""), true);
+LT_END_AUTO_TEST(label_escaping)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,88 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "details/object_pool.hpp"
+
+#include <pthread.h>
+#include <string.h>
+
+using namespace httpserver;
+using namespace std;
+
+void* allocate_in_thread(void* arg)
+{
+    details::pool_release(details::pool_allocate(100));
+    return details::pool_allocate(100);
+}
+
+LT_BEGIN_SUITE(object_pool_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(object_pool_suite)
+
+LT_BEGIN_AUTO_TEST(object_pool_suite, reuses_released_blocks)
+    void* first = details::pool_allocate(200);
+    memset(first, 1, 200);
+    details::pool_release(first);
+    void* second = details::pool_allocate(200);
+    LT_CHECK_EQ(first == second, true);
+    details::pool_release(second);
+LT_END_AUTO_TEST(reuses_released_blocks)
+
+LT_BEGIN_AUTO_TEST(object_pool_suite, size_classes_are_separated)
+    void* small = details::pool_allocate(24);
+    details::pool_release(small);
+    void* large = details::pool_allocate(500);
+    LT_CHECK_EQ(small == large, false);
+    void* again = details::pool_allocate(20);
+    LT_CHECK_EQ(small == again, true);
+    details::pool_release(large);
+    details::pool_release(again);
+LT_END_AUTO_TEST(size_classes_are_separated)
+
+LT_BEGIN_AUTO_TEST(object_pool_suite, large_blocks_bypass_the_pool)
+    void* p = details::pool_allocate(1 << 20);
+    memset(p, 1, 1 << 20);
+    details::pool_release(p);
+    details::pool_release(0x0);
+LT_END_AUTO_TEST(large_blocks_bypass_the_pool)
+
+LT_BEGIN_AUTO_TEST(object_pool_suite, release_from_other_thread)
+    pthread_t t;
+    void* p = 0x0;
+    pthread_create(&t, 0x0, &allocate_in_thread, 0x0);
+    pthread_join(t, &p);
+    LT_ASSERT_EQ(p == 0x0, false);
+    memset(p, 1, 100);
+    details::pool_release(p);
+    void* q = details::pool_allocate(100);
+    LT_CHECK_EQ(p == q, true);
+    details::pool_release(q);
+LT_END_AUTO_TEST(release_from_other_thread)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,117 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "details/rate_limiter.hpp"
+
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+using namespace httpserver;
+using namespace std;
+
+static struct sockaddr_in ipv4(const char* ip)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    inet_pton(AF_INET, ip, &addr.sin_addr);
+    return addr;
+}
+
+static struct sockaddr_in6 ipv6(const char* ip)
+{
+    struct sockaddr_in6 addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin6_family = AF_INET6;
+    inet_pton(AF_INET6, ip, &addr.sin6_addr);
+    return addr;
+}
+
+LT_BEGIN_SUITE(rate_limiter_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(rate_limiter_suite)
+
+LT_BEGIN_AUTO_TEST(rate_limiter_suite, burst_then_rate)
+    details::rate_limiter limiter(10, 3, 1024);
+    struct sockaddr_in a = ipv4("10.0.0.1");
+    struct sockaddr_in b = ipv4("10.0.0.2");
+    for(int i = 0; i < 3; i++)
+        LT_CHECK_EQ(limiter.consume((struct sockaddr*) &a), 0);
+    LT_CHECK_EQ(limiter.exhausted((struct sockaddr*) &a), true);
+    LT_CHECK_EQ(limiter.consume((struct sockaddr*) &a), 1);
+    //other clients have their own bucket
+    LT_CHECK_EQ(limiter.exhausted((struct sockaddr*) &b), false);
+    LT_CHECK_EQ(limiter.consume((struct sockaddr*) &b), 0);
+
+    usleep(150000);
+    LT_CHECK_EQ(limiter.exhausted((struct sockaddr*) &a), false);
+    LT_CHECK_EQ(limiter.consume((struct sockaddr*) &a), 0);
+LT_END_AUTO_TEST(burst_then_rate)
+
+LT_BEGIN_AUTO_TEST(rate_limiter_suite, retry_after_follows_the_rate)
+    details::rate_limiter limiter(0.2, 1, 1024);
+    struct sockaddr_in a = ipv4("10.0.0.1");
+    LT_CHECK_EQ(limiter.consume((struct sockaddr*) &a), 0);
+    LT_CHECK_EQ(limiter.consume((struct sockaddr*) &a), 5);
+LT_END_AUTO_TEST(retry_after_follows_the_rate)
+
+LT_BEGIN_AUTO_TEST(rate_limiter_suite, client_identity)
+    details::rate_limiter limiter(1, 1, 1024);
+    struct sockaddr_in v4 = ipv4("192.168.1.1");
+    struct sockaddr_in6 mapped = ipv6("::ffff:192.168.1.1");
+    LT_CHECK_EQ(limiter.consume((struct sockaddr*) &v4), 0);
+    LT_CHECK_EQ(limiter.exhausted((struct sockaddr*) &mapped), true);
+
+    //IPv6 clients are their /64
+    struct sockaddr_in6 a = ipv6("2001:db8:1:2::1");
+    struct sockaddr_in6 b = ipv6("2001:db8:1:2:ffff::2");
+    struct sockaddr_in6 c = ipv6("2001:db8:1:3::1");
+    LT_CHECK_EQ(limiter.consume((struct sockaddr*) &a), 0);
+    LT_CHECK_EQ(limiter.exhausted((struct sockaddr*) &b), true);
+    LT_CHECK_EQ(limiter.exhausted((struct sockaddr*) &c), false);
+LT_END_AUTO_TEST(client_identity)
+
+LT_BEGIN_AUTO_TEST(rate_limiter_suite, bounded_table)
+    details::rate_limiter limiter(1, 1, 256);
+    for(unsigned int i = 0; i < 10000; i++)
+    {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(0x0A000000 + i);
+        limiter.consume((struct sockaddr*) &addr);
+    }
+    LT_CHECK_LTE(limiter.size(), 256);
+    LT_CHECK_GT(limiter.size(), 0);
+LT_END_AUTO_TEST(bounded_table)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
@@ -0,0 +1,103 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "http_utils.hpp"
+#include "shared_buffer.hpp"
+
+#include <cstdio>
+#include <string>
+
+using namespace httpserver;
+using namespace std;
+
+LT_BEGIN_SUITE(shared_buffer_suite)
+    void set_up()
+    {
+    }
+
+    void tear_down()
+    {
+    }
+LT_END_SUITE(shared_buffer_suite)
+
+LT_BEGIN_AUTO_TEST(shared_buffer_suite, empty)
+    shared_buffer b;
+    LT_CHECK_EQ(b.empty(), true);
+    LT_CHECK_EQ(b.size(), 0);
+    LT_CHECK_EQ(b.use_count(), 0);
+    LT_CHECK_EQ(string(b.data()), "");
+LT_END_AUTO_TEST(empty)
+
+LT_BEGIN_AUTO_TEST(shared_buffer_suite, copies_share_the_block)
+    shared_buffer a(string("payload"));
+    const char* bytes = a.data();
+    {
+        shared_buffer b(a);
+        shared_buffer c;
+        c = b;
+        LT_CHECK_EQ(a.use_count(), 3);
+        LT_CHECK_EQ(b.data() == bytes, true);
+        LT_CHECK_EQ(c.data() == bytes, true);
+    }
+    LT_CHECK_EQ(a.use_count(), 1);
+    LT_CHECK_EQ(string(a.data(), a.size()), "payload");
+LT_END_AUTO_TEST(copies_share_the_block)
+
+LT_BEGIN_AUTO_TEST(shared_buffer_suite, take)
+    string content(4096, 'x');
+    const char* bytes = content.data();
+    shared_buffer b = shared_buffer::take(content);
+    LT_CHECK_EQ(content.empty(), true);
+    LT_CHECK_EQ(b.size(), 4096);
+    LT_CHECK_EQ(b.data() == bytes, true);
+LT_END_AUTO_TEST(take)
+
+LT_BEGIN_AUTO_TEST(shared_buffer_suite, from_file)
+    const char* filename = "shared_buffer_test.tmp";
+    FILE* f = fopen(filename, "w");
+    fputs("file content", f);
+    fclose(f);
+    {
+        shared_buffer b = shared_buffer::from_file(filename);
+        LT_CHECK_EQ(string(b.data(), b.size()), "file content");
+    }
+    remove(filename);
+    LT_CHECK_THROW(shared_buffer::from_file("not_existing_file.tmp"));
+LT_END_AUTO_TEST(from_file)
+
+LT_BEGIN_AUTO_TEST(shared_buffer_suite, from_large_file)
+    const char* filename = "shared_buffer_test.tmp";
+    FILE* f = fopen(filename, "w");
+    //large enough to be mapped instead of read
+    string content(256 * 1024, 'x');
+    fputs(content.c_str(), f);
+    fclose(f);
+    {
+        shared_buffer b = shared_buffer::from_file(filename);
+        LT_CHECK_EQ(b.size(), content.size());
+        LT_CHECK_EQ(string(b.data(), b.size()) == content, true);
+    }
+    remove(filename);
+LT_END_AUTO_TEST(from_large_file)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()
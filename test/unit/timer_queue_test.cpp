@@ -0,0 +1,123 @@
+/*
+     This file is part of libhttpserver
+     Copyright (C) 2011, 2012, 2013, 2014, 2015 Sebastiano Merlino
+
+     This library is free software; you can redistribute it and/or
+     modify it under the terms of the GNU Lesser General Public
+     License as published by the Free Software Foundation; either
+     version 2.1 of the License, or (at your option) any later version.
+
+     This library is distributed in the hope that it will be useful,
+     but WITHOUT ANY WARRANTY; without even the implied warranty of
+     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+     Lesser General Public License for more details.
+
+     You should have received a copy of the GNU Lesser General Public
+     License along with this library; if not, write to the Free Software
+     Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301
+     USA
+*/
+
+#include "littletest.hpp"
+#include "timer_queue.hpp"
+
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+using namespace httpserver;
+using namespace std;
+
+struct fired_timers
+{
+    pthread_mutex_t lock;
+    vector<int> order;
+    vector<double> at;
+};
+
+struct timer_arg
+{
+    fired_timers* fired;
+    int id;
+};
+
+static double now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static void record(void* arg)
+{
+    timer_arg* t = static_cast<timer_arg*>(arg);
+    pthread_mutex_lock(&t->fired->lock);
+    t->fired->order.push_back(t->id);
+    t->fired->at.push_back(now_ms());
+    pthread_mutex_unlock(&t->fired->lock);
+}
+
+static size_t wait_fired(fired_timers* fired, size_t expected)
+{
+    for(int i = 0; i < 2000; i++)
+    {
+        pthread_mutex_lock(&fired->lock);
+        size_t n = fired->order.size();
+        pthread_mutex_unlock(&fired->lock);
+        if(n >= expected)
+            return n;
+        usleep(1000);
+    }
+    return 0;
+}
+
+LT_BEGIN_SUITE(timer_queue_suite)
+    fired_timers fired;
+
+    void set_up()
+    {
+        pthread_mutex_init(&fired.lock, 0x0);
+        fired.order.clear();
+        fired.at.clear();
+    }
+
+    void tear_down()
+    {
+        pthread_mutex_destroy(&fired.lock);
+    }
+LT_END_SUITE(timer_queue_suite)
+
+LT_BEGIN_AUTO_TEST(timer_queue_suite, fires_in_deadline_order)
+    timer_queue timers;
+    timer_arg args[4] = {{&fired, 0}, {&fired, 1}, {&fired, 2}, {&fired, 3}};
+    timers.schedule(60, &record, &args[3]);
+    timers.schedule(20, &record, &args[1]);
+    timers.schedule(0, &record, &args[0]);
+    timers.schedule(40, &record, &args[2]);
+    LT_CHECK_EQ(wait_fired(&fired, 4), 4);
+    for(int i = 0; i < 4; i++)
+        LT_CHECK_EQ(fired.order[i], i);
+LT_END_AUTO_TEST(fires_in_deadline_order)
+
+LT_BEGIN_AUTO_TEST(timer_queue_suite, same_deadline_keeps_schedule_order)
+    timer_queue timers;
+    timer_arg args[3] = {{&fired, 0}, {&fired, 1}, {&fired, 2}};
+    for(int i = 0; i < 3; i++)
+        timers.schedule(10, &record, &args[i]);
+    LT_CHECK_EQ(wait_fired(&fired, 3), 3);
+    for(int i = 0; i < 3; i++)
+        LT_CHECK_EQ(fired.order[i], i);
+LT_END_AUTO_TEST(same_deadline_keeps_schedule_order)
+
+LT_BEGIN_AUTO_TEST(timer_queue_suite, waits_the_delay)
+    timer_arg arg = {&fired, 0};
+    double start = now_ms();
+    timer_queue::shared().schedule(50, &record, &arg);
+    LT_CHECK_EQ(wait_fired(&fired, 1), 1);
+    LT_CHECK_EQ(fired.at[0] - start >= 50, true);
+LT_END_AUTO_TEST(waits_the_delay)
+
+LT_BEGIN_AUTO_TEST_ENV()
+    AUTORUN_TESTS()
+LT_END_AUTO_TEST_ENV()